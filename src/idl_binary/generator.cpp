@@ -0,0 +1,502 @@
+#include "generator.hpp"
+
+#include <cassert>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <string>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+state_holder::state_holder()
+    : packets_as_json(false)
+{
+}
+
+void analyze(   state_holder& state,
+                expression_tree const* pexpression)
+{
+    assert(pexpression);
+
+    if (pexpression->lexem.rtt != keyword_module::rtt ||
+        pexpression->children.size() != 2 ||
+        pexpression->children.front()->lexem.rtt != identifier::rtt ||
+        pexpression->children.back()->lexem.rtt != scope_brace::rtt ||
+        pexpression->children.back()->children.empty())
+        throw runtime_error("wtf");
+
+    state.module_name = pexpression->children.front()->lexem.value;
+
+    //  classes get rtt in the order of definition, enums are encoded
+    //  by their value and need no code of their own
+    for (auto item : pexpression->children.back()->children)
+    {
+        if (item->lexem.rtt == keyword_class::rtt)
+        {
+            if (item->children.size() != 2 ||
+                item->children.front()->lexem.rtt != identifier::rtt ||
+                item->children.back()->lexem.rtt != scope_brace::rtt)
+                throw runtime_error("type syntax is wrong");
+
+            string type_name = item->children.front()->lexem.value;
+            analyze_struct(state, item->children.back(), type_name);
+        }
+    }
+
+    if (state.classes.empty())
+        throw runtime_error("wtf, nothing to do");
+}
+
+void analyze_struct(    state_holder& state,
+                        expression_tree const* pexpression,
+                        string const& type_name)
+{
+    assert(pexpression);
+
+    if (pexpression->children.size() % 2 != 0)
+        throw runtime_error("inside class syntax error, wtf - " + type_name);
+
+    vector<string> members;
+
+    auto it = pexpression->children.begin();
+    for (; it != pexpression->children.end(); ++it)
+    {
+        ++it;
+        auto const* member_name = *it;
+
+        if (member_name->lexem.rtt != identifier::rtt)
+            throw runtime_error("inside class syntax error, wtf, still " + type_name);
+
+        members.push_back(member_name->lexem.value);
+    }
+
+    state.classes.push_back(std::make_pair(type_name, members));
+}
+
+namespace
+{
+//  overloads for the types that idl members can have, these are the same
+//  for every module but must live in its namespace to see its classes
+char const* const common_template = R"file_template(
+using ::publiqpp::binary::reader;
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+save(std::string& out, T value);
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+load(reader& in, T& value);
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+save(std::string& out, T value);
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+load(reader& in, T& value);
+
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+save(std::string& out, T value);
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+load(reader& in, T& value);
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+save(std::string& out, T value);
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+load(reader& in, T& value);
+
+//  TimePoint
+template <typename T>
+auto save(std::string& out, T const& value) -> decltype(value.tm, void());
+template <typename T>
+auto load(reader& in, T& value) -> decltype(value.tm, void());
+
+template <typename T>
+void save(std::string& out, ::boost::optional<T> const& value);
+template <typename T>
+void load(reader& in, ::boost::optional<T>& value);
+
+template <typename T, typename... Args>
+void save(std::string& out, std::vector<T, Args...> const& value);
+template <typename T, typename... Args>
+void load(reader& in, std::vector<T, Args...>& value);
+
+template <typename T, typename... Args>
+void save(std::string& out, std::set<T, Args...> const& value);
+template <typename T, typename... Args>
+void load(reader& in, std::set<T, Args...>& value);
+
+template <typename T, typename... Args>
+void save(std::string& out, std::unordered_set<T, Args...> const& value);
+template <typename T, typename... Args>
+void load(reader& in, std::unordered_set<T, Args...>& value);
+
+template <typename K, typename V, typename... Args>
+void save(std::string& out, std::map<K, V, Args...> const& value);
+template <typename K, typename V, typename... Args>
+void load(reader& in, std::map<K, V, Args...>& value);
+
+template <typename K, typename V, typename... Args>
+void save(std::string& out, std::unordered_map<K, V, Args...> const& value);
+template <typename K, typename V, typename... Args>
+void load(reader& in, std::unordered_map<K, V, Args...>& value);
+
+inline void save(std::string& out, bool value)
+{
+    out.push_back(value ? char(1) : char(0));
+}
+inline void load(reader& in, bool& value)
+{
+    value = (0 != in.read_byte());
+}
+
+inline void save(std::string& out, std::string const& value)
+{
+    ::publiqpp::binary::write_bytes(out, value);
+}
+inline void load(reader& in, std::string& value)
+{
+    value = in.read_bytes();
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+save(std::string& out, T value)
+{
+    ::publiqpp::binary::write_varint(out, uint64_t(value));
+}
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+load(reader& in, T& value)
+{
+    uint64_t temp = in.read_varint();
+    if (temp > uint64_t(std::numeric_limits<T>::max()))
+        throw std::runtime_error("binary::load: integer is out of range");
+    value = T(temp);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+save(std::string& out, T value)
+{
+    int64_t temp = value;
+    uint64_t sign = temp < 0 ? ~uint64_t(0) : uint64_t(0);
+    ::publiqpp::binary::write_varint(out, (uint64_t(temp) << 1) ^ sign);
+}
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+load(reader& in, T& value)
+{
+    uint64_t temp = in.read_varint();
+    int64_t decoded = (temp & 1) ? -int64_t(temp >> 1) - 1 : int64_t(temp >> 1);
+    if (decoded < int64_t(std::numeric_limits<T>::min()) ||
+        decoded > int64_t(std::numeric_limits<T>::max()))
+        throw std::runtime_error("binary::load: integer is out of range");
+    value = T(decoded);
+}
+
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+save(std::string& out, T value)
+{
+    ::publiqpp::binary::write_varint(out, uint64_t(value));
+}
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+load(reader& in, T& value)
+{
+    value = T(in.read_varint());
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+save(std::string& out, T value)
+{
+    ::publiqpp::binary::write_raw(out, &value, sizeof(value));
+}
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+load(reader& in, T& value)
+{
+    in.read_raw(&value, sizeof(value));
+}
+
+template <typename T>
+auto save(std::string& out, T const& value) -> decltype(value.tm, void())
+{
+    save(out, int64_t(value.tm));
+}
+template <typename T>
+auto load(reader& in, T& value) -> decltype(value.tm, void())
+{
+    int64_t tm;
+    load(in, tm);
+    value.tm = decltype(value.tm)(tm);
+}
+
+template <typename T>
+void save(std::string& out, ::boost::optional<T> const& value)
+{
+    save(out, bool(value));
+    if (value)
+        save(out, *value);
+}
+template <typename T>
+void load(reader& in, ::boost::optional<T>& value)
+{
+    value.reset();
+    bool exists;
+    load(in, exists);
+    if (exists)
+    {
+        T item{};
+        load(in, item);
+        value = std::move(item);
+    }
+}
+
+template <typename T, typename... Args>
+void save(std::string& out, std::vector<T, Args...> const& value)
+{
+    ::publiqpp::binary::write_varint(out, value.size());
+    for (auto const& item : value)
+        save(out, item);
+}
+template <typename T, typename... Args>
+void load(reader& in, std::vector<T, Args...>& value)
+{
+    size_t count = in.read_count();
+    value.clear();
+    value.reserve(count);
+    for (size_t index = 0; index != count; ++index)
+    {
+        T item{};
+        load(in, item);
+        value.push_back(std::move(item));
+    }
+}
+
+template <typename T, typename... Args>
+void save(std::string& out, std::set<T, Args...> const& value)
+{
+    ::publiqpp::binary::write_varint(out, value.size());
+    for (auto const& item : value)
+        save(out, item);
+}
+template <typename T, typename... Args>
+void load(reader& in, std::set<T, Args...>& value)
+{
+    size_t count = in.read_count();
+    value.clear();
+    for (size_t index = 0; index != count; ++index)
+    {
+        T item{};
+        load(in, item);
+        value.insert(std::move(item));
+    }
+}
+
+template <typename T, typename... Args>
+void save(std::string& out, std::unordered_set<T, Args...> const& value)
+{
+    ::publiqpp::binary::write_varint(out, value.size());
+    for (auto const& item : value)
+        save(out, item);
+}
+template <typename T, typename... Args>
+void load(reader& in, std::unordered_set<T, Args...>& value)
+{
+    size_t count = in.read_count();
+    value.clear();
+    value.reserve(count);
+    for (size_t index = 0; index != count; ++index)
+    {
+        T item{};
+        load(in, item);
+        value.insert(std::move(item));
+    }
+}
+
+template <typename K, typename V, typename... Args>
+void save(std::string& out, std::map<K, V, Args...> const& value)
+{
+    ::publiqpp::binary::write_varint(out, value.size());
+    for (auto const& item : value)
+    {
+        save(out, item.first);
+        save(out, item.second);
+    }
+}
+template <typename K, typename V, typename... Args>
+void load(reader& in, std::map<K, V, Args...>& value)
+{
+    size_t count = in.read_count();
+    value.clear();
+    for (size_t index = 0; index != count; ++index)
+    {
+        K key{};
+        V item{};
+        load(in, key);
+        load(in, item);
+        value.emplace(std::move(key), std::move(item));
+    }
+}
+
+template <typename K, typename V, typename... Args>
+void save(std::string& out, std::unordered_map<K, V, Args...> const& value)
+{
+    ::publiqpp::binary::write_varint(out, value.size());
+    for (auto const& item : value)
+    {
+        save(out, item.first);
+        save(out, item.second);
+    }
+}
+template <typename K, typename V, typename... Args>
+void load(reader& in, std::unordered_map<K, V, Args...>& value)
+{
+    size_t count = in.read_count();
+    value.clear();
+    value.reserve(count);
+    for (size_t index = 0; index != count; ++index)
+    {
+        K key{};
+        V item{};
+        load(in, key);
+        load(in, item);
+        value.emplace(std::move(key), std::move(item));
+    }
+}
+)file_template";
+}
+
+string generate(state_holder const& state)
+{
+    string const& module_name = state.module_name;
+    string result;
+
+    result += "#pragma once\n";
+    result += "//  generated by idl_binary, do not edit\n";
+    result += "//  include through binary.hpp\n\n";
+    result += "namespace " + module_name + "\n{\n";
+    result += "namespace binary\n{\n";
+
+    result += "inline void save(std::string& out, ::beltpp::packet const& value);\n";
+    result += "inline void load(::publiqpp::binary::reader& in, ::beltpp::packet& value);\n";
+    for (auto const& class_item : state.classes)
+    {
+        result += "inline void save(std::string& out, " + class_item.first + " const& value);\n";
+        result += "inline void load(::publiqpp::binary::reader& in, " + class_item.first + "& value);\n";
+    }
+
+    result += common_template;
+
+    for (auto const& class_item : state.classes)
+    {
+        string const& type_name = class_item.first;
+        auto const& members = class_item.second;
+
+        if (members.empty())
+        {
+            result += "\ninline void save(std::string&, " + type_name + " const&)\n{\n}\n";
+            result += "inline void load(reader&, " + type_name + "&)\n{\n}\n";
+            continue;
+        }
+
+        result += "\ninline void save(std::string& out, " + type_name + " const& value)\n{\n";
+        for (auto const& member : members)
+            result += "    save(out, value." + member + ");\n";
+        result += "}\n";
+
+        result += "inline void load(reader& in, " + type_name + "& value)\n{\n";
+        for (auto const& member : members)
+            result += "    load(in, value." + member + ");\n";
+        result += "}\n";
+    }
+
+    //  packet is either empty (0), a json string (1) or a class of this module (rtt + 2)
+    result += "\ninline void save(std::string& out, ::beltpp::packet const& value)\n{\n";
+    result += "    if (value.empty())\n";
+    result += "    {\n";
+    result += "        ::publiqpp::binary::write_varint(out, 0);\n";
+    result += "        return;\n";
+    result += "    }\n\n";
+    if (false == state.packets_as_json)
+    {
+        result += "    switch (value.type())\n";
+        result += "    {\n";
+        for (auto const& class_item : state.classes)
+        {
+            string const& type_name = class_item.first;
+            result += "    case " + type_name + "::rtt:\n";
+            result += "    {\n";
+            result += "        " + type_name + " const* pitem;\n";
+            result += "        value.get(pitem);\n";
+            result += "        ::publiqpp::binary::write_varint(out, uint64_t(" + type_name + "::rtt) + 2);\n";
+            result += "        save(out, *pitem);\n";
+            result += "        return;\n";
+            result += "    }\n";
+        }
+        result += "    }\n\n";
+    }
+    result += "    ::publiqpp::binary::write_varint(out, 1);\n";
+    result += "    ::publiqpp::binary::write_bytes(out, value.to_string());\n";
+    result += "}\n";
+
+    result += "inline void load(reader& in, ::beltpp::packet& value)\n{\n";
+    result += "    uint64_t tag = in.read_varint();\n";
+    result += "    if (0 == tag)\n";
+    result += "    {\n";
+    result += "        value = ::beltpp::packet();\n";
+    result += "        return;\n";
+    result += "    }\n";
+    result += "    if (1 == tag)\n";
+    result += "    {\n";
+    result += "        ::" + module_name + "::detail::loader(value, in.read_bytes(), in.putl);\n";
+    result += "        return;\n";
+    result += "    }\n\n";
+    if (false == state.packets_as_json)
+    {
+        result += "    switch (tag - 2)\n";
+        result += "    {\n";
+        for (auto const& class_item : state.classes)
+        {
+            string const& type_name = class_item.first;
+            result += "    case " + type_name + "::rtt:\n";
+            result += "    {\n";
+            result += "        " + type_name + " item;\n";
+            result += "        load(in, item);\n";
+            result += "        value.set(std::move(item));\n";
+            result += "        return;\n";
+            result += "    }\n";
+        }
+        result += "    }\n\n";
+    }
+    result += "    throw std::runtime_error(\"binary::load: unknown type \" + std::to_string(tag - 2));\n";
+    result += "}\n";
+
+    result += "}   //  end binary\n\n";
+
+    result += "template <typename T>\n";
+    result += "inline std::string to_binary(T const& value)\n{\n";
+    result += "    std::string out;\n";
+    result += "    binary::save(out, value);\n";
+    result += "    return out;\n";
+    result += "}\n\n";
+    result += "template <typename T>\n";
+    result += "inline void from_binary(char const* begin, char const* end, T& value, void* putl)\n{\n";
+    result += "    ::publiqpp::binary::reader in(begin, end, putl);\n";
+    result += "    binary::load(in, value);\n";
+    result += "    in.finish();\n";
+    result += "}\n";
+
+    result += "}   //  end " + module_name + "\n";
+
+    return result;
+}
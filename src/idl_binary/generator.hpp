@@ -0,0 +1,28 @@
+#pragma once
+
+#include <belt.pp/idl_parser.hpp>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+using expression_tree = beltpp::expression_tree<lexers, std::string>;
+
+class state_holder
+{
+public:
+    state_holder();
+    //  packets that can hold types of other modules are kept as json
+    bool packets_as_json;
+    std::string module_name;
+    std::vector<std::pair<std::string, std::vector<std::string>>> classes;
+};
+
+void analyze(               state_holder& state,
+                            expression_tree const* pexpression);
+
+void analyze_struct(        state_holder& state,
+                            expression_tree const* pexpression,
+                            std::string const& type_name);
+
+std::string generate(       state_holder const& state);
@@ -0,0 +1,96 @@
+#include "generator.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <streambuf>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::runtime_error;
+using std::ofstream;
+using std::ifstream;
+
+using ptr_expression_tree = std::unique_ptr<expression_tree>;
+
+//  idl_binary <definition.idl> <output.hpp> [packets_as_json]
+int main(int argc, char* argv[])
+{
+    string definition;
+    ptr_expression_tree ptr_expression;
+    try
+    {
+        if (argc < 3)
+            throw runtime_error("usage: idl_binary <definition.idl> <output.hpp> [packets_as_json]");
+
+        ifstream file_definition(argv[1]);
+        if (false == file_definition.is_open())
+            throw runtime_error("cannot open: " + string(argv[1]));
+
+        definition.assign((std::istreambuf_iterator<char>(file_definition)),
+                          std::istreambuf_iterator<char>());
+        file_definition.close();
+
+        auto it_begin = definition.begin();
+        auto it_end = definition.end();
+        auto it_begin_keep = it_begin;
+        while (beltpp::e_three_state_result::success ==
+               beltpp::parse(ptr_expression, it_begin, it_end))
+        {
+            if (it_begin == it_begin_keep)
+                break;
+            else
+            {
+                it_begin_keep = it_begin;
+            }
+        }
+
+        bool is_value = false;
+        auto proot = beltpp::root(ptr_expression.get(), is_value);
+        ptr_expression.release();
+        ptr_expression.reset(proot);
+
+        if (false == is_value)
+            throw runtime_error("missing expression, apparently");
+
+        if (it_begin != it_end)
+            throw runtime_error("syntax error, maybe: " + string(it_begin, it_end));
+
+        if (ptr_expression->depth() > 30)
+            throw runtime_error("expected tree max depth 30 is exceeded");
+
+        state_holder state;
+        state.packets_as_json = (argc >= 4 && string(argv[3]) == "packets_as_json");
+        analyze(state, ptr_expression.get());
+
+        string generated = generate(state);
+
+        ofstream file_generate(argv[2]);
+        if (false == file_generate.is_open())
+            throw runtime_error("cannot open: " + string(argv[2]));
+        file_generate << generated;
+        file_generate.close();
+    }
+    catch(std::exception const& ex)
+    {
+        cout << "exception: " << ex.what() << endl;
+
+        if (ptr_expression)
+        {
+            cout << "=====\n";
+            cout << beltpp::dump(ptr_expression.get()) << endl;
+        }
+
+        return 2;
+    }
+    catch(...)
+    {
+        cout << "that was an exception" << endl;
+        return 3;
+    }
+    return 0;
+}
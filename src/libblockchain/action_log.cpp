@@ -2,61 +2,195 @@
 #include "common.hpp"
 #include "message.tmpl.hpp"
 #include "blockchain.hpp"
+#include "segment_store.hpp"
 
 #include <mesh.pp/fileutility.hpp>
 #include <mesh.pp/cryptoutility.hpp>
 
+#include <vector>
+#include <cstring>
+
 using namespace BlockchainMessage;
 namespace filesystem = boost::filesystem;
 
 using std::string;
 using std::map;
+using std::vector;
 
 namespace publiqpp
 {
 namespace detail
 {
+uint64_t action_weight(beltpp::packet const& package)
+{
+    if (package.type() == BlockLog::rtt)
+    {
+        BlockLog const* pblock_log = nullptr;
+        package.get(pblock_log);
+
+        return 1 +
+               pblock_log->rewards.size() +
+               pblock_log->transactions.size() +
+               pblock_log->unit_uri_impacts.size() +
+               pblock_log->applied_sponsor_items.size();
+    }
+
+    return 1;
+}
+
+string info_to_record(action_log::entry_info const& info)
+{
+    string result(2 * sizeof(uint64_t) + 1, '\0');
+    std::memcpy(&result[0], &info.weight, sizeof(uint64_t));
+    std::memcpy(&result[sizeof(uint64_t)], &info.index, sizeof(uint64_t));
+    result.back() = info.revert ? 1 : 0;
+
+    return result;
+}
+
+action_log::entry_info info_from_record(string const& record)
+{
+    if (record.size() != 2 * sizeof(uint64_t) + 1)
+        throw std::runtime_error("action_log: corrupted entry info");
+
+    action_log::entry_info result;
+    std::memcpy(&result.weight, &record[0], sizeof(uint64_t));
+    std::memcpy(&result.index, &record[sizeof(uint64_t)], sizeof(uint64_t));
+    result.revert = (record.back() != 0);
+
+    return result;
+}
+
 class action_log_internals
 {
 public:
     action_log_internals(filesystem::path const& path, bool log_enabled)
         : m_actions("actions", path, 10000, 100, detail::get_putl())
+        , m_info_store("actions_info", path, 16 * 1024 * 1024)
         , m_enabled(log_enabled)
         , m_revert_index(m_actions.as_const().size() - 1)
-    {}
+        , m_cleared(false)
+    {
+        sync_info();
+
+        std::shared_ptr<action_log_view> view(new action_log_view());
+        view->begin = m_actions.as_const().size();
+        m_view = view;
+    }
+
+    void push_info(action_log::entry_info const& info)
+    {
+        m_info_store.push_back(info_to_record(info));
+        m_info.push_back(info);
+    }
+
+    //  the store is append only, so after discard or clear
+    //  the loaded part is either cut or extended to match it
+    void sync_info()
+    {
+        if (m_info.size() > m_info_store.size())
+            m_info.resize(m_info_store.size());
+
+        m_info.reserve(m_info_store.size());
+        while (m_info.size() < m_info_store.size())
+            m_info.push_back(info_from_record(m_info_store.at(m_info.size())));
+    }
+
+    void log_unpublished(action_log::entry_info const& info,
+                         LoggedTransaction const& action_info)
+    {
+        action_log_view::entry item;
+        item.info = info;
+        item.action = std::make_shared<LoggedTransaction const>(action_info);
+        m_unpublished.push_back(std::move(item));
+    }
+
+    //  the new view keeps the tail of the old one, or nothing after clear
+    void publish()
+    {
+        if (false == m_cleared && m_unpublished.empty())
+            return;
+
+        std::shared_ptr<action_log_view> view(new action_log_view());
+        vector<action_log_view::entry> const* pold = &m_view->entries;
+        vector<action_log_view::entry> const empty;
+        uint64_t begin = m_view->begin;
+        if (m_cleared)
+        {
+            pold = &empty;
+            begin = 0;
+        }
+
+        size_t total = pold->size() + m_unpublished.size();
+        size_t skip = 0;
+        if (total > ACTION_LOG_VIEW_LENGTH)
+            skip = total - ACTION_LOG_VIEW_LENGTH;
+
+        view->begin = begin + skip;
+        view->entries.reserve(total - skip);
+        for (size_t index = skip; index < pold->size(); ++index)
+            view->entries.push_back((*pold)[index]);
+        for (size_t index = (skip > pold->size() ? skip - pold->size() : 0);
+             index < m_unpublished.size();
+             ++index)
+            view->entries.push_back(std::move(m_unpublished[index]));
+
+        m_view = view;
+        m_unpublished.clear();
+        m_cleared = false;
+    }
 
     meshpp::vector_loader<LoggedTransaction> m_actions;
+    segment_store m_info_store;
+    vector<action_log::entry_info> m_info;
 
     bool m_enabled;
     uint64_t m_revert_index;
+
+    //  entries logged since the last commit, and whether clear came first
+    vector<action_log_view::entry> m_unpublished;
+    bool m_cleared;
+    std::shared_ptr<action_log_view const> m_view;
 };
 }
 
 action_log::action_log(boost::filesystem::path const& fs_action_log, bool log_enabled)
     : m_pimpl(new detail::action_log_internals(fs_action_log, log_enabled))
 {
+    backfill_info();
 }
 action_log::~action_log() = default;
 
 void action_log::save()
 {
     m_pimpl->m_actions.save();
+    m_pimpl->m_info_store.save();
 }
 
 void action_log::commit() noexcept
 {
     m_pimpl->m_actions.commit();
+    m_pimpl->m_info_store.commit();
+    m_pimpl->publish();
 }
 
 void action_log::discard() noexcept
 {
     m_pimpl->m_actions.discard();
+    m_pimpl->m_info_store.discard();
+    m_pimpl->sync_info();
     m_pimpl->m_revert_index = length() - 1;
+    m_pimpl->m_unpublished.clear();
+    m_pimpl->m_cleared = false;
 }
 
 void action_log::clear()
 {
     m_pimpl->m_actions.clear();
+    m_pimpl->m_info_store.clear();
+    m_pimpl->m_info.clear();
+    m_pimpl->m_unpublished.clear();
+    m_pimpl->m_cleared = true;
 }
 
 size_t action_log::length() const
@@ -64,32 +198,31 @@ size_t action_log::length() const
     return m_pimpl->m_actions.as_const().size();
 }
 
-void action_log::log_block(BlockchainMessage::SignedBlock const& signed_block,
+void action_log::log_block(memoized_block const& block_memo,
                            map<string, map<string, uint64_t>> const& unit_uri_view_counts,
                            map<string, coin> const& applied_sponsor_items)
 {
     if (!m_pimpl->m_enabled)
         return;
 
-    Block const& block = signed_block.block_details;
-    string block_serialized = block.to_string();
-    string block_hash = meshpp::hash(block_serialized);
+    Block const& block = block_memo.value();
 
     BlockLog block_log;
-    block_log.block_hash = block_hash;
+    block_log.block_hash = block_memo.digest();
     block_log.block_number = block.header.block_number;
     block_log.time_signed = block.header.time_signed;
-    block_log.authority = blockchain::get_miner(signed_block);
-    block_log.block_size = block_serialized.size();
+    block_log.authority = blockchain::get_miner(block_memo.signed_block());
+    block_log.block_size = block_memo.str().size();
 
-    for (auto const& item : block.signed_transactions)
+    for (size_t index = 0; index != block.signed_transactions.size(); ++index)
     {
-        string transaction_serialized = item.to_string();
+        auto const& transaction_memo = block_memo.transaction(index);
+        auto const& item = transaction_memo.value();
         TransactionLog transaction_log;
         transaction_log.fee = item.transaction_details.fee;
         transaction_log.time_signed = item.transaction_details.creation;
-        transaction_log.transaction_hash = meshpp::hash(transaction_serialized);
-        transaction_log.transaction_size = transaction_serialized.size();
+        transaction_log.transaction_hash = transaction_memo.digest();
+        transaction_log.transaction_size = transaction_memo.str().size();
         BlockchainMessage::detail::assign_packet(transaction_log.action, item.transaction_details.action);
 
         block_log.transactions.push_back(transaction_log);
@@ -134,18 +267,18 @@ void action_log::log_block(BlockchainMessage::SignedBlock const& signed_block,
     insert(beltpp::packet(std::move(block_log)));
 }
 
-void action_log::log_transaction(SignedTransaction const& signed_transaction)
+void action_log::log_transaction(memoized_transaction const& transaction_memo)
 {
     if (!m_pimpl->m_enabled)
         return;
 
-    string transaction_serialized = signed_transaction.to_string();
+    auto const& signed_transaction = transaction_memo.value();
 
     TransactionLog transaction_log;
     transaction_log.fee = signed_transaction.transaction_details.fee;
     transaction_log.time_signed = signed_transaction.transaction_details.creation;
-    transaction_log.transaction_hash = meshpp::hash(transaction_serialized);
-    transaction_log.transaction_size = transaction_serialized.size();
+    transaction_log.transaction_hash = transaction_memo.digest();
+    transaction_log.transaction_size = transaction_memo.str().size();
     BlockchainMessage::detail::assign_packet(transaction_log.action, signed_transaction.transaction_details.action);
 
     insert(beltpp::packet(std::move(transaction_log)));
@@ -156,6 +289,31 @@ void action_log::at(size_t number, LoggedTransaction& action_info) const
     action_info = m_pimpl->m_actions.as_const().at(number);
 }
 
+action_log::entry_info const& action_log::info(size_t number) const
+{
+    return m_pimpl->m_info.at(number);
+}
+
+std::shared_ptr<action_log_view const> action_log::view() const
+{
+    return m_pimpl->m_view;
+}
+
+size_t action_log_view::length() const
+{
+    return begin + entries.size();
+}
+
+void action_log_view::at(size_t number, LoggedTransaction& action_info) const
+{
+    action_info = *entries.at(number - begin).action;
+}
+
+action_log::entry_info const& action_log_view::info(size_t number) const
+{
+    return entries.at(number - begin).info;
+}
+
 void action_log::insert(beltpp::packet&& action)
 {
     LoggedTransaction action_info;
@@ -163,7 +321,14 @@ void action_log::insert(beltpp::packet&& action)
     action_info.index = length();
     action_info.action = std::move(action);
 
+    entry_info info;
+    info.weight = detail::action_weight(action_info.action);
+    info.index = action_info.index;
+    info.revert = false;
+
     m_pimpl->m_actions.push_back(action_info);
+    m_pimpl->push_info(info);
+    m_pimpl->log_unpublished(info, action_info);
     m_pimpl->m_revert_index = action_info.index;
 }
 
@@ -203,8 +368,51 @@ void action_log::revert()
     at(index, action_revert_info);
     assert(action_revert_info.logging_type == LoggingType::apply);
     action_revert_info.logging_type = LoggingType::revert;
+
+    entry_info info = m_pimpl->m_info.at(index);
+    info.revert = true;
+
     m_pimpl->m_actions.push_back(action_revert_info);
+    m_pimpl->push_info(info);
+    m_pimpl->log_unpublished(info, action_revert_info);
 
     m_pimpl->m_revert_index = index - 1;
 }
+
+void action_log::backfill_info()
+{
+    auto& info_store = m_pimpl->m_info_store;
+
+    //  data directories written before entry info was stored
+    //  get it computed once here
+    if (info_store.size() == length())
+        return;
+
+    beltpp::on_failure guard([this]
+    {
+        m_pimpl->m_info_store.discard();
+        m_pimpl->sync_info();
+    });
+
+    while (info_store.size() > length())
+        info_store.pop_back();
+    m_pimpl->sync_info();
+
+    while (info_store.size() < length())
+    {
+        auto const& action_info = m_pimpl->m_actions.as_const().at(info_store.size());
+
+        entry_info info;
+        info.weight = detail::action_weight(action_info.action);
+        info.index = action_info.index;
+        info.revert = (action_info.logging_type == LoggingType::revert);
+
+        m_pimpl->push_info(info);
+    }
+
+    info_store.save();
+
+    guard.dismiss();
+    info_store.commit();
+}
 }
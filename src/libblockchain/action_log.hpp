@@ -3,11 +3,14 @@
 #include "global.hpp"
 #include "message.hpp"
 #include "coin.hpp"
+#include "memoized.hpp"
 
 #include <boost/filesystem/path.hpp>
 
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace publiqpp
 {
@@ -17,6 +20,8 @@ namespace detail
 class action_log_internals;
 }
 
+class action_log_view;
+
 class action_log
 {
 public:
@@ -30,16 +35,52 @@ public:
 
     size_t length() const;
 
-    void log_block(BlockchainMessage::SignedBlock const& signed_block,
+    //  what paging needs to know of an entry without decoding it
+    //  weight is the number of items the entry stands for
+    //  index is the one stored in the entry, for reverts it is the reverted entry
+    class entry_info
+    {
+    public:
+        uint64_t weight;
+        uint64_t index;
+        bool revert;
+    };
+
+    void log_block(memoized_block const& block,
                    std::map<std::string, std::map<std::string, uint64_t>> const& unit_uri_view_counts,
                    std::map<std::string, coin> const& applied_sponsor_items);
-    void log_transaction(BlockchainMessage::SignedTransaction const& signed_transaction);
+    void log_transaction(memoized_transaction const& signed_transaction);
     void at(size_t number, BlockchainMessage::LoggedTransaction& action_info) const;
+    entry_info const& info(size_t number) const;
     void revert();
+
+    //  the committed tail of the log, a new one is published by commit
+    std::shared_ptr<action_log_view const> view() const;
 private:
     std::unique_ptr<detail::action_log_internals> m_pimpl;
 
     void insert(beltpp::packet&& action);
+    void backfill_info();
+};
+
+//  the last committed entries, never changed once published
+//  so it can be read on the query threads while the log goes on
+class action_log_view
+{
+public:
+    class entry
+    {
+    public:
+        action_log::entry_info info;
+        std::shared_ptr<BlockchainMessage::LoggedTransaction const> action;
+    };
+
+    uint64_t begin;
+    std::vector<entry> entries;
+
+    size_t length() const;
+    void at(size_t number, BlockchainMessage::LoggedTransaction& action_info) const;
+    action_log::entry_info const& info(size_t number) const;
 };
 
 }
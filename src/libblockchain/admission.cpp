@@ -0,0 +1,193 @@
+#include "admission.hpp"
+#include "common.hpp"
+#include "message.hpp"
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+using std::string;
+using std::unordered_map;
+using std::chrono::steady_clock;
+using namespace BlockchainMessage;
+
+namespace publiqpp
+{
+namespace detail
+{
+class token_bucket
+{
+public:
+    token_bucket(double burst, steady_clock::time_point const& now)
+        : tokens(burst)
+        , updated(now)
+    {}
+
+    void refill(double rate, double burst, steady_clock::time_point const& now)
+    {
+        std::chrono::duration<double> elapsed = now - updated;
+        tokens += elapsed.count() * rate;
+        if (tokens > burst)
+            tokens = burst;
+        updated = now;
+    }
+
+    double tokens;
+    steady_clock::time_point updated;
+};
+
+class token_buckets
+{
+public:
+    token_buckets(double _rate, double _burst)
+        : rate(_rate)
+        , burst(_burst)
+    {}
+
+    token_bucket& at(string const& key, steady_clock::time_point const& now)
+    {
+        auto it = buckets.find(key);
+        if (it == buckets.end())
+            it = buckets.insert(std::make_pair(key, token_bucket(burst, now))).first;
+
+        it->second.refill(rate, burst, now);
+        return it->second;
+    }
+
+    void cleanup(steady_clock::time_point const& now)
+    {
+        for (auto it = buckets.begin(); it != buckets.end();)
+        {
+            it->second.refill(rate, burst, now);
+            if (it->second.tokens >= burst)
+                it = buckets.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    double rate;
+    double burst;
+    unordered_map<string, token_bucket> buckets;
+};
+
+bool costly(size_t rtt)
+{
+    //  signatures, key derivation or disk writes
+    switch (rtt)
+    {
+    case Broadcast::rtt:
+    case TransactionBroadcastRequest::rtt:
+    case StorageFile::rtt:
+    case KeyPairRequest::rtt:
+    case SignRequest::rtt:
+    case Encrypt::rtt:
+    case Decrypt::rtt:
+        return true;
+    default:
+        return false;
+    }
+}
+
+class admission_internals
+{
+public:
+    admission_internals()
+        : peers(ADMISSION_PEER_RATE, ADMISSION_PEER_BURST)
+        , addresses(ADMISSION_ADDRESS_RATE, ADMISSION_ADDRESS_BURST)
+        , types(ADMISSION_TYPE_RATE, ADMISSION_TYPE_BURST)
+        , p2p_peers(ADMISSION_P2P_RATE, ADMISSION_P2P_BURST)
+        , rejected(size_t(admission::reason::count), 0)
+    {}
+
+    token_buckets peers;
+    token_buckets addresses;
+    token_buckets types;
+    token_buckets p2p_peers;
+    std::vector<uint64_t> rejected;
+};
+}
+
+admission::admission()
+    : m_pimpl(new detail::admission_internals())
+{
+}
+
+admission::~admission() = default;
+
+admission::reason admission::take(peer_id const& peer,
+                                  string const& address,
+                                  size_t rtt,
+                                  bool rpc)
+{
+    auto& impl = *m_pimpl;
+    auto now = steady_clock::now();
+
+    if (false == rpc)
+    {
+        //  only broadcasts can be left unprocessed without breaking a session
+        if (rtt != Broadcast::rtt)
+            return reason::none;
+
+        auto& bucket = impl.p2p_peers.at(peer, now);
+        if (bucket.tokens < 1)
+            return reason::peer_rate;
+
+        bucket.tokens -= 1;
+        return reason::none;
+    }
+
+    auto& peer_bucket = impl.peers.at(peer, now);
+    auto& address_bucket = impl.addresses.at(address, now);
+    detail::token_bucket* ptype_bucket = nullptr;
+    if (detail::costly(rtt))
+        ptype_bucket = &impl.types.at(address + "\n" + std::to_string(rtt), now);
+
+    if (peer_bucket.tokens < 1)
+        return reason::peer_rate;
+    if (address_bucket.tokens < 1)
+        return reason::address_rate;
+    if (ptype_bucket && ptype_bucket->tokens < 1)
+        return reason::type_rate;
+
+    peer_bucket.tokens -= 1;
+    address_bucket.tokens -= 1;
+    if (ptype_bucket)
+        ptype_bucket->tokens -= 1;
+
+    return reason::none;
+}
+
+void admission::reject(reason why)
+{
+    ++m_pimpl->rejected[size_t(why)];
+}
+
+uint64_t admission::rejected(reason why) const
+{
+    return m_pimpl->rejected[size_t(why)];
+}
+
+string admission::summary() const
+{
+    return std::to_string(rejected(reason::peer_rate)) + " over client or peer rate, " +
+           std::to_string(rejected(reason::address_rate)) + " over address rate, " +
+           std::to_string(rejected(reason::type_rate)) + " over type rate, " +
+           std::to_string(rejected(reason::too_large)) + " too large, " +
+           std::to_string(rejected(reason::expired)) + " expired, " +
+           std::to_string(rejected(reason::duplicate)) + " duplicate, " +
+           std::to_string(rejected(reason::balance)) + " not enough balance";
+}
+
+void admission::cleanup()
+{
+    auto& impl = *m_pimpl;
+    auto now = steady_clock::now();
+
+    impl.peers.cleanup(now);
+    impl.addresses.cleanup(now);
+    impl.types.cleanup(now);
+    impl.p2p_peers.cleanup(now);
+}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <belt.pp/socket.hpp>
+
+#include <string>
+#include <memory>
+
+namespace publiqpp
+{
+
+namespace detail
+{
+class admission_internals;
+}
+
+//  token buckets for the messages received, rpc requests count against
+//  the client connection and its remote address, the costly ones also
+//  against their type from that address, p2p broadcasts against the peer
+//  buckets start full, they are forgotten once full again after a while
+class admission
+{
+public:
+    using peer_id = beltpp::stream::peer_id;
+
+    enum class reason
+    {
+        none,
+        peer_rate,
+        address_rate,
+        type_rate,
+        too_large,
+        expired,
+        duplicate,
+        balance,
+        count
+    };
+
+    admission();
+    ~admission();
+
+    //  takes a token from each bucket the message counts against,
+    //  returns the limit it is above, when it is, without taking any
+    reason take(peer_id const& peer,
+                std::string const& address,
+                size_t rtt,
+                bool rpc);
+    void reject(reason why);
+    uint64_t rejected(reason why) const;
+    std::string summary() const;
+
+    //  forgets the buckets that are full
+    void cleanup();
+private:
+    std::unique_ptr<detail::admission_internals> m_pimpl;
+};
+
+}
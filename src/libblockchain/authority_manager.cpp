@@ -1,6 +1,8 @@
 #include "authority_manager.hpp"
 #include "common.hpp"
 #include "exception.hpp"
+#include "snapshot.hpp"
+#include "block_undo.hpp"
 
 #include <mesh.pp/fileutility.hpp>
 
@@ -14,11 +16,14 @@ namespace detail
 class authority_manager_impl
 {
 public:
-    authority_manager_impl(filesystem::path const& path_authority_store)
+    authority_manager_impl(filesystem::path const& path_authority_store,
+                           block_undo& undo)
         : m_authority_store("authorities", path_authority_store, 10000, get_putl_types())
+        , pundo(&undo)
     {}
 
     meshpp::map_loader<StorageTypes::AccountAuthorizations> m_authority_store;
+    block_undo* pundo;
 };
 }
 
@@ -111,6 +116,8 @@ void authority_manager::set_record(string const& address, string const& authorit
     if (false == m_pimpl->m_authority_store.contains(address))
         throw std::logic_error("authority_manager::set_record: false == m_pimpl->m_authority_store.contains(address)");
 
+    m_pimpl->pundo->touch("authorities", m_pimpl->m_authority_store, address);
+
     StorageTypes::AccountAuthorizations& auths = m_pimpl->m_authority_store.at(address);
 
     auto it_authority = auths.authorizations.find(authority);
@@ -122,6 +129,8 @@ void authority_manager::set_record(string const& address, string const& authorit
 
 void authority_manager::smart_create_dummy_record(string const& address, string const& authority)
 {
+    m_pimpl->pundo->touch("authorities", m_pimpl->m_authority_store, address);
+
     if (false == m_pimpl->m_authority_store.contains(address))
     {
         StorageTypes::AccountAuthorization address_record;
@@ -150,6 +159,8 @@ void authority_manager::smart_create_dummy_record(string const& address, string
 
 void authority_manager::smart_cleanup_dummy_record(string const& address, string const& authority)
 {
+    m_pimpl->pundo->touch("authorities", m_pimpl->m_authority_store, address);
+
     if (address != authority)
     {
         if (false == m_pimpl->m_authority_store.contains(address))
@@ -201,9 +212,33 @@ void authority_manager::clear()
     m_pimpl->m_authority_store.clear();
 }
 
+void authority_manager::export_snapshot(snapshot_writer& writer)
+{
+    snapshot_save(writer, "authorities", m_pimpl->m_authority_store);
+}
+
+void authority_manager::import_snapshot(snapshot_reader& reader)
+{
+    snapshot_load<StorageTypes::AccountAuthorizations>(reader, "authorities",
+                                                       m_pimpl->m_authority_store,
+                                                       detail::get_putl_types().get());
+}
+
+bool authority_manager::restore(StorageTypes::BlockUndoEntry const& entry)
+{
+    if (entry.table != "authorities")
+        return false;
+
+    block_undo::restore<StorageTypes::AccountAuthorizations>(m_pimpl->m_authority_store,
+                                                             entry,
+                                                             detail::get_putl_types().get());
+    return true;
+}
+
 
-authority_manager::authority_manager(filesystem::path const& path_authority_store)
-    : m_pimpl(new detail::authority_manager_impl(path_authority_store))
+authority_manager::authority_manager(filesystem::path const& path_authority_store,
+                                     block_undo& undo)
+    : m_pimpl(new detail::authority_manager_impl(path_authority_store, undo))
 {}
 
 authority_manager::~authority_manager() = default;
@@ -15,10 +15,15 @@ namespace detail
 {
     class authority_manager_impl;
 }
+class snapshot_writer;
+class snapshot_reader;
+class block_undo;
+
 class authority_manager
 {
 public:
-    authority_manager(boost::filesystem::path const& path_authority_store);
+    authority_manager(boost::filesystem::path const& path_authority_store,
+                      block_undo& undo);
     ~authority_manager();
 
     bool check_authority(std::string const& address, std::string const& authority, size_t action_id) const;
@@ -38,7 +43,13 @@ public:
     void commit() noexcept;
     void discard() noexcept;
     void clear();
-    
+
+    void export_snapshot(snapshot_writer& writer);
+    void import_snapshot(snapshot_reader& reader);
+
+    //  false if the entry is not of the authority store
+    bool restore(StorageTypes::BlockUndoEntry const& entry);
+
 private:
     std::unique_ptr<detail::authority_manager_impl> m_pimpl;
 };
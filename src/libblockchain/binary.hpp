@@ -0,0 +1,124 @@
+#pragma once
+
+#include "global.hpp"
+#include "message.hpp"
+#include "types.hpp"
+
+#include <belt.pp/packet.hpp>
+
+#include <boost/optional.hpp>
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <type_traits>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+//  compact binary encoding of idl types
+//  the canonical json from to_string() stays the format for hashing and signing,
+//  this one is only for storage where records are read back by this same code
+//  integers are varints, signed ones zigzag encoded, strings and containers
+//  are prefixed by size, class members follow in idl order without names
+//  the codec of each idl module is generated by idl_binary into <module>.gen.binary.hpp
+namespace publiqpp
+{
+namespace binary
+{
+inline
+void write_varint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(char(uint8_t(value) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+inline
+void write_bytes(std::string& out, std::string const& value)
+{
+    write_varint(out, value.size());
+    out.append(value);
+}
+
+inline
+void write_raw(std::string& out, void const* data, size_t size)
+{
+    out.append(static_cast<char const*>(data), size);
+}
+
+class reader
+{
+public:
+    reader(char const* _begin, char const* _end, void* _putl)
+        : it(_begin)
+        , end(_end)
+        , putl(_putl)
+    {}
+
+    uint8_t read_byte()
+    {
+        if (it == end)
+            throw std::runtime_error("binary::reader: unexpected end of data");
+        return uint8_t(*it++);
+    }
+
+    uint64_t read_varint()
+    {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = read_byte();
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (0 == (byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("binary::reader: varint is too long");
+    }
+
+    //  every item takes at least one byte, so larger counts are corrupted data
+    size_t read_count()
+    {
+        uint64_t count = read_varint();
+        if (count > uint64_t(end - it))
+            throw std::runtime_error("binary::reader: count is out of range");
+        return size_t(count);
+    }
+
+    std::string read_bytes()
+    {
+        size_t size = read_count();
+        std::string value(it, it + size);
+        it += size;
+        return value;
+    }
+
+    void read_raw(void* data, size_t size)
+    {
+        if (size > size_t(end - it))
+            throw std::runtime_error("binary::reader: unexpected end of data");
+        std::memcpy(data, it, size);
+        it += size;
+    }
+
+    void finish() const
+    {
+        if (it != end)
+            throw std::runtime_error("binary::reader: unexpected data after the end");
+    }
+
+    char const* it;
+    char const* end;
+    void* putl;
+};
+}
+}
+
+#include "message.gen.binary.hpp"
+#include "types.gen.binary.hpp"
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "global.hpp"
+#include "types.hpp"
+
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace publiqpp
+{
+//  records what the application of a block changes in the state, documents
+//  and authorities, as the values the touched entries had before the block
+//  the containers call touch() before changing an entry, only the first
+//  touch of an entry in a block is recorded, when not recording it does nothing
+//  the record is stored next to the block, reverting the block puts them back
+class block_undo
+{
+public:
+    block_undo()
+        : m_recording(false)
+        , m_record()
+        , m_touched()
+    {}
+
+    void begin()
+    {
+        discard();
+        m_recording = true;
+        m_record.recorded = true;
+    }
+
+    StorageTypes::BlockUndo end()
+    {
+        StorageTypes::BlockUndo result = std::move(m_record);
+        discard();
+        return result;
+    }
+
+    void discard() noexcept
+    {
+        m_recording = false;
+        m_record = StorageTypes::BlockUndo();
+        m_record.recorded = false;
+        m_touched.clear();
+    }
+
+    template <typename LOADER>
+    void touch(std::string const& table, LOADER& loader, std::string const& key)
+    {
+        if (false == m_recording ||
+            false == m_touched.insert(table + "\n" + key).second)
+            return;
+
+        StorageTypes::BlockUndoEntry entry;
+        entry.table = table;
+        entry.key = key;
+        entry.existed = loader.as_const().contains(key);
+        if (entry.existed)
+            entry.value = loader.as_const().at(key).to_string();
+
+        m_record.entries.push_back(std::move(entry));
+    }
+
+    template <typename T, typename LOADER>
+    static void restore(LOADER& loader, StorageTypes::BlockUndoEntry const& entry, void* putl)
+    {
+        if (false == entry.existed)
+        {
+            loader.erase(entry.key);
+            return;
+        }
+
+        T value;
+        value.from_string(entry.value, putl);
+
+        if (loader.as_const().contains(entry.key))
+            loader.at(entry.key) = std::move(value);
+        else
+            loader.insert(entry.key, value);
+    }
+private:
+    bool m_recording;
+    StorageTypes::BlockUndo m_record;
+    std::unordered_set<std::string> m_touched;
+};
+}
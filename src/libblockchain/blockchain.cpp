@@ -1,5 +1,7 @@
 #include "blockchain.hpp"
 #include "common.hpp"
+#include "segment_store.hpp"
+#include "snapshot.hpp"
 
 #include <belt.pp/utility.hpp>
 
@@ -10,6 +12,7 @@ using namespace BlockchainMessage;
 namespace filesystem = boost::filesystem;
 
 using std::string;
+using std::vector;
 
 namespace publiqpp
 {
@@ -19,13 +22,33 @@ class blockchain_internals
 {
 public:
     blockchain_internals(filesystem::path const& path)
-        : m_header("header", path, 1000, 1, detail::get_putl())
-        , m_blockchain("block", path, 10000, 1, detail::get_putl())
+        : m_header("headers", path, 16 * 1024 * 1024, 10000, segment_encoding::binary, detail::get_putl())
+        , m_blockchain("blocks", path, 256 * 1024 * 1024, 100, segment_encoding::binary, detail::get_putl())
+        , m_hash("hashes", path, 16 * 1024 * 1024)
+        , m_undo("undo", path, 64 * 1024 * 1024, 10, segment_encoding::binary, detail::get_putl_types())
     {
     }
 
     string m_last_hash;
     BlockHeader m_last_header;
+    segment_loader<BlockHeader> m_header;
+    segment_loader<SignedBlock> m_blockchain;
+    //  block hashes, computed once at insert
+    segment_store m_hash;
+    //  what each block changed, to revert it
+    segment_loader<StorageTypes::BlockUndo> m_undo;
+};
+
+//  the layout used before segment files
+class blockchain_legacy
+{
+public:
+    blockchain_legacy(filesystem::path const& path)
+        : m_header("header", path, 1000, 1, detail::get_putl())
+        , m_blockchain("block", path, 10000, 1, detail::get_putl())
+    {
+    }
+
     meshpp::vector_loader<BlockHeader> m_header;
     meshpp::vector_loader<SignedBlock> m_blockchain;
 };
@@ -34,6 +57,12 @@ public:
 blockchain::blockchain(boost::filesystem::path const& fs_blockchain)
     : m_pimpl(new detail::blockchain_internals(fs_blockchain))
 {
+    if (0 != detail::blockchain_legacy(fs_blockchain).m_blockchain.size())
+        throw std::runtime_error("blockchain is stored in old format, run with --migrate_blockchain once");
+
+    backfill_hashes();
+    backfill_undo();
+
     if (length() > 0)
         update_state();
 }
@@ -44,18 +73,24 @@ void blockchain::save()
 {
     m_pimpl->m_header.save();
     m_pimpl->m_blockchain.save();
+    m_pimpl->m_hash.save();
+    m_pimpl->m_undo.save();
 }
 
 void blockchain::commit() noexcept
 {
     m_pimpl->m_header.commit();
     m_pimpl->m_blockchain.commit();
+    m_pimpl->m_hash.commit();
+    m_pimpl->m_undo.commit();
 }
 
 void blockchain::discard() noexcept
 {
     m_pimpl->m_header.discard();
     m_pimpl->m_blockchain.discard();
+    m_pimpl->m_hash.discard();
+    m_pimpl->m_undo.discard();
 
     if (length() > 0)
         update_state();
@@ -65,6 +100,8 @@ void blockchain::clear()
 {
     m_pimpl->m_header.clear();
     m_pimpl->m_blockchain.clear();
+    m_pimpl->m_hash.clear();
+    m_pimpl->m_undo.clear();
 }
 
 void blockchain::update_state()
@@ -73,15 +110,13 @@ void blockchain::update_state()
     if (0 == length())
         return;
 
-    SignedBlock const& signed_block = at(length() - 1);
-
-    m_pimpl->m_last_header = signed_block.block_details.header;
-    m_pimpl->m_last_hash = meshpp::hash(signed_block.block_details.to_string());
+    m_pimpl->m_last_header = header_at(length() - 1);
+    m_pimpl->m_last_hash = m_pimpl->m_hash.at(length() - 1);
 }
 
 uint64_t blockchain::length() const
 {
-    return m_pimpl->m_blockchain.size();
+    return m_pimpl->m_header.size();
 }
 
 string blockchain::last_hash() const
@@ -110,6 +145,21 @@ BlockHeaderExtended blockchain::last_header_ex() const
 }
 
 void blockchain::insert(SignedBlock const& signed_block)
+{
+    insert(signed_block, meshpp::hash(signed_block.block_details.to_string()));
+}
+
+void blockchain::insert(SignedBlock const& signed_block, string const& block_hash)
+{
+    StorageTypes::BlockUndo undo;
+    undo.recorded = false;
+
+    insert(signed_block, block_hash, undo);
+}
+
+void blockchain::insert(SignedBlock const& signed_block,
+                        string const& block_hash,
+                        StorageTypes::BlockUndo const& undo)
 {
     Block const& block = signed_block.block_details;
 
@@ -120,25 +170,63 @@ void blockchain::insert(SignedBlock const& signed_block)
 
     m_pimpl->m_header.push_back(block.header);
     m_pimpl->m_blockchain.push_back(signed_block);
+    m_pimpl->m_hash.push_back(string(block_hash));
+    m_pimpl->m_undo.push_back(undo);
 
-    update_state();
+    m_pimpl->m_last_header = block.header;
+    m_pimpl->m_last_hash = block_hash;
+}
+
+void blockchain::insert_header(BlockHeader const& header, string const& block_hash)
+{
+    if (header.block_number != length())
+        throw std::runtime_error("Wrong block header to insert!");
+    if (0 != m_pimpl->m_blockchain.size())
+        throw std::runtime_error("Block header cannot follow a stored block!");
+
+    StorageTypes::BlockUndo undo;
+    undo.recorded = false;
+
+    m_pimpl->m_header.push_back(header);
+    m_pimpl->m_hash.push_back(string(block_hash));
+    m_pimpl->m_undo.push_back(undo);
+
+    m_pimpl->m_last_header = header;
+    m_pimpl->m_last_hash = block_hash;
 }
 
-BlockchainMessage::SignedBlock const& blockchain::at(uint64_t number) const
+uint64_t blockchain::first_block() const
 {
-    return m_pimpl->m_blockchain.as_const().at(number);
+    //  blocks are stored for the tail of the headers
+    return m_pimpl->m_header.size() - m_pimpl->m_blockchain.size();
 }
 
-BlockHeader const& blockchain::header_at(uint64_t number) const
+BlockchainMessage::SignedBlock blockchain::at(uint64_t number) const
 {
-    return m_pimpl->m_header.as_const().at(number);
+    uint64_t first = first_block();
+    if (number < first)
+        throw std::out_of_range("blockchain::at: only the header of block " +
+                                std::to_string(number) + " is stored");
+
+    return *m_pimpl->m_blockchain.at(number - first);
 }
+
+BlockHeader blockchain::header_at(uint64_t number) const
+{
+    return *m_pimpl->m_header.at(number);
+}
+
+StorageTypes::BlockUndo blockchain::undo_at(uint64_t number) const
+{
+    return *m_pimpl->m_undo.at(number);
+}
+
 BlockHeaderExtended blockchain::header_ex_at(uint64_t number) const
 {
     BlockHeaderExtended result;
-    if (number != m_pimpl->m_blockchain.size() - 1)
+    if (number != length() - 1)
     {
-        auto const& header = header_at(number);
+        auto header = header_at(number);
 
         result.block_number = header.block_number;
         result.c_const = header.c_const;
@@ -146,7 +234,7 @@ BlockHeaderExtended blockchain::header_ex_at(uint64_t number) const
         result.delta = header.delta;
         result.prev_hash = header.prev_hash;
         result.time_signed = header.time_signed;
-        result.block_hash = m_pimpl->m_header.as_const().at(number + 1).prev_hash;
+        result.block_hash = m_pimpl->m_hash.at(number);
     }
     else
         result = last_header_ex();
@@ -159,12 +247,245 @@ void blockchain::remove_last_block()
     if (length() == 1)
         throw std::runtime_error("Nothing to remove!");
 
+    if (length() - 1 < first_block())
+        throw std::runtime_error("Only the header of the last block is stored!");
+
     m_pimpl->m_header.pop_back();
     m_pimpl->m_blockchain.pop_back();
+    m_pimpl->m_hash.pop_back();
+    m_pimpl->m_undo.pop_back();
 
     update_state();
 }
 
+void blockchain::export_snapshot(snapshot_writer& writer) const
+{
+    uint64_t last = length() - 1;
+    auto time_signed_head = last_header().time_signed.tm;
+
+    //  same range as load_transaction_cache reads
+    uint64_t first = last;
+    while (first > first_block() &&
+           time_signed_head - header_at(first - 1).time_signed.tm <=
+           TRANSACTION_MAX_LIFETIME_HOURS * 3600 + NODES_TIME_SHIFT)
+        --first;
+
+    writer.table("block", last - first + 1);
+    for (uint64_t number = first; number <= last; ++number)
+    {
+        string value = at(number).to_string();
+        writer.record(m_pimpl->m_hash.at(number), value, value);
+    }
+
+    writer.table("header", length());
+    for (uint64_t number = 0; number <= last; ++number)
+    {
+        string value = header_at(number).to_string();
+        writer.record(m_pimpl->m_hash.at(number), value, value);
+    }
+}
+
+void blockchain::import_snapshot(snapshot_reader& reader)
+{
+    uint64_t block_number = reader.block_number();
+
+    vector<SignedBlock> signed_blocks;
+    uint64_t count = reader.table("block");
+    for (uint64_t index = 0; index != count; ++index)
+    {
+        string key, value;
+        reader.record(key, value);
+        reader.hash_record(key, value);
+
+        SignedBlock signed_block;
+        signed_block.from_string(value, detail::get_putl().get());
+        if (key != meshpp::hash(signed_block.block_details.to_string()))
+            throw std::runtime_error("blockchain::import_snapshot: wrong hash of block " +
+                                     std::to_string(signed_block.block_details.header.block_number));
+        signed_blocks.push_back(std::move(signed_block));
+    }
+
+    if (signed_blocks.empty() ||
+        signed_blocks.size() > block_number + 1 ||
+        signed_blocks.back().block_details.header.block_number != block_number)
+        throw std::runtime_error("blockchain::import_snapshot: the blocks do not end at the snapshot block");
+    uint64_t first = block_number + 1 - signed_blocks.size();
+
+    //  a shorter snapshot is checked against the stored headers,
+    //  a longer one must continue them and replaces the stored blocks
+    bool replace = block_number >= length();
+    vector<string> stored_hashes;
+    if (replace)
+    {
+        for (uint64_t number = 0; number != length(); ++number)
+            stored_hashes.push_back(m_pimpl->m_hash.at(number));
+        clear();
+    }
+
+    if (block_number + 1 != reader.table("header"))
+        throw std::runtime_error("blockchain::import_snapshot: wrong count of headers");
+
+    string prev_hash;
+    for (uint64_t number = 0; number <= block_number; ++number)
+    {
+        string key, value;
+        reader.record(key, value);
+        reader.hash_record(key, value);
+
+        BlockHeader header;
+        header.from_string(value, detail::get_putl().get());
+
+        if (header.block_number != number ||
+            (number > 0 && header.prev_hash != prev_hash) ||
+            (number == block_number && key != reader.block_hash()))
+            throw std::runtime_error("blockchain::import_snapshot: broken chain at header " +
+                                     std::to_string(number));
+
+        string const& stored_hash = replace ?
+                    (number < stored_hashes.size() ? stored_hashes[number] : key) :
+                    m_pimpl->m_hash.at(number);
+        if (stored_hash != key)
+            throw std::runtime_error("the snapshot at block " + std::to_string(block_number) +
+                                     " does not match the stored blockchain at block " +
+                                     std::to_string(number));
+
+        if (replace)
+        {
+            if (number < first)
+                insert_header(header, key);
+            else
+            {
+                SignedBlock const& signed_block = signed_blocks[number - first];
+                if (signed_block.block_details.header.to_string() != value)
+                    throw std::runtime_error("blockchain::import_snapshot: block " +
+                                             std::to_string(number) + " does not match its header");
+                insert(signed_block, key);
+            }
+        }
+
+        prev_hash = key;
+    }
+}
+
+void blockchain::backfill_hashes()
+{
+    auto& hashes = m_pimpl->m_hash;
+
+    //  data directories written before hashes were stored
+    //  get them computed once here
+    if (hashes.size() == length())
+        return;
+
+    beltpp::on_failure guard([&hashes]
+    {
+        hashes.discard();
+    });
+
+    while (hashes.size() > length())
+        hashes.pop_back();
+
+    while (hashes.size() < length())
+        hashes.push_back(meshpp::hash(at(hashes.size()).block_details.to_string()));
+
+    hashes.save();
+
+    guard.dismiss();
+    hashes.commit();
+}
+
+void blockchain::backfill_undo()
+{
+    auto& undo = m_pimpl->m_undo;
+
+    //  blocks applied before the undo records were kept
+    //  are reverted the old way, by computing back
+    if (undo.size() == length())
+        return;
+
+    beltpp::on_failure guard([&undo]
+    {
+        undo.discard();
+    });
+
+    while (undo.size() > length())
+        undo.pop_back();
+
+    StorageTypes::BlockUndo not_recorded;
+    not_recorded.recorded = false;
+    while (undo.size() < length())
+        undo.push_back(not_recorded);
+
+    undo.save();
+
+    guard.dismiss();
+    undo.commit();
+}
+
+uint64_t blockchain::migrate(boost::filesystem::path const& fs_blockchain)
+{
+    detail::blockchain_legacy legacy(fs_blockchain);
+    detail::blockchain_internals current(fs_blockchain);
+
+    uint64_t legacy_length = legacy.m_blockchain.size();
+    //  nothing left in the old format, migrated before or never used
+    if (0 == legacy_length)
+        return 0;
+
+    if (current.m_blockchain.size() > legacy_length ||
+        current.m_header.size() != current.m_blockchain.size())
+        throw std::runtime_error("blockchain::migrate: the blockchain is already in the new format");
+
+    //  continues from where an interrupted migration stopped
+    uint64_t number = current.m_blockchain.size();
+    while (number < legacy_length)
+    {
+        beltpp::on_failure guard([&current]
+        {
+            current.m_header.discard();
+            current.m_blockchain.discard();
+        });
+
+        for (uint64_t count = 0;
+             count < BLOCK_INSERT_LENGTH * 20 && number < legacy_length;
+             ++count, ++number)
+        {
+            SignedBlock const& signed_block = legacy.m_blockchain.as_const().at(number);
+            if (signed_block.block_details.header.block_number != number)
+                throw std::runtime_error("blockchain::migrate: wrong block number at " + std::to_string(number));
+
+            current.m_header.push_back(signed_block.block_details.header);
+            current.m_blockchain.push_back(signed_block);
+        }
+
+        current.m_header.save();
+        current.m_blockchain.save();
+
+        guard.dismiss();
+        current.m_header.commit();
+        current.m_blockchain.commit();
+
+        //  vector_loader keeps the loaded chunks until discard
+        legacy.m_blockchain.discard();
+    }
+
+    beltpp::on_failure guard([&legacy]
+    {
+        legacy.m_header.discard();
+        legacy.m_blockchain.discard();
+    });
+
+    legacy.m_header.clear();
+    legacy.m_blockchain.clear();
+    legacy.m_header.save();
+    legacy.m_blockchain.save();
+
+    guard.dismiss();
+    legacy.m_header.commit();
+    legacy.m_blockchain.commit();
+
+    return legacy_length;
+}
+
 string blockchain::get_miner(SignedBlock const& signed_block)
 {
     string miner;
@@ -2,6 +2,7 @@
 
 #include "global.hpp"
 #include "message.hpp"
+#include "types.hpp"
 #include "transaction_pool.hpp"
 
 #include <boost/filesystem/path.hpp>
@@ -16,6 +17,8 @@ namespace detail
 {
 class blockchain_internals;
 }
+class snapshot_writer;
+class snapshot_reader;
 
 class blockchain
 {
@@ -35,13 +38,37 @@ public:
     BlockchainMessage::BlockHeaderExtended last_header_ex() const;
 
     void insert(BlockchainMessage::SignedBlock const& signed_block);
-    BlockchainMessage::SignedBlock const& at(uint64_t number) const;
-    BlockchainMessage::BlockHeader const& header_at(uint64_t number) const;
+    //  block_hash must be already verified to match the block
+    void insert(BlockchainMessage::SignedBlock const& signed_block,
+                std::string const& block_hash);
+    //  undo is what the application of the block changed, see block_undo
+    void insert(BlockchainMessage::SignedBlock const& signed_block,
+                std::string const& block_hash,
+                StorageTypes::BlockUndo const& undo);
+    //  a node loaded from a snapshot keeps only the headers
+    //  of the blocks before the first one stored in full
+    void insert_header(BlockchainMessage::BlockHeader const& header,
+                       std::string const& block_hash);
+    uint64_t first_block() const;
+    //  by value, the stored blocks are cached only for a while
+    BlockchainMessage::SignedBlock at(uint64_t number) const;
+    BlockchainMessage::BlockHeader header_at(uint64_t number) const;
     BlockchainMessage::BlockHeaderExtended header_ex_at(uint64_t number) const;
+    StorageTypes::BlockUndo undo_at(uint64_t number) const;
     void remove_last_block();
 
+    //  the headers of the whole chain and the blocks recent enough to
+    //  fill the transaction cache, a longer snapshot replaces the stored
+    //  blocks with these, a shorter one must match the stored headers
+    void export_snapshot(snapshot_writer& writer) const;
+    void import_snapshot(snapshot_reader& reader);
+
     static std::string get_miner(BlockchainMessage::SignedBlock const& signed_block);
+    static uint64_t migrate(boost::filesystem::path const& fs_blockchain);
 private:
+    void backfill_hashes();
+    void backfill_undo();
+
     std::unique_ptr<detail::blockchain_internals> m_pimpl;
 };
 
@@ -4,54 +4,143 @@
 
 #include <unordered_set>
 #include <unordered_map>
+#include <cassert>
 
 namespace publiqpp
 {
 namespace detail
 {
-void event_queue_manager::next(beltpp::event_handler& eh,
-                               beltpp::stream* rpc_stream,
-                               meshpp::p2psocket* p2p_stream,
-                               beltpp::stream* on_demand_stream)
+bool connection_event(stream_event const& item)
+{
+    auto type = item.package.type();
+    return type == beltpp::stream_join::rtt ||
+           type == beltpp::stream_drop::rtt ||
+           type == beltpp::socket_open_refused::rtt ||
+           type == beltpp::socket_open_error::rtt;
+}
+
+void event_source_queue::push(stream_event&& item)
 {
-    if (false == queue.empty())
-        queue.pop();
+    auto insert_result = peers.insert(std::make_pair(item.peerid, std::deque<stream_event>()));
+    if (insert_result.second)
+        turns.push_back(item.peerid);
 
-    std::unordered_map<beltpp::event_item const*, std::unordered_set<beltpp::socket::peer_id>> dropped;
+    if (held.count(item.peerid))
+        ++held_count;
 
-    for (auto it = queue.cbegin(); it != queue.cend(); ++it)
+    insert_result.first->second.push_back(std::move(item));
+    ++count;
+}
+
+bool event_source_queue::pop(stream_event& item)
+{
+    for (size_t turn = turns.size(); turn != 0; --turn)
     {
-        if (it->et == detail::stream_event::message &&
-            it->package.type() == beltpp::stream_drop::rtt)
+        auto peerid = std::move(turns.front());
+        turns.pop_front();
+
+        auto it = peers.find(peerid);
+        assert(it != peers.end());
+        auto& peer_queue = it->second;
+
+        if (peer_queue.empty())
+        {
+            peers.erase(it);
+            continue;
+        }
+
+        if (held.count(peerid))
         {
-            dropped[it->pevent_source].insert(it->peerid);
+            turns.push_back(std::move(peerid));
+            continue;
         }
+
+        item = std::move(peer_queue.front());
+        peer_queue.pop_front();
+        --count;
+
+        if (peer_queue.empty())
+            peers.erase(it);
+        else
+            turns.push_back(std::move(peerid));
+
+        return true;
     }
 
-    // remove all pending requests that are already dropped
-    while (false == queue.empty() &&
-           is_message() &&
-           message().type() != beltpp::stream_join::rtt &&
-           message().type() != beltpp::stream_drop::rtt &&
-           message().type() != beltpp::socket_open_refused::rtt &&
-           message().type() != beltpp::socket_open_error::rtt &&
-           dropped[message_source()].count(message_peerid()))
+    return false;
+}
+
+void event_source_queue::drop(beltpp::socket::peer_id const& peerid)
+{
+    auto it = peers.find(peerid);
+    if (it == peers.end())
+        return;
+
+    //  the entry stays until its turn comes
+    auto& peer_queue = it->second;
+    std::deque<stream_event> kept;
+    for (auto& item : peer_queue)
     {
-        queue.pop();
+        if (connection_event(item))
+            kept.push_back(std::move(item));
     }
-    
-    if (queue.empty() && event_read)
+
+    count -= peer_queue.size() - kept.size();
+    if (held.count(peerid))
+        held_count -= peer_queue.size() - kept.size();
+    peer_queue = std::move(kept);
+}
+
+bool event_source_queue::empty() const
+{
+    return count == held_count;
+}
+
+size_t event_source_queue::size() const
+{
+    return count;
+}
+
+size_t event_source_queue::size(beltpp::socket::peer_id const& peerid) const
+{
+    auto it = peers.find(peerid);
+    if (it == peers.end())
+        return 0;
+
+    return it->second.size();
+}
+
+void event_source_queue::hold(beltpp::socket::peer_id const& peerid)
+{
+    if (held.insert(peerid).second)
+        held_count += size(peerid);
+}
+
+void event_source_queue::release(beltpp::socket::peer_id const& peerid)
+{
+    if (held.erase(peerid))
+        held_count -= size(peerid);
+}
+
+void event_queue_manager::next(beltpp::event_handler& eh,
+                               beltpp::stream* rpc_stream,
+                               meshpp::p2psocket* p2p_stream,
+                               beltpp::stream* on_demand_stream)
+{
+    current = stream_event::empty_result();
+
+    if (empty() && event_read)
     {
         event_read = false;
-        while (false == queue_async.empty())
-        {
-            queue.push(std::move(queue_async.front()));
-            queue_async.pop();
-        }
+        for (auto& item : queue_async)
+            push(std::move(item), rpc_stream, on_demand_stream);
+        queue_async.clear();
     }
 
-    if (queue.empty())
+    if (empty())
     {
+        refused_peers.clear();
+
         std::unordered_set<beltpp::event_item const*> wait_streams;
 
         beltpp::event_handler::wait_result wait_result = eh.wait(wait_streams);
@@ -68,7 +157,7 @@ void event_queue_manager::next(beltpp::event_handler& eh,
                     pevent_item = rpc_stream;
                     received_packets = rpc_stream->receive(peerid);
                 }
-                else if (wait_stream_item == &p2p_stream->worker())
+                else if (p2p_stream && wait_stream_item == &p2p_stream->worker())
                 {
                     pevent_item = p2p_stream;
                     received_packets = p2p_stream->receive(peerid);
@@ -79,12 +168,14 @@ void event_queue_manager::next(beltpp::event_handler& eh,
                 if (false == received_packets.empty())
                     event_read = true;
                 for (auto&& reveived_packet : received_packets)
-                    queue.push(stream_event::event_result(pevent_item, peerid, std::move(reveived_packet)));
+                    push(stream_event::event_result(pevent_item, peerid, std::move(reveived_packet)),
+                         rpc_stream,
+                         on_demand_stream);
             }
         }
 
         if (wait_result & beltpp::event_handler::timer_out)
-            queue.push(stream_event::timer_result());
+            timer_pending = true;
 
         if (on_demand_stream && (wait_result & beltpp::event_handler::on_demand))
         {
@@ -96,74 +187,185 @@ void event_queue_manager::next(beltpp::event_handler& eh,
             if (false == received_packets.empty())
                 event_read = true;
             for (auto&& reveived_packet : received_packets)
-                queue.push(stream_event::event_result(pevent_item, peerid, std::move(reveived_packet)));
+                push(stream_event::event_result(pevent_item, peerid, std::move(reveived_packet)),
+                     rpc_stream,
+                     on_demand_stream);
         }
     }
+
+    if (timer_pending)
+    {
+        timer_pending = false;
+        current = stream_event::timer_result();
+        return;
+    }
+
+    while (pop(current))
+    {
+        if (false == current.busy)
+            return;
+
+        rpc_stream->send(current.peerid, std::move(current.package));
+    }
+
+    current = stream_event::empty_result();
 }
 
-bool event_queue_manager::is_timer() const
+bool event_queue_manager::pop(stream_event& item)
 {
-    if (false == queue.empty() && queue.front().et == detail::stream_event::timer)
-        return true;
+    event_source_queue* sources[] = {&queue_p2p, &queue_direct, &queue_rpc};
+    size_t const weights[] = {EVENT_QUEUE_P2P_WEIGHT, EVENT_QUEUE_DIRECT_WEIGHT, EVENT_QUEUE_RPC_WEIGHT};
+    size_t const count = sizeof(weights) / sizeof(weights[0]);
+
+    //  one more visit, to come back to the source of the turn with a new weight
+    for (size_t visited = 0; visited != count + 1; ++visited)
+    {
+        if (source_served < weights[source_turn] &&
+            sources[source_turn]->pop(item))
+        {
+            ++source_served;
+            return true;
+        }
+
+        source_turn = (source_turn + 1) % count;
+        source_served = 0;
+    }
 
     return false;
 }
 
-bool event_queue_manager::is_message() const
+void event_queue_manager::push(stream_event&& item,
+                               beltpp::stream* rpc_stream,
+                               beltpp::stream* on_demand_stream)
 {
-    if (false == queue.empty() && queue.front().et == detail::stream_event::message)
-        return true;
+    if (item.pevent_source == on_demand_stream)
+        return queue_direct.push(std::move(item));
+    if (item.pevent_source != rpc_stream)
+    {
+        //  the requests of a dropped peer are not processed
+        if (item.package.type() == beltpp::stream_drop::rtt)
+            queue_p2p.drop(item.peerid);
+        return queue_p2p.push(std::move(item));
+    }
 
-    return false;
+    if (item.package.type() == beltpp::stream_drop::rtt)
+        queue_rpc.drop(item.peerid);
+    else if (0 == item.rescheduled &&
+             false == connection_event(item))
+    {
+        if (refused_peers.count(item.peerid))
+            return;
+
+        //  the busy answers are queued too, not to overtake the answers
+        //  to what the client sent before, that it waits for
+        if (queue_rpc.size(item.peerid) >= 2 * EVENT_QUEUE_PEER_MAX)
+        {
+            refused_peers.insert(item.peerid);
+            queue_rpc.drop(item.peerid);
+            rpc_stream->send(item.peerid, beltpp::packet(beltpp::stream_drop()));
+            return;
+        }
+
+        if (queue_rpc.size(item.peerid) >= EVENT_QUEUE_PEER_MAX ||
+            queue_rpc.size() >= EVENT_QUEUE_RPC_MAX)
+        {
+            ++refused_count;
+
+            BlockchainMessage::RemoteError msg;
+            msg.message = "busy";
+            item.package = beltpp::packet(std::move(msg));
+            item.busy = true;
+        }
+    }
+
+    queue_rpc.push(std::move(item));
+}
+
+bool event_queue_manager::empty() const
+{
+    return queue_p2p.empty() &&
+           queue_direct.empty() &&
+           queue_rpc.empty() &&
+           false == timer_pending;
+}
+
+bool event_queue_manager::is_timer() const
+{
+    return current.et == detail::stream_event::timer;
+}
+
+bool event_queue_manager::is_message() const
+{
+    return current.et == detail::stream_event::message;
 }
 
 beltpp::event_item const* event_queue_manager::message_source() const
 {
-    if (queue.empty() || queue.front().et != detail::stream_event::message)
-        throw std::logic_error("event_queue_manager::message_source: queue.empty() || queue.front().et != detail::stream_event::message");
+    if (current.et != detail::stream_event::message)
+        throw std::logic_error("event_queue_manager::message_source: current.et != detail::stream_event::message");
 
-    return queue.front().pevent_source;
+    return current.pevent_source;
 }
 
 beltpp::socket::peer_id event_queue_manager::message_peerid() const
 {
-    if (queue.empty() || queue.front().et != detail::stream_event::message)
-        throw std::logic_error("event_queue_manager::message_peerid: queue.empty() || queue.front().et != detail::stream_event::message");
+    if (current.et != detail::stream_event::message)
+        throw std::logic_error("event_queue_manager::message_peerid: current.et != detail::stream_event::message");
 
-    return queue.front().peerid;
+    return current.peerid;
 }
 
 
 beltpp::packet& event_queue_manager::message()
 {
-    if (queue.empty() || queue.front().et != detail::stream_event::message)
-        throw std::logic_error("event_queue_manager::message: queue.empty() || queue.front().et != detail::stream_event::message");
+    if (current.et != detail::stream_event::message)
+        throw std::logic_error("event_queue_manager::message: current.et != detail::stream_event::message");
 
-    return queue.front().package;
+    return current.package;
 }
 
 void event_queue_manager::reschedule()
 {
-    if (queue.empty() || queue.front().et != detail::stream_event::message)
-        throw std::logic_error("event_queue_manager::reschedule: queue.empty() || queue.front().et != detail::stream_event::message");
+    if (current.et != detail::stream_event::message)
+        throw std::logic_error("event_queue_manager::reschedule: current.et != detail::stream_event::message");
     
-    queue.front().rescheduled++;
-    queue_async.push(std::move(queue.front()));
+    current.rescheduled++;
+    queue_async.push_back(std::move(current));
 }
 
 size_t event_queue_manager::count_rescheduled() const
 {
-    if (queue.empty() || queue.front().et != detail::stream_event::message)
-        throw std::logic_error("event_queue_manager::count_rescheduled: queue.empty() || queue.front().et != detail::stream_event::message");
-    return queue.front().rescheduled;
+    if (current.et != detail::stream_event::message)
+        throw std::logic_error("event_queue_manager::count_rescheduled: current.et != detail::stream_event::message");
+    return current.rescheduled;
 }
 
 std::chrono::steady_clock::duration event_queue_manager::pending_duration() const
 {
-    if (queue.empty() || queue.front().et != detail::stream_event::message)
-        throw std::logic_error("event_queue_manager::pending_duration: queue.empty() || queue.front().et != detail::stream_event::message");
-    return std::chrono::steady_clock::now() - queue.front().tm;
+    if (current.et != detail::stream_event::message)
+        throw std::logic_error("event_queue_manager::pending_duration: current.et != detail::stream_event::message");
+    return std::chrono::steady_clock::now() - current.tm;
+}
+
+size_t event_queue_manager::backlog() const
+{
+    return queue_p2p.size() + queue_direct.size() + queue_rpc.size();
+}
+
+uint64_t event_queue_manager::refused() const
+{
+    return refused_count;
+}
+
+void event_queue_manager::hold(beltpp::socket::peer_id const& peerid)
+{
+    queue_rpc.hold(peerid);
+}
+
+void event_queue_manager::release(beltpp::socket::peer_id const& peerid)
+{
+    queue_rpc.release(peerid);
 }
 
 }   // end namespace detail
-}   // end namespace publiqpp
\ No newline at end of file
+}   // end namespace publiqpp
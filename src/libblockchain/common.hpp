@@ -9,13 +9,14 @@
 #include <belt.pp/ievent.hpp>
 #include <belt.pp/socket.hpp>
 #include <belt.pp/packet.hpp>
-#include <belt.pp/queue.hpp>
 
 #include <mesh.pp/p2psocket.hpp>
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <chrono>
 
@@ -32,6 +33,19 @@ std::string const storage_peerid = "storage";
 #define BLOCK_INSERT_LENGTH 50
 #define BLOCK_REVERT_LENGTH 50
 
+// Chunks of blocks requested ahead while syncing,
+// other peers that have the blocks to help with it
+// and requests waiting for response per peer
+#define BLOCK_DOWNLOAD_WINDOW 8
+#define BLOCK_DOWNLOAD_PEERS 4
+#define BLOCK_DOWNLOAD_PEER_REQUESTS 2
+
+// Blocks are downloaded in compact form if at most this many
+// are missing, their transactions are given by as many first
+// characters of the transaction hashes
+#define BLOCK_COMPACT_DEPTH 3
+#define BLOCK_COMPACT_ID_LENGTH 16
+
 // Block mine delay in seconds
 #define BLOCK_MINE_DELAY 600
 #define BLOCK_WAIT_DELAY 120
@@ -44,12 +58,25 @@ std::string const storage_peerid = "storage";
 // Block maximum transactions count
 #define BLOCK_MAX_TRANSACTIONS 1000ull
 
+// Count of successfully checked signatures to remember
+#define SIGNATURE_CACHE_SIZE 100000
+
 // Action log max response count
 #define ACTION_LOG_MAX_RESPONSE 10000
 
+// Action log entries kept for the requests answered off the main thread
+#define ACTION_LOG_VIEW_LENGTH (2 * ACTION_LOG_MAX_RESPONSE)
+
 // Max chunk size of files to request and process at a time
 #define STORAGE_MAX_FILE_REQUESTS 100
 
+// Max length of a file part served per open ended range request
+#define STORAGE_MAX_RANGE_LENGTH (4 * 1024 * 1024)
+
+// Http answers with storage files are read from disk
+// and sent in parts of this length
+#define STORAGE_HTTP_PART_LENGTH (1024 * 1024)
+
 // Timers in seconds
 #define CHECK_TIMER 1
 #define SYNC_TIMER  30
@@ -57,9 +84,54 @@ std::string const storage_peerid = "storage";
 #define BROADCAST_TIMER 1800
 #define CACHE_CLEANUP_TIMER 300
 #define SUMMARY_REPORT_TIMER 1800
+#define INVENTORY_TIMER 1
 
 #define TRANSACTION_MAX_LIFETIME_HOURS 24
 
+// Stored size of pool transactions above which
+// the lowest fee rate ones are evicted
+#define TRANSACTION_POOL_MAX_BYTES (64 * 1024 * 1024)
+
+// Broadcast inventory limits, bodies are kept for peers
+// to request for INVENTORY_KEEP_SECONDS, one peer is asked
+// at a time and INVENTORY_REQUEST_TIMEOUT seconds is waited
+#define INVENTORY_MAX_HASHES 1000
+#define INVENTORY_PEER_KNOWN 100000
+#define INVENTORY_KEEP_SECONDS 600
+#define INVENTORY_REQUEST_TIMEOUT 10
+
+// Received rpc messages waiting to be processed, per client and in total
+// a client going above either is answered busy, in the order it sent,
+// one that keeps sending up to twice the client limit is disconnected
+#define EVENT_QUEUE_PEER_MAX 64
+#define EVENT_QUEUE_RPC_MAX 10000
+
+// Messages taken in a row from the p2p, the direct and the rpc
+// queues in turn, so that none of them waits behind the others
+#define EVENT_QUEUE_P2P_WEIGHT 4
+#define EVENT_QUEUE_DIRECT_WEIGHT 2
+#define EVENT_QUEUE_RPC_WEIGHT 1
+
+// Requests in one batch posted to /api as a json array,
+// the batch counts as one request for the rate limits
+#define RPC_BATCH_MAX_REQUESTS 100
+
+// Token bucket limits of received messages, per second and burst
+// rpc requests per client and per remote address, the costly ones
+// also per their type from an address, p2p broadcasts per peer
+#define ADMISSION_PEER_RATE 50
+#define ADMISSION_PEER_BURST 200
+#define ADMISSION_ADDRESS_RATE 200
+#define ADMISSION_ADDRESS_BURST 1000
+#define ADMISSION_TYPE_RATE 10
+#define ADMISSION_TYPE_BURST 50
+#define ADMISSION_P2P_RATE 500
+#define ADMISSION_P2P_BURST 5000
+
+// Broadcast transactions larger than this are refused before
+// their signatures are checked
+#define ADMISSION_TRANSACTION_MAX_BYTES (1024 * 1024)
+
 // Maximum time shift on seconds
 // acceptable between nodes
 #define NODES_TIME_SHIFT 60
@@ -202,6 +274,8 @@ public:
     enum event_type {nothing, message, timer};
     event_type et = nothing;
     size_t rescheduled = false;
+    //  the package is the busy answer to send instead of processing
+    bool busy = false;
     beltpp::event_item const* pevent_source = nullptr;
     beltpp::socket::peer_id peerid;
     beltpp::packet package;
@@ -243,6 +317,35 @@ public:
     }
 };
 
+//  messages of one source, a queue per peer taken in turns
+class event_source_queue
+{
+public:
+    void push(stream_event&& item);
+    bool pop(stream_event& item);
+    //  removes what the peer sent except the connection events
+    void drop(beltpp::socket::peer_id const& peerid);
+
+    bool empty() const;
+    size_t size() const;
+    size_t size(beltpp::socket::peer_id const& peerid) const;
+
+    //  a held peer keeps its messages until released, the others take its turns
+    void hold(beltpp::socket::peer_id const& peerid);
+    void release(beltpp::socket::peer_id const& peerid);
+
+private:
+    size_t count = 0;
+    size_t held_count = 0;
+    std::unordered_set<beltpp::socket::peer_id> held;
+    //  a peer is in the turns as long as it has an entry
+    std::unordered_map<beltpp::socket::peer_id, std::deque<stream_event>> peers;
+    std::deque<beltpp::socket::peer_id> turns;
+};
+
+//  the p2p, the direct stream and the rpc take turns by their weights, the timer
+//  goes first when due, the sockets are read only when nothing is left
+//  when the rpc backlog is over its limits the client that adds to it is answered busy
 class event_queue_manager
 {
 public:
@@ -260,10 +363,34 @@ public:
     size_t count_rescheduled() const;
     std::chrono::steady_clock::duration pending_duration() const;
 
+    size_t backlog() const;
+    uint64_t refused() const;
+
+    //  what the rpc client sent is not processed while it waits for an answer,
+    //  so the pipelined requests are answered in the order they came
+    void hold(beltpp::socket::peer_id const& peerid);
+    void release(beltpp::socket::peer_id const& peerid);
+
 private:
+    bool empty() const;
+    bool pop(stream_event& item);
+    void push(stream_event&& item,
+              beltpp::stream* rpc_stream,
+              beltpp::stream* on_demand_stream);
+
     bool event_read = false;
-    beltpp::queue<stream_event> queue;
-    beltpp::queue<stream_event> queue_async;
+    bool timer_pending = false;
+    //  the source taking its turn and how many it gave in this turn
+    size_t source_turn = 0;
+    size_t source_served = 0;
+    uint64_t refused_count = 0;
+    //  disconnected while reading, the rest they sent is ignored
+    std::unordered_set<beltpp::socket::peer_id> refused_peers;
+    stream_event current;
+    event_source_queue queue_p2p;
+    event_source_queue queue_direct;
+    event_source_queue queue_rpc;
+    std::vector<stream_event> queue_async;
 };
 
 }
@@ -776,28 +776,12 @@ revert_pool(time_t expiry_time, publiqpp::detail::node_internals& impl)
 {
     vector<SignedTransaction> pool_transactions;
 
-    //  collect transactions to be reverted from pool
+    //  revert transactions from pool, keep the not expired and not evicted
     //
-    size_t state_pool_size = impl.m_transaction_pool.length();
-
-    for (size_t index = 0; index != state_pool_size; ++index)
+    while (impl.m_transaction_pool.length())
     {
-        SignedTransaction const& signed_transaction = impl.m_transaction_pool.at(index);
-
-        if (expiry_time <= signed_transaction.transaction_details.expiry.tm)
-        {
-            pool_transactions.push_back(signed_transaction);
-        }
-    }
-
-    //  revert transactions from pool
-    //
-    for (size_t index = state_pool_size; index != 0; --index)
-    {
-        SignedTransaction& ref_signed_transaction = impl.m_transaction_pool.ref_at(index - 1);
-        SignedTransaction signed_transaction = std::move(ref_signed_transaction);
-
-        impl.m_transaction_pool.pop_back();
+        SignedTransaction signed_transaction;
+        bool keep = impl.m_transaction_pool.pop_back(signed_transaction);
         bool complete = impl.m_transaction_cache.erase_pool(signed_transaction);
 
         if (complete)
@@ -805,14 +789,14 @@ revert_pool(time_t expiry_time, publiqpp::detail::node_internals& impl)
             impl.m_action_log.revert();
             revert_transaction(signed_transaction, impl);
         }
-    }
 
-    assert(impl.m_transaction_pool.length() == 0);
+        if (keep &&
+            expiry_time <= signed_transaction.transaction_details.expiry.tm)
+            pool_transactions.push_back(std::move(signed_transaction));
+    }
 
-    //  sync the node balance at chain level
-    impl.m_state.set_balance(impl.front_public_key().to_string(),
-                             impl.m_state.get_balance(impl.front_public_key().to_string(), state_layer::pool),
-                             state_layer::chain);
+    //  in the order they were applied
+    std::reverse(pool_transactions.begin(), pool_transactions.end());
 
     return pool_transactions;
 }
@@ -836,7 +820,7 @@ void mine_block(publiqpp::detail::node_internals& impl)
         block_index = block_number + 1 - DELTA_STEP;
     for (; block_index <= block_number; ++block_index)
     {
-        BlockHeader const& tmp_header = impl.m_blockchain.header_at(block_index);
+        BlockHeader tmp_header = impl.m_blockchain.header_at(block_index);
         delta_vector.push_back(std::make_pair(tmp_header.delta, tmp_header.c_const));
     }
 
@@ -848,10 +832,9 @@ void mine_block(publiqpp::detail::node_internals& impl)
     if (false == check_delta_vector_error.empty())
         throw std::logic_error("own blockchain is somehow wrong");
 
-    SignedBlock const& prev_signed_block = impl.m_blockchain.at(block_number);
     BlockHeader const& prev_header = impl.m_blockchain.last_header();
     string miner_address = impl.front_public_key().to_string();
-    string prev_hash = meshpp::hash(prev_signed_block.block_details.to_string());
+    string prev_hash = impl.m_blockchain.last_hash();
 
     uint64_t delta = impl.calc_delta(miner_address,
                                      impl.get_balance().whole,
@@ -1150,6 +1133,9 @@ void mine_block(publiqpp::detail::node_internals& impl)
         return lhs.transaction_details.creation.tm < rhs.transaction_details.creation.tm;
     });
 
+    //  what the block changes is recorded from here to its insert
+    impl.m_block_undo.begin();
+
     // check and copy transactions to block
     for (auto& signed_transaction : block_transactions)
     {
@@ -1203,25 +1189,30 @@ void mine_block(publiqpp::detail::node_internals& impl)
                   unit_uri_view_counts,
                   applied_sponsor_items);
 
-    meshpp::signature sgn = impl.front_private_key().sign(block.to_string());
-
     SignedBlock signed_block;
+    signed_block.block_details = std::move(block);
+
+    //  serialized and hashed once for signing, storing and logging
+    memoized_block block_memo(signed_block);
+
+    meshpp::signature sgn = impl.front_private_key().sign(block_memo.str());
     signed_block.authorization.address = sgn.pb_key.to_string();
     signed_block.authorization.signature = sgn.base58;
-    signed_block.block_details = std::move(block);
 
     // apply rewards to state
     for (auto& reward : signed_block.block_details.rewards)
         impl.m_state.increase_balance(reward.to, reward.amount, state_layer::chain);
 
     // insert to blockchain and action_log
-    impl.m_blockchain.insert(signed_block);
-    impl.m_action_log.log_block(signed_block, unit_uri_view_counts, applied_sponsor_items);
+    impl.m_blockchain.insert(signed_block, block_memo.digest(), impl.m_block_undo.end());
+    impl.m_action_log.log_block(block_memo, unit_uri_view_counts, applied_sponsor_items);
+    impl.prepare_snapshot();
 
     // apply back rest of the pool content to the state and action_log
     for (auto& signed_transaction : pool_transactions)
     {
         bool complete = action_is_complete(impl, signed_transaction);
+        memoized_transaction transaction_memo(signed_transaction);
 
         bool ok_logic = true;
         if (complete ||
@@ -1232,13 +1223,13 @@ void mine_block(publiqpp::detail::node_internals& impl)
         {
             ok_logic = apply_transaction(signed_transaction, impl);
             if (ok_logic)
-                impl.m_action_log.log_transaction(signed_transaction);
+                impl.m_action_log.log_transaction(transaction_memo);
         }
 
         if (ok_logic)
         {
-            impl.m_transaction_pool.push_back(signed_transaction);
-            impl.m_transaction_cache.add_pool(signed_transaction, complete);
+            impl.m_transaction_pool.push_back(transaction_memo);
+            impl.m_transaction_cache.add_pool(transaction_memo, complete);
         }
     }
 
@@ -1295,10 +1286,8 @@ void broadcast_node_type(std::unique_ptr<publiqpp::detail::node_internals>& m_pi
 
         broadcast_message(std::move(broadcast),
                           m_pimpl->m_ptr_p2p_socket->name(),
-                          m_pimpl->m_ptr_p2p_socket->name(),
-                          true, // broadcast to all peers
-                          nullptr, // log disabled
                           m_pimpl->m_p2p_peers,
+                          m_pimpl->m_inventory,
                           m_pimpl->m_ptr_p2p_socket.get());
     }
 }
@@ -1365,10 +1354,8 @@ void broadcast_address_info(std::unique_ptr<publiqpp::detail::node_internals>& m
 
         broadcast_message(std::move(broadcast),
                           m_pimpl->m_ptr_p2p_socket->name(),
-                          m_pimpl->m_ptr_p2p_socket->name(),
-                          true, // broadcast to all peers
-                          nullptr, // log disabled
                           m_pimpl->m_p2p_peers,
+                          m_pimpl->m_inventory,
                           m_pimpl->m_ptr_p2p_socket.get());
     }
 }
@@ -1418,6 +1405,7 @@ bool process_address_info(SignedTransaction const& signed_transaction,
     pimpl->m_transaction_cache.add_pool(signed_transaction, true);
 
     guard.dismiss();
+    pimpl->m_transaction_cache.commit();
 
     return true;
 }
@@ -1466,6 +1454,7 @@ bool process_update_command(BlockchainMessage::SignedTransaction const& signed_t
     pimpl->m_transaction_cache.add_pool(signed_transaction, true);
 
     guard.dismiss();
+    pimpl->m_transaction_cache.commit();
 
     return true;
 }
@@ -1508,10 +1497,8 @@ void broadcast_service_statistics(publiqpp::detail::node_internals& impl)
 
         broadcast_message(std::move(broadcast),
                           impl.m_ptr_p2p_socket->name(),
-                          impl.m_ptr_p2p_socket->name(),
-                          true, // broadcast to all peers
-                          nullptr, // log disabled
                           impl.m_p2p_peers,
+                          impl.m_inventory,
                           impl.m_ptr_p2p_socket.get());
     }
 }
@@ -1547,10 +1534,8 @@ void broadcast_storage_update(publiqpp::detail::node_internals& impl,
 
         broadcast_message(std::move(broadcast),
                           impl.m_ptr_p2p_socket->name(),
-                          impl.m_ptr_p2p_socket->name(),
-                          true, // broadcast to all peers
-                          nullptr, // log disabled
                           impl.m_p2p_peers,
+                          impl.m_inventory,
                           impl.m_ptr_p2p_socket.get());
     }
 }
@@ -1630,6 +1615,7 @@ bool process_letter(SignedTransaction const& signed_transaction,
     impl.m_transaction_cache.add_pool(signed_transaction, true);
 
     guard.dismiss();
+    impl.m_transaction_cache.commit();
 
     if (letter_to_me)
         impl.m_inbox.commit();
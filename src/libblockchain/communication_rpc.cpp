@@ -3,38 +3,34 @@
 #include "common.hpp"
 #include "exception.hpp"
 #include "message.tmpl.hpp"
+#include "serialized_packet.hpp"
 
 #include <stack>
+#include <utility>
+#include <memory>
 
 using std::stack;
+using std::pair;
 
 namespace publiqpp
 {
-size_t get_action_size(beltpp::packet const& package)
+namespace detail
 {
-    if (package.type() == BlockLog::rtt)
-    {
-        BlockLog block_log;
-        package.get(block_log);
-
-        return 1 +
-               block_log.rewards.size() +
-               block_log.transactions.size() +
-               block_log.unit_uri_impacts.size() + 
-               block_log.applied_sponsor_items.size();
-    }
-
-    return 1;
+uint64_t broadcast_encoded = 0;
+uint64_t broadcast_bytes_saved = 0;
 }
 
-void get_actions(LoggedTransactionsRequest const& msg_get_actions,
-                 publiqpp::action_log& action_log,
-                 beltpp::stream& sk,
-                 beltpp::stream::peer_id const& peerid)
+namespace
+{
+template <typename T_action_log>
+beltpp::packet get_actions_from(LoggedTransactionsRequest const& msg_get_actions,
+                                T_action_log const& action_log)
 {
     uint64_t start_index = msg_get_actions.start_index;
 
-    stack<LoggedTransaction> action_stack;
+    //  the page is laid out from entry info alone,
+    //  only the entries that end up in the response are read
+    stack<pair<size_t, uint64_t>> index_stack;
 
     size_t count = 0;
     size_t i = start_index;
@@ -42,93 +38,88 @@ void get_actions(LoggedTransactionsRequest const& msg_get_actions,
     size_t max_count = msg_get_actions.max_count < ACTION_LOG_MAX_RESPONSE ?
                        msg_get_actions.max_count : ACTION_LOG_MAX_RESPONSE;
 
-    bool revert = i < len;
-    while (revert && count < max_count) //the case when next action is revert
+    for (; i < len && count < max_count; ++i) //the case when next action is revert
     {
-        LoggedTransaction action_info;
-        action_log.at(i, action_info);
-
-        revert = (action_info.logging_type == LoggingType::revert && i < len);
+        auto const& info = action_log.info(i);
+        if (false == info.revert)
+            break;
 
-        if (revert)
-        {
-            count += get_action_size(action_info.action);
-
-            action_info.index = i;
-            action_stack.push(std::move(action_info));
-
-            ++i;
-        }
+        count += info.weight;
+        index_stack.push(std::make_pair(i, info.weight));
     }
 
     for (; i < len && count < max_count; ++i)
     {
-        LoggedTransaction action_info;
-        action_log.at(i, action_info);
+        auto const& info = action_log.info(i);
 
         // remove all not received entries and their reverts
-        if (action_info.logging_type == LoggingType::revert && action_info.index >= start_index)
+        if (info.revert && info.index >= start_index)
         {
-            count -= get_action_size(action_stack.top().action);
-
-            action_stack.pop();
+            count -= index_stack.top().second;
+            index_stack.pop();
         }
         else
         {
-            count += get_action_size(action_info.action);
-
-            action_info.index = i;
-            action_stack.push(std::move(action_info));
+            count += info.weight;
+            index_stack.push(std::make_pair(i, info.weight));
         }
     }
 
     LoggedTransactions msg_actions;
-    len = action_stack.size();
+    len = index_stack.size();
     msg_actions.actions.resize(len);
 
     for (i = len - 1; i < len; --i)
     {
-        msg_actions.actions[i] = std::move(action_stack.top());
-        action_stack.pop();
+        auto& action_info = msg_actions.actions[i];
+        action_log.at(index_stack.top().first, action_info);
+        action_info.index = index_stack.top().first;
+        index_stack.pop();
     }
-    assert(action_stack.empty());
+    assert(index_stack.empty());
+
+    return beltpp::packet(std::move(msg_actions));
+}
+}
 
-    sk.send(peerid, beltpp::packet(std::move(msg_actions)));
+beltpp::packet get_actions(LoggedTransactionsRequest const& msg_get_actions,
+                           publiqpp::action_log const& action_log)
+{
+    return get_actions_from(msg_get_actions, action_log);
+}
+
+beltpp::packet get_actions(LoggedTransactionsRequest const& msg_get_actions,
+                           publiqpp::action_log_view const& action_log)
+{
+    return get_actions_from(msg_get_actions, action_log);
 }
 
-void get_hash(DigestRequest&& msg_get_hash,
-              beltpp::stream& sk,
-              beltpp::stream::peer_id const& peerid)
+beltpp::packet get_hash(DigestRequest&& msg_get_hash)
 {
     Digest msg_hash_result;
     msg_hash_result.base58_hash = meshpp::hash(msg_get_hash.package.to_string());
     msg_hash_result.package = std::move(msg_get_hash.package);
 
-    sk.send(peerid, beltpp::packet(std::move(msg_hash_result)));
+    return beltpp::packet(std::move(msg_hash_result));
 }
 
-void get_random_seed(beltpp::stream& sk,
-                     beltpp::stream::peer_id const& peerid)
+beltpp::packet get_random_seed()
 {
     meshpp::random_seed rs;
     MasterKey rs_msg;
     rs_msg.master_key = rs.get_brain_key();
 
-    sk.send(peerid, beltpp::packet(std::move(rs_msg)));
+    return beltpp::packet(std::move(rs_msg));
 }
 
-void get_public_addresses(beltpp::stream& sk,
-                          beltpp::stream::peer_id const& peerid,
-                          publiqpp::detail::node_internals& impl)
+beltpp::packet get_public_addresses(publiqpp::nodeid_addresses const& addresses)
 {
-    PublicAddressesInfo result = impl.m_nodeid_service.get_addresses();
+    PublicAddressesInfo result = addresses.get_addresses();
 
-    sk.send(peerid, beltpp::packet(std::move(result)));
+    return beltpp::packet(std::move(result));
 }
 
-void get_peers_addresses(beltpp::stream& sk,
-                         beltpp::stream::peer_id const& peerid,
-                         publiqpp::detail::node_internals& impl)
+beltpp::packet get_peers_addresses(publiqpp::detail::node_internals& impl)
 {
     PublicAddressesInfo result;
     for (auto const& item : impl.m_p2p_peers)
@@ -140,12 +131,10 @@ void get_peers_addresses(beltpp::stream& sk,
         result.addresses_info.push_back(std::move(info));
     }
 
-    sk.send(peerid, beltpp::packet(std::move(result)));
+    return beltpp::packet(std::move(result));
 }
 
-void get_key_pair(KeyPairRequest const& kpr_msg,
-                  beltpp::stream& sk,
-                  beltpp::stream::peer_id const& peerid)
+beltpp::packet get_key_pair(KeyPairRequest const& kpr_msg)
 {
     meshpp::random_seed rs(kpr_msg.master_key);
     meshpp::private_key pv = rs.get_private_key(kpr_msg.index);
@@ -157,12 +146,10 @@ void get_key_pair(KeyPairRequest const& kpr_msg,
     kp_msg.public_key = pb.to_string();
     kp_msg.index = kpr_msg.index;
 
-    sk.send(peerid, beltpp::packet(std::move(kp_msg)));
+    return beltpp::packet(std::move(kp_msg));
 }
 
-void get_signature(SignRequest&& msg,
-                   beltpp::stream& sk,
-                   beltpp::stream::peer_id const& peerid)
+beltpp::packet get_signature(SignRequest&& msg)
 {
     meshpp::private_key pv(msg.private_key);
     meshpp::signature signed_msg = pv.sign(msg.package.to_string());
@@ -172,100 +159,137 @@ void get_signature(SignRequest&& msg,
     sg_msg.signature = signed_msg.base58;
     sg_msg.public_key = pv.get_public_key().to_string();
 
-    sk.send(peerid, beltpp::packet(std::move(sg_msg)));
+    return beltpp::packet(std::move(sg_msg));
 }
 
-void verify_signature(Signature const& msg,
-                      beltpp::stream& sk,
-                      beltpp::stream::peer_id const& peerid)
+beltpp::packet verify_signature(Signature const& msg)
 {
     meshpp::signature signed_msg(msg.public_key, msg.package.to_string(), msg.signature);
 
-    sk.send(peerid, beltpp::packet(Done()));
+    return beltpp::packet(Done());
 }
 
-void broadcast_message(BlockchainMessage::Broadcast&& broadcast,
-                       beltpp::stream::peer_id const& self,
-                       beltpp::stream::peer_id const& from,
-                       bool full_broadcast,
-                       beltpp::ilog* plog,
-                       std::unordered_set<beltpp::stream::peer_id> const& all_peers,
-                       beltpp::stream* psk)
+beltpp::packet get_public_key(PublicKeyRequest const& msg)
 {
-    auto str_compare = [](string const& first, string const& second)
-    {
-        auto res = first.compare(second);
-        if (res > 0)
-            res = 1;
-        if (res < 0)
-            res = -1;
-        return res;
-    };
-
-    int direction = 0;
-    if (false == full_broadcast)
-    {
-        direction = str_compare(self, from);
-        if (plog)
-            plog->message(self.substr(0, 8) + ", " + from.substr(0, 8) + ": " + std::to_string(direction));
+    meshpp::private_key pv(msg.private_key);
 
-        if (0 == direction)
-            return;
-    }
+    PublicKeyResponse response;
+    response.public_key = pv.get_public_key().to_string();
+
+    return beltpp::packet(std::move(response));
+}
 
-    bool chance_to_reflect = beltpp::chance_one_of(10);
+beltpp::packet encrypt(Encrypt const& msg)
+{
+    EncryptedMessage response;
+    response.cipher_b64_msg = meshpp::ECIES_encrypt(msg.public_key,
+                                                    msg.plain_b64_msg);
+
+    return beltpp::packet(std::move(response));
+}
+
+beltpp::packet decrypt(Decrypt const& msg)
+{
+    DecryptedMessage response;
+    response.plain_b64_msg = meshpp::ECIES_decrypt(msg.private_key,
+                                                   msg.cipher_b64_msg);
 
-    if (full_broadcast)
+    return beltpp::packet(std::move(response));
+}
+
+std::function<beltpp::packet()> stateless_query(beltpp::packet& request)
+{
+    switch (request.type())
     {
-        if (plog)
-            plog->message("will broadcast to all");
-        broadcast.echoes = 2;
+    case DigestRequest::rtt:
+    {
+        auto msg = std::make_shared<DigestRequest>();
+        std::move(request).get(*msg);
+        return [msg] { return get_hash(std::move(*msg)); };
     }
-    if (chance_to_reflect)
+    case MasterKeyRequest::rtt:
+        return [] { return get_random_seed(); };
+    case KeyPairRequest::rtt:
     {
-        if (plog)
-            plog->message("can reflect, 1 chance out of 10");
-        if (broadcast.echoes == 0)
-        {
-            if (plog)
-                plog->message("    oh no! reflections are expired");
-            chance_to_reflect = false;
-        }
+        auto msg = std::make_shared<KeyPairRequest>();
+        std::move(request).get(*msg);
+        return [msg] { return get_key_pair(*msg); };
     }
-    if (broadcast.echoes > 2)
-        broadcast.echoes = 2;
-
-    auto filtered_peers = all_peers;
-    for (auto const& peer : all_peers)
+    case SignRequest::rtt:
     {
-        auto direction2 = str_compare(self, peer);
-        if (false == full_broadcast &&
-            direction == direction2)
-            filtered_peers.erase(peer);
+        auto msg = std::make_shared<SignRequest>();
+        std::move(request).get(*msg);
+        return [msg] { return get_signature(std::move(*msg)); };
     }
-
-    if (filtered_peers.empty() &&
-        chance_to_reflect)
+    case Signature::rtt:
     {
-        if (plog)
-            plog->message("since all peers would be skipped by reflection, "
-                          "use the chance to reflect, and broadcast to everyone");
-        filtered_peers = all_peers;
-        --broadcast.echoes;
+        auto msg = std::make_shared<Signature>();
+        std::move(request).get(*msg);
+        return [msg] { return verify_signature(*msg); };
     }
-    else if (filtered_peers.empty())
+    case PublicKeyRequest::rtt:
     {
-        if (plog)
-            plog->message("all peers will be skipped by direction");
+        auto msg = std::make_shared<PublicKeyRequest>();
+        std::move(request).get(*msg);
+        return [msg] { return get_public_key(*msg); };
     }
-
-    for (auto const& peer : filtered_peers)
+    case Encrypt::rtt:
     {
-        if (plog)
-            plog->message("will rebroadcast to: " + peer);
-
-        psk->send(peer, beltpp::packet(broadcast));
+        auto msg = std::make_shared<Encrypt>();
+        std::move(request).get(*msg);
+        return [msg] { return encrypt(*msg); };
     }
+    case Decrypt::rtt:
+    {
+        auto msg = std::make_shared<Decrypt>();
+        std::move(request).get(*msg);
+        return [msg] { return decrypt(*msg); };
+    }
+    }
+
+    return std::function<beltpp::packet()>();
+}
+
+void broadcast_message(BlockchainMessage::Broadcast&& broadcast,
+                       beltpp::stream::peer_id const& from,
+                       std::unordered_set<beltpp::stream::peer_id> const& peers,
+                       publiqpp::inventory& inventory,
+                       beltpp::stream* psk)
+{
+    string digest = meshpp::hash(broadcast.package.to_string());
+    broadcast_message(std::move(broadcast), digest, from, peers, inventory, psk);
+}
+
+void broadcast_message(BlockchainMessage::Broadcast&& broadcast,
+                       string const& digest,
+                       beltpp::stream::peer_id const& from,
+                       std::unordered_set<beltpp::stream::peer_id> const& peers,
+                       publiqpp::inventory& inventory,
+                       beltpp::stream* psk)
+{
+    if (broadcast.echoes > 2)
+        broadcast.echoes = 2;
+
+    //  serialized once, the peers that ask for it get the same bytes
+    auto buffer = std::make_shared<string const>(broadcast.to_string());
+    ++detail::broadcast_encoded;
+
+    auto push_peers = inventory.add(digest, buffer, from, peers);
+    if (push_peers.size() > 1)
+        detail::broadcast_bytes_saved += (push_peers.size() - 1) * buffer->size();
+
+    for (auto const& peer : push_peers)
+        psk->send(peer, serialized_packet(Broadcast::rtt, buffer));
+}
+
+uint64_t broadcast_encoded()
+{
+    return detail::broadcast_encoded;
+}
+
+uint64_t broadcast_bytes_saved()
+{
+    return detail::broadcast_bytes_saved;
 }
 
 }// end of namespace publiqpp
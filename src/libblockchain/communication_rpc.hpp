@@ -5,44 +5,58 @@
 
 namespace publiqpp
 {
-void get_actions(LoggedTransactionsRequest const& msg_get_actions,
-                 publiqpp::action_log& action_log,
-                 beltpp::stream& sk,
-                 beltpp::stream::peer_id const& peerid);
+beltpp::packet get_actions(LoggedTransactionsRequest const& msg_get_actions,
+                           publiqpp::action_log const& action_log);
 
-void get_hash(DigestRequest&& msg_get_hash,
-              beltpp::stream& sk,
-              beltpp::stream::peer_id const& peerid);
+//  the same from the committed tail, for start indexes it covers
+beltpp::packet get_actions(LoggedTransactionsRequest const& msg_get_actions,
+                           publiqpp::action_log_view const& action_log);
 
-void get_random_seed(beltpp::stream& sk,
-                     beltpp::stream::peer_id const& peerid);
+//  the queries that do not touch the node state return the answer,
+//  they are run on the query threads
+beltpp::packet get_hash(DigestRequest&& msg_get_hash);
 
-void get_public_addresses(beltpp::stream& sk,
-                          beltpp::stream::peer_id const& peerid,
-                          publiqpp::detail::node_internals& impl);
+beltpp::packet get_random_seed();
 
-void get_peers_addresses(beltpp::stream& sk,
-                         beltpp::stream::peer_id const& peerid,
-                         publiqpp::detail::node_internals& impl);
+beltpp::packet get_public_addresses(publiqpp::nodeid_addresses const& addresses);
 
-void get_key_pair(KeyPairRequest const& kpr_msg,
-                  beltpp::stream& sk,
-                  beltpp::stream::peer_id const& peerid);
+beltpp::packet get_peers_addresses(publiqpp::detail::node_internals& impl);
 
-void get_signature(SignRequest&& msg,
-                   beltpp::stream& sk,
-                   beltpp::stream::peer_id const& peerid);
+beltpp::packet get_key_pair(KeyPairRequest const& kpr_msg);
 
-void verify_signature(Signature const& msg,
-                      beltpp::stream& sk,
-                      beltpp::stream::peer_id const& peerid);
+beltpp::packet get_signature(SignRequest&& msg);
 
+beltpp::packet verify_signature(Signature const& msg);
+
+beltpp::packet get_public_key(PublicKeyRequest const& msg);
+
+beltpp::packet encrypt(Encrypt const& msg);
+
+beltpp::packet decrypt(Decrypt const& msg);
+
+//  the query answering a request of the above kind, the request is moved
+//  into it, an empty function for the requests that need the node state
+std::function<beltpp::packet()> stateless_query(beltpp::packet& request);
+
+//  keeps the broadcast in the inventory to be announced to the peers,
+//  those that do not speak inventory get the body pushed
 void broadcast_message(BlockchainMessage::Broadcast&& broadcast,
-                       beltpp::stream::peer_id const& self,
                        beltpp::stream::peer_id const& from,
-                       bool full_broadcast,
-                       beltpp::ilog* plog,
-                       std::unordered_set<beltpp::stream::peer_id> const& all_peers,
+                       std::unordered_set<beltpp::stream::peer_id> const& peers,
+                       publiqpp::inventory& inventory,
                        beltpp::stream* psk);
 
+//  the same, with the digest of the broadcast body known already
+void broadcast_message(BlockchainMessage::Broadcast&& broadcast,
+                       std::string const& digest,
+                       beltpp::stream::peer_id const& from,
+                       std::unordered_set<beltpp::stream::peer_id> const& peers,
+                       publiqpp::inventory& inventory,
+                       beltpp::stream* psk);
+
+//  count of broadcasts serialized, and the serialization
+//  avoided by sending the same bytes to all their peers
+uint64_t broadcast_encoded();
+uint64_t broadcast_bytes_saved();
+
 }// end of namespace publiqpp
@@ -29,12 +29,19 @@ class config_internal
 public:
     mutex m_mutex;
     string aes_key;
+    string load_snapshot;
+    size_t verification_threads;
+    size_t query_threads;
+    filesystem::path data_directory;
     meshpp::file_loader<BlockchainMessage::Config,
                         &BlockchainMessage::Config::from_string,
                         &BlockchainMessage::Config::to_string> config_loader;
 
-    config_internal(filesystem::path const& data_directory)
-        : config_loader(data_directory / ("config.json"))
+    config_internal(filesystem::path const& _data_directory)
+        : verification_threads(0)
+        , query_threads(0)
+        , data_directory(_data_directory)
+        , config_loader(_data_directory / ("config.json"))
     {}
 };
 
@@ -610,6 +617,68 @@ bool config::discovery_server() const
     return false;
 }
 
+void config::set_snapshot_interval(uint64_t block_count)
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+
+    if (0 != block_count)
+    {
+        pimpl->config_loader->snapshot_interval = block_count;
+
+        pimpl->config_loader.save();
+        pimpl->config_loader.commit();
+    }
+}
+
+uint64_t config::snapshot_interval() const
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+
+    return pimpl->config_loader->snapshot_interval.value_or(0);
+}
+
+string config::snapshot_directory() const
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    return (pimpl->data_directory / "snapshots").string();
+}
+
+void config::set_load_snapshot(string const& path)
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    pimpl->load_snapshot = path;
+}
+
+string config::load_snapshot() const
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    return pimpl->load_snapshot;
+}
+
+void config::set_verification_threads(size_t thread_count)
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    pimpl->verification_threads = thread_count;
+}
+
+size_t config::verification_threads() const
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    return pimpl->verification_threads;
+}
+
+void config::set_query_threads(size_t thread_count)
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    pimpl->query_threads = thread_count;
+}
+
+size_t config::query_threads() const
+{
+    auto locker = unique_lock<mutex>(pimpl->m_mutex);
+    return pimpl->query_threads;
+}
+
 string config::check_for_error() const
 {
     string result;
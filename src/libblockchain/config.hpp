@@ -90,6 +90,19 @@ public:
     void set_discovery_server();
     bool discovery_server() const;
 
+    void set_snapshot_interval(uint64_t block_count);
+    uint64_t snapshot_interval() const;
+    std::string snapshot_directory() const;
+
+    void set_load_snapshot(std::string const& path);
+    std::string load_snapshot() const;
+
+    void set_verification_threads(size_t thread_count);
+    size_t verification_threads() const;
+
+    void set_query_threads(size_t thread_count);
+    size_t query_threads() const;
+
     std::string check_for_error() const;
 
     std::unique_ptr<detail::config_internal> pimpl;
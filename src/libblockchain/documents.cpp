@@ -4,6 +4,8 @@
 #include "types.hpp"
 #include "node_internals.hpp"
 #include "message.tmpl.hpp"
+#include "snapshot.hpp"
+#include "block_undo.hpp"
 
 #include <mesh.pp/fileutility.hpp>
 
@@ -31,13 +33,15 @@ class documents_internals
 {
 public:
     documents_internals(filesystem::path const& path_documents,
-                        filesystem::path const& path_storages)
+                        filesystem::path const& path_storages,
+                        block_undo& undo)
         : m_files("file", path_documents, 10000, detail::get_putl())
         , m_units("unit", path_documents, 10000, detail::get_putl())
         , m_storages("storages", path_storages, 10000, get_putl_types())
         , m_content_unit_sponsored_information("content_unit_info", path_documents, 10000, get_putl_types())
         , m_sponsored_informations_expiring("sponsored_info_expiring", path_documents, 10000, get_putl_types())
         , m_sponsored_informations_hash_to_block("sponsored_info_hash_to_block", path_documents, 10000, get_putl_types())
+        , pundo(&undo)
     {}
 
     meshpp::map_loader<File> m_files;
@@ -46,12 +50,14 @@ public:
     meshpp::map_loader<StorageTypes::ContentUnitSponsoredInformation> m_content_unit_sponsored_information;
     meshpp::map_loader<StorageTypes::SponsoredInformationHeaders> m_sponsored_informations_expiring;
     meshpp::map_loader<StorageTypes::TransactionHashToBlockNumber> m_sponsored_informations_hash_to_block;
+    block_undo* pundo;
 };
 }
 
 documents::documents(filesystem::path const& path_documents,
-                     filesystem::path const& path_storages)
-    : m_pimpl(path_documents.empty() ? nullptr : new detail::documents_internals(path_documents, path_storages))
+                     filesystem::path const& path_storages,
+                     block_undo& undo)
+    : m_pimpl(path_documents.empty() ? nullptr : new detail::documents_internals(path_documents, path_storages, undo))
 {}
 
 documents::~documents() = default;
@@ -104,6 +110,37 @@ void documents::clear()
     m_pimpl->m_sponsored_informations_hash_to_block.clear();
 }
 
+void documents::export_snapshot(snapshot_writer& writer)
+{
+    if (nullptr == m_pimpl)
+        return;
+    snapshot_save(writer, "file", m_pimpl->m_files);
+    snapshot_save(writer, "unit", m_pimpl->m_units);
+    snapshot_save(writer, "storages", m_pimpl->m_storages);
+    snapshot_save(writer, "content_unit_info", m_pimpl->m_content_unit_sponsored_information);
+    snapshot_save(writer, "sponsored_info_expiring", m_pimpl->m_sponsored_informations_expiring);
+    snapshot_save(writer, "sponsored_info_hash_to_block", m_pimpl->m_sponsored_informations_hash_to_block);
+}
+
+void documents::import_snapshot(snapshot_reader& reader)
+{
+    if (nullptr == m_pimpl)
+        return;
+    snapshot_load<File>(reader, "file", m_pimpl->m_files, detail::get_putl().get());
+    snapshot_load<ContentUnit>(reader, "unit", m_pimpl->m_units, detail::get_putl().get());
+    snapshot_load<StorageTypes::FileUriHolders>(reader, "storages", m_pimpl->m_storages,
+                                                detail::get_putl_types().get());
+    snapshot_load<StorageTypes::ContentUnitSponsoredInformation>(reader, "content_unit_info",
+                                                                 m_pimpl->m_content_unit_sponsored_information,
+                                                                 detail::get_putl_types().get());
+    snapshot_load<StorageTypes::SponsoredInformationHeaders>(reader, "sponsored_info_expiring",
+                                                             m_pimpl->m_sponsored_informations_expiring,
+                                                             detail::get_putl_types().get());
+    snapshot_load<StorageTypes::TransactionHashToBlockNumber>(reader, "sponsored_info_hash_to_block",
+                                                              m_pimpl->m_sponsored_informations_hash_to_block,
+                                                              detail::get_putl_types().get());
+}
+
 pair<bool, string> documents::files_exist(unordered_set<string> const& uris) const
 {
     for (auto const& uri : uris)
@@ -128,6 +165,7 @@ bool documents::insert_file(File const& file)
     if (m_pimpl->m_files.contains(file.uri))
         return false;
 
+    m_pimpl->pundo->touch("file", m_pimpl->m_files, file.uri);
     m_pimpl->m_files.insert(file.uri, file);
 
     return true;
@@ -135,6 +173,7 @@ bool documents::insert_file(File const& file)
 
 void documents::remove_file(string const& uri)
 {
+    m_pimpl->pundo->touch("file", m_pimpl->m_files, uri);
     m_pimpl->m_files.erase(uri);
 }
 
@@ -175,6 +214,7 @@ bool documents::insert_unit(ContentUnit const& unit)
     if (m_pimpl->m_units.contains(unit.uri))
         return false;
 
+    m_pimpl->pundo->touch("unit", m_pimpl->m_units, unit.uri);
     m_pimpl->m_units.insert(unit.uri, unit);
 
     return true;
@@ -182,6 +222,7 @@ bool documents::insert_unit(ContentUnit const& unit)
 
 void documents::remove_unit(string const& uri)
 {
+    m_pimpl->pundo->touch("unit", m_pimpl->m_units, uri);
     m_pimpl->m_units.erase(uri);
 }
 
@@ -202,6 +243,8 @@ void documents::storage_update(std::string const& uri,
                                std::string const& address,
                                UpdateType status)
 {
+    m_pimpl->pundo->touch("storages", m_pimpl->m_storages, uri);
+
     if (UpdateType::store == status)
     {
         if (false == m_pimpl->m_storages.contains(uri))
@@ -330,6 +373,8 @@ void documents::sponsor_content_unit_apply(publiqpp::detail::node_internals& imp
     si.transaction_hash = transaction_hash;
     si.cancelled = false;
 
+    m_pimpl->pundo->touch("content_unit_info", m_pimpl->m_content_unit_sponsored_information, spi.uri);
+
     if (m_pimpl->m_content_unit_sponsored_information.contains(spi.uri))
     {
         StorageTypes::ContentUnitSponsoredInformation& cusi =
@@ -377,6 +422,13 @@ void documents::sponsor_content_unit_apply(publiqpp::detail::node_internals& imp
     expiring.block_number = expiring_block_number;
     expiring.manually_cancelled = StorageTypes::Coin();
 
+    m_pimpl->pundo->touch("sponsored_info_expiring",
+                          m_pimpl->m_sponsored_informations_expiring,
+                          std::to_string(expiring_block_number));
+    m_pimpl->pundo->touch("sponsored_info_hash_to_block",
+                          m_pimpl->m_sponsored_informations_hash_to_block,
+                          si.transaction_hash);
+
     if (false == m_pimpl->m_sponsored_informations_expiring.contains(std::to_string(expiring_block_number)))
     {
         StorageTypes::SponsoredInformationHeaders expirings;
@@ -404,6 +456,8 @@ void documents::sponsor_content_unit_revert(publiqpp::detail::node_internals& im
                                             BlockchainMessage::SponsorContentUnit const& spi,
                                             string const& transaction_hash)
 {
+    m_pimpl->pundo->touch("content_unit_info", m_pimpl->m_content_unit_sponsored_information, spi.uri);
+
     StorageTypes::ContentUnitSponsoredInformation& cusi =
             m_pimpl->m_content_unit_sponsored_information.at(spi.uri);
 
@@ -469,6 +523,9 @@ void documents::sponsor_content_unit_revert(publiqpp::detail::node_internals& im
     hash_to_block.transaction_hash = si.transaction_hash;
     hash_to_block.block_number = expiring_block_number;
 
+    m_pimpl->pundo->touch("sponsored_info_hash_to_block",
+                          m_pimpl->m_sponsored_informations_hash_to_block,
+                          hash_to_block.transaction_hash);
     m_pimpl->m_sponsored_informations_hash_to_block.erase(hash_to_block.transaction_hash);
 }
 
@@ -501,6 +558,11 @@ map<string, map<string, coin>> documents::sponsored_content_unit_set_used(publiq
 
     if (m_pimpl->m_content_unit_sponsored_information.contains(content_unit_uri))
     {
+        if (false == pretend)
+            m_pimpl->pundo->touch("content_unit_info",
+                                  m_pimpl->m_content_unit_sponsored_information,
+                                  content_unit_uri);
+
         StorageTypes::ContentUnitSponsoredInformation& cusi =
                 m_pimpl->m_content_unit_sponsored_information.at(content_unit_uri);
 
@@ -699,6 +761,11 @@ documents::expiration_entry_ref_by_block(uint64_t block_number)
     if (false == m_pimpl->m_sponsored_informations_expiring.contains(std::to_string(block_number)))
         throw std::logic_error("false == m_pimpl->m_sponsored_informations_expiring.contains(std::to_string(block_number))");
 
+    //  the entry is given out to be changed
+    m_pimpl->pundo->touch("sponsored_info_expiring",
+                          m_pimpl->m_sponsored_informations_expiring,
+                          std::to_string(block_number));
+
     auto& expirings =
             m_pimpl->m_sponsored_informations_expiring.at(std::to_string(block_number));
 
@@ -739,4 +806,35 @@ documents::expiration_entry_ref_by_hash(std::string const& transaction_hash)
     return expiration_entry;
 }
 
+bool documents::restore(StorageTypes::BlockUndoEntry const& entry)
+{
+    if (nullptr == m_pimpl)
+        return false;
+
+    if (entry.table == "file")
+        block_undo::restore<File>(m_pimpl->m_files, entry, detail::get_putl().get());
+    else if (entry.table == "unit")
+        block_undo::restore<ContentUnit>(m_pimpl->m_units, entry, detail::get_putl().get());
+    else if (entry.table == "storages")
+        block_undo::restore<StorageTypes::FileUriHolders>(m_pimpl->m_storages,
+                                                          entry,
+                                                          detail::get_putl_types().get());
+    else if (entry.table == "content_unit_info")
+        block_undo::restore<StorageTypes::ContentUnitSponsoredInformation>(m_pimpl->m_content_unit_sponsored_information,
+                                                                           entry,
+                                                                           detail::get_putl_types().get());
+    else if (entry.table == "sponsored_info_expiring")
+        block_undo::restore<StorageTypes::SponsoredInformationHeaders>(m_pimpl->m_sponsored_informations_expiring,
+                                                                       entry,
+                                                                       detail::get_putl_types().get());
+    else if (entry.table == "sponsored_info_hash_to_block")
+        block_undo::restore<StorageTypes::TransactionHashToBlockNumber>(m_pimpl->m_sponsored_informations_hash_to_block,
+                                                                        entry,
+                                                                        detail::get_putl_types().get());
+    else
+        return false;
+
+    return true;
+}
+
 }
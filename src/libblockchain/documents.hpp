@@ -3,6 +3,7 @@
 #include "global.hpp"
 #include "coin.hpp"
 #include "message.hpp"
+#include "types.hpp"
 
 #include <boost/filesystem/path.hpp>
 
@@ -24,11 +25,16 @@ namespace detail
 class documents_internals;
 class node_internals;
 }
+class snapshot_writer;
+class snapshot_reader;
+class block_undo;
+
 class documents
 {
 public:
     documents(boost::filesystem::path const& path_documents,
-              boost::filesystem::path const& path_storages);
+              boost::filesystem::path const& path_storages,
+              block_undo& undo);
     ~documents();
 
     void save();
@@ -53,6 +59,12 @@ public:
     void storage_update(std::string const& uri, std::string const& address, BlockchainMessage::UpdateType status);
     bool storage_has_uri(std::string const& uri, std::string const& address) const;
 
+    void export_snapshot(snapshot_writer& writer);
+    void import_snapshot(snapshot_reader& reader);
+
+    //  false if the entry is not of a documents container
+    bool restore(StorageTypes::BlockUndoEntry const& entry);
+
 public:
 
     void sponsor_content_unit_apply(publiqpp::detail::node_internals& impl,
@@ -0,0 +1,60 @@
+#include "file_sync.hpp"
+
+#include <string>
+#include <stdexcept>
+
+#ifdef P_OS_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace filesystem = boost::filesystem;
+using std::string;
+
+namespace publiqpp
+{
+void sync_file(filesystem::path const& path)
+{
+    string str_path = path.string();
+    bool code = true;
+#ifdef P_OS_WINDOWS
+    int fd = ::_open(str_path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd >= 0)
+    {
+        code = (0 == ::_commit(fd));
+        ::_close(fd);
+    }
+#else
+    int fd = ::open(str_path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        code = (0 == ::fsync(fd));
+        ::close(fd);
+    }
+#endif
+    if (fd < 0 || false == code)
+        throw std::runtime_error("sync_file: cannot sync: " + str_path);
+}
+
+void sync_directory(filesystem::path const& path)
+{
+#ifdef P_OS_WINDOWS
+    //  directories cannot be opened for sync, the file system journals renames
+    B_UNUSED(path);
+#else
+    string str_path = path.string();
+    int fd = ::open(str_path.c_str(), O_RDONLY);
+    bool code = false;
+    if (fd >= 0)
+    {
+        code = (0 == ::fsync(fd));
+        ::close(fd);
+    }
+    if (false == code)
+        throw std::runtime_error("sync_directory: cannot sync: " + str_path);
+#endif
+}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+namespace publiqpp
+{
+//  the written data reaches the disk before anything pointing to it is renamed in
+void sync_file(boost::filesystem::path const& path);
+//  a rename reaches the disk with the directory holding the file
+void sync_directory(boost::filesystem::path const& path);
+}
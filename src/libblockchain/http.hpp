@@ -1,5 +1,6 @@
 #pragma once
 
+#include "global.hpp"
 #include "message.hpp"
 #include "common.hpp"
 
@@ -17,6 +18,9 @@
 #include <utility>
 #include <unordered_map>
 #include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <ctime>
 
 using std::string;
 using std::vector;
@@ -28,29 +32,197 @@ namespace publiqpp
 namespace http
 {
 inline
-string response(beltpp::detail::session_special_data& ssd,
-                beltpp::packet const& pc)
+string http_date(std::time_t value)
+{
+    std::tm tm_value;
+#ifdef P_OS_WINDOWS
+    gmtime_s(&tm_value, &value);
+#else
+    gmtime_r(&value, &tm_value);
+#endif
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm_value);
+
+    return buffer;
+}
+//  storage files are addressed by their hash and never change,
+//  so the uri is a strong entity tag and they are cached for a year
+inline
+string storage_cache_headers(string const& uri, std::time_t stored_at)
 {
-    return beltpp::http::http_response(ssd, pc.to_string());
+    string str_result;
+    str_result += "ETag: \"" + uri + "\"\r\n";
+    str_result += "Cache-Control: public, max-age=31536000, immutable\r\n";
+    str_result += "Last-Modified: " + http_date(stored_at) + "\r\n";
+
+    return str_result;
 }
+//  weak comparison of the If-None-Match entity tags with the one of the file,
+//  which is its uri, since the files are addressed by their hash
 inline
-string file_response(beltpp::detail::session_special_data& ssd,
-                     beltpp::packet const& pc)
+bool entity_tag_match(string const& value, string const& uri)
 {
-    ssd.session_specal_handler = nullptr;
+    string const entity_tag = "\"" + uri + "\"";
 
-    if (pc.type() == BlockchainMessage::StorageFile::rtt)
+    size_t begin = 0;
+    while (begin < value.length())
+    {
+        size_t end = value.find(',', begin);
+        if (end == string::npos)
+            end = value.length();
+
+        string item = value.substr(begin, end - begin);
+        begin = end + 1;
+
+        auto first = item.find_first_not_of(" \t");
+        if (first == string::npos)
+            continue;
+        item = item.substr(first, item.find_last_not_of(" \t") - first + 1);
+
+        if (0 == item.compare(0, 2, "W/"))
+            item = item.substr(2);
+
+        if (item == "*" || item == entity_tag)
+            return true;
+    }
+
+    return false;
+}
+enum class range_parse {none, range, unsatisfiable};
+
+//  supports single byte range forms "bytes=a-b", "bytes=a-" and "bytes=-n"
+//  anything else is ignored and the whole file is served
+//  on success [range_begin, range_end) is the part to serve
+inline
+range_parse parse_range(string const& value,
+                        uint64_t total_size,
+                        uint64_t& range_begin,
+                        uint64_t& range_end)
+{
+    string const prefix = "bytes=";
+    if (0 != value.compare(0, prefix.length(), prefix))
+        return range_parse::none;
+
+    string spec = value.substr(prefix.length());
+    auto dash = spec.find('-');
+    if (dash == string::npos ||
+        spec.find(',') != string::npos)
+        return range_parse::none;
+
+    string str_first = spec.substr(0, dash);
+    string str_last = spec.substr(dash + 1);
+
+    auto all_digits = [](string const& str)
+    {
+        return std::all_of(str.begin(), str.end(), [](char ch){ return ch >= '0' && ch <= '9'; });
+    };
+    if (false == all_digits(str_first) ||
+        false == all_digits(str_last) ||
+        (str_first.empty() && str_last.empty()) ||
+        str_first.length() > 18 ||
+        str_last.length() > 18)
+        return range_parse::none;
+
+    if (str_first.empty())
+    {
+        uint64_t suffix = std::stoull(str_last);
+        if (0 == suffix || 0 == total_size)
+            return range_parse::unsatisfiable;
+
+        range_begin = total_size - std::min(suffix, total_size);
+        range_end = total_size;
+    }
+    else
+    {
+        range_begin = std::stoull(str_first);
+        if (range_begin >= total_size)
+            return range_parse::unsatisfiable;
+
+        if (str_last.empty())
+            range_end = std::min(total_size, range_begin + STORAGE_MAX_RANGE_LENGTH);
+        else
+        {
+            uint64_t last = std::stoull(str_last);
+            if (last < range_begin)
+                return range_parse::none;
+
+            range_end = std::min(total_size, last + 1);
+        }
+    }
+
+    return range_parse::range;
+}
+//  the answers to GET /storage, they are sent to nothing else
+//  the file body is sent in parts, the first one comes with the headers
+inline
+bool is_file_response(size_t rtt)
+{
+    return rtt == BlockchainMessage::StorageFileContent::rtt ||
+           rtt == BlockchainMessage::StorageFileRange::rtt ||
+           rtt == BlockchainMessage::StorageFileNotModified::rtt ||
+           rtt == BlockchainMessage::StorageFileError::rtt ||
+           rtt == BlockchainMessage::StorageFileChunk::rtt;
+}
+inline
+string file_response(beltpp::packet const& pc)
+{
+    if (pc.type() == BlockchainMessage::StorageFileContent::rtt)
     {
         string str_result;
-        BlockchainMessage::StorageFile const* pFile = nullptr;
+        BlockchainMessage::StorageFileContent const* pFile = nullptr;
         pc.get(pFile);
 
         str_result += "HTTP/1.1 200 OK\r\n";
         if (false == pFile->mime_type.empty())
             str_result += "Content-Type: " + pFile->mime_type + "\r\n";
         str_result += "Access-Control-Allow-Origin: *\r\n";
+        str_result += "Accept-Ranges: bytes\r\n";
+        str_result += storage_cache_headers(pFile->uri, pFile->stored_at.tm);
         str_result += "Content-Length: ";
-        str_result += std::to_string(pFile->data.length());
+        str_result += std::to_string(pFile->size);
+        str_result += "\r\n\r\n";
+        str_result += pFile->data;
+
+        return str_result;
+    }
+    else if (pc.type() == BlockchainMessage::StorageFileChunk::rtt)
+    {
+        BlockchainMessage::StorageFileChunk const* pChunk = nullptr;
+        pc.get(pChunk);
+
+        return pChunk->data;
+    }
+    else if (pc.type() == BlockchainMessage::StorageFileNotModified::rtt)
+    {
+        string str_result;
+        BlockchainMessage::StorageFileNotModified const* pNotModified = nullptr;
+        pc.get(pNotModified);
+
+        str_result += "HTTP/1.1 304 Not Modified\r\n";
+        str_result += "Access-Control-Allow-Origin: *\r\n";
+        str_result += storage_cache_headers(pNotModified->uri, pNotModified->stored_at.tm);
+        str_result += "\r\n";
+
+        return str_result;
+    }
+    else if (pc.type() == BlockchainMessage::StorageFileRange::rtt)
+    {
+        string str_result;
+        BlockchainMessage::StorageFileRange const* pFile = nullptr;
+        pc.get(pFile);
+
+        str_result += "HTTP/1.1 206 Partial Content\r\n";
+        if (false == pFile->mime_type.empty())
+            str_result += "Content-Type: " + pFile->mime_type + "\r\n";
+        str_result += "Access-Control-Allow-Origin: *\r\n";
+        str_result += "Accept-Ranges: bytes\r\n";
+        str_result += storage_cache_headers(pFile->uri, pFile->stored_at.tm);
+        str_result += "Content-Range: bytes ";
+        str_result += std::to_string(pFile->range_begin) + "-";
+        str_result += std::to_string(pFile->range_begin + pFile->range_length - 1) + "/";
+        str_result += std::to_string(pFile->total_size) + "\r\n";
+        str_result += "Content-Length: ";
+        str_result += std::to_string(pFile->range_length);
         str_result += "\r\n\r\n";
         str_result += pFile->data;
 
@@ -60,13 +232,26 @@ string file_response(beltpp::detail::session_special_data& ssd,
     {
         string str_result;
         string message;
-        if (pc.type() == BlockchainMessage::UriError::rtt)
+        if (pc.type() == BlockchainMessage::StorageFileError::rtt)
         {
-            BlockchainMessage::UriError const* pError = nullptr;
+            BlockchainMessage::StorageFileError const* pError = nullptr;
             pc.get(pError);
             if (pError->uri_problem_type == BlockchainMessage::UriProblemType::missing)
                 message = "404 Not Found\r\n"
                           "requested file: " + pError->uri;
+            else if (pError->uri_problem_type == BlockchainMessage::UriProblemType::invalid)
+            {
+                message = "416 Range Not Satisfiable\r\n"
+                          "requested file: " + pError->uri;
+
+                str_result += "HTTP/1.1 416 Range Not Satisfiable\r\n";
+                str_result += "Content-Type: text/plain\r\n";
+                str_result += "Access-Control-Allow-Origin: *\r\n";
+                str_result += "Content-Range: bytes */" + std::to_string(pError->total_size) + "\r\n";
+                str_result += "Content-Length: " + std::to_string(message.length()) + "\r\n\r\n";
+                str_result += message;
+                return str_result;
+            }
         }
 
         if (message.empty())
@@ -80,6 +265,40 @@ string file_response(beltpp::detail::session_special_data& ssd,
         return str_result;
     }
 }
+//  the connection is kept alive, the handler stays for the answers
+//  to the requests pipelined after this one, each is framed by its
+//  own type, so the requests of any kind can be mixed in a pipeline
+inline
+string response(beltpp::detail::session_special_data& ssd,
+                beltpp::packet const& pc)
+{
+    if (is_file_response(pc.type()))
+        return file_response(pc);
+
+    string body;
+    if (pc.type() == BlockchainMessage::BatchResponse::rtt)
+    {
+        //  the answers alone, in the order of the posted array
+        BlockchainMessage::BatchResponse const* pBatch = nullptr;
+        pc.get(pBatch);
+
+        body = "[";
+        for (auto const& item : pBatch->responses)
+        {
+            if (body.size() > 1)
+                body += ",";
+            body += item.to_string();
+        }
+        body += "]";
+    }
+    else
+        body = pc.to_string();
+
+    string str_result = beltpp::http::http_response(ssd, body);
+    ssd.session_specal_handler = &response;
+
+    return str_result;
+}
 
 template <beltpp::detail::pmsg_all (*fallback_message_list_load)(
         std::string::const_iterator&,
@@ -94,7 +313,6 @@ beltpp::detail::pmsg_all message_list_load(
 {
     auto it_fallback = iter_scan_begin;
 
-    ssd.session_specal_handler = nullptr;
     ssd.autoreply.clear();
 
     auto protocol_error = [&iter_scan_begin, &iter_scan_end, &ssd]()
@@ -144,12 +362,18 @@ beltpp::detail::pmsg_all message_list_load(
             ss.resource.path.size() == 1 &&
             ss.resource.path.front() == "storage")
         {
-            ssd.session_specal_handler = &file_response;
-
             auto p = ::beltpp::new_void_unique_ptr<BlockchainMessage::StorageFileRequest>();
             BlockchainMessage::StorageFileRequest& ref = *reinterpret_cast<BlockchainMessage::StorageFileRequest*>(p.get());
             ref.uri = ss.resource.arguments["file"];
             ref.storage_order_token = ss.resource.arguments["storage_order_token"];
+            auto it_range = ss.resource.properties.find("Range");
+            if (it_range != ss.resource.properties.end() &&
+                false == it_range->second.empty())
+                ref.range = it_range->second;
+            auto it_if_none_match = ss.resource.properties.find("If-None-Match");
+            if (it_if_none_match != ss.resource.properties.end())
+                ref.if_none_match = it_if_none_match->second;
+            ref.from_http = true;
             return ::beltpp::detail::pmsg_all(BlockchainMessage::StorageFileRequest::rtt,
                                               std::move(p),
                                               &BlockchainMessage::StorageFileRequest::pvoid_saver);
@@ -199,11 +423,10 @@ beltpp::detail::pmsg_all message_list_load(
             }
             catch (std::exception const& ex)
             {
-                ssd.session_specal_handler = nullptr;
-
                 BlockchainMessage::RemoteError response;
                 response.message = ex.what();
                 ssd.autoreply = beltpp::http::http_response(ssd, response.to_string());
+                ssd.session_specal_handler = &publiqpp::http::response;
 
                 return ::beltpp::detail::pmsg_all(size_t(-1),
                                                   ::beltpp::void_unique_nullptr(),
@@ -214,6 +437,13 @@ beltpp::detail::pmsg_all message_list_load(
                  ss.resource.path.size() == 1 &&
                  ss.resource.path.front() == "api")
         {
+            //  a json array of requests is a batch, answered with an array
+            auto it_first = std::find_if(posted.cbegin(), posted.cend(),
+                                         [](char ch) { return false == std::isspace(static_cast<unsigned char>(ch)); });
+            if (it_first != posted.cend() && *it_first == '[')
+                posted = "{\"rtt\":" + std::to_string(BlockchainMessage::BatchRequest::rtt) +
+                         ",\"requests\":" + posted + "}";
+
             std::string::const_iterator iter_scan_begin_temp = posted.cbegin();
             std::string::const_iterator const iter_scan_end_temp = posted.cend();
 
@@ -322,11 +552,10 @@ beltpp::detail::pmsg_all message_list_load(
             }
             catch (std::exception const& ex)
             {
-                ssd.session_specal_handler = nullptr;
-
                 BlockchainMessage::RemoteError response;
                 response.message = ex.what();
                 ssd.autoreply = beltpp::http::http_response(ssd, response.to_string());
+                ssd.session_specal_handler = &publiqpp::http::response;
 
                 return ::beltpp::detail::pmsg_all(size_t(-1),
                                                   ::beltpp::void_unique_nullptr(),
@@ -385,9 +614,8 @@ beltpp::detail::pmsg_all message_list_load(
                  ss.resource.path.size() == 1 &&
                  ss.resource.path.front() == "protocol")
         {
-            ssd.session_specal_handler = nullptr;
-
             ssd.autoreply = beltpp::http::http_response(ssd, BlockchainMessage::detail::meta_json_schema());
+            ssd.session_specal_handler = &response;
 
             return ::beltpp::detail::pmsg_all(size_t(-1),
                                               ::beltpp::void_unique_nullptr(),
@@ -395,8 +623,6 @@ beltpp::detail::pmsg_all message_list_load(
         }
         else
         {
-            ssd.session_specal_handler = nullptr;
-
             string message("noo! \r\n");
 
             for (auto const& dir : ss.resource.path)
@@ -414,6 +640,7 @@ beltpp::detail::pmsg_all message_list_load(
             ssd.autoreply = beltpp::http::http_not_found(ssd,
                                                          message +
                                                          BlockchainMessage::detail::meta_json_schema());
+            ssd.session_specal_handler = &response;
 
             return ::beltpp::detail::pmsg_all(size_t(-1),
                                               ::beltpp::void_unique_nullptr(),
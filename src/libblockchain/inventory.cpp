@@ -0,0 +1,256 @@
+#include "inventory.hpp"
+#include "common.hpp"
+
+#include <deque>
+#include <chrono>
+#include <utility>
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using std::unordered_set;
+using std::unordered_map;
+using std::deque;
+using std::pair;
+using std::chrono::steady_clock;
+
+namespace publiqpp
+{
+namespace detail
+{
+class inventory_peer
+{
+public:
+    inventory_peer()
+        : speaks(false)
+    {}
+
+    //  returns false if the peer knew it already
+    bool know(string const& digest)
+    {
+        if (false == known.insert(digest).second)
+            return false;
+
+        known_order.push_back(digest);
+        if (known_order.size() > INVENTORY_PEER_KNOWN)
+        {
+            known.erase(known_order.front());
+            known_order.pop_front();
+        }
+        return true;
+    }
+
+    bool speaks;
+    unordered_set<string> known;
+    deque<string> known_order;
+    vector<string> pending;
+};
+
+class inventory_item
+{
+public:
+    //  empty for the ones that were received but not passed on
+    shared_ptr<string const> body;
+};
+
+class inventory_internals
+{
+public:
+    inventory_internals()
+        : announced(0)
+        , sent(0)
+        , duplicates(0)
+    {}
+
+    inventory_item& item(string const& digest)
+    {
+        auto insert_res = items.insert(std::make_pair(digest, inventory_item()));
+        if (insert_res.second)
+            order.push_back(std::make_pair(steady_clock::now(), digest));
+
+        return insert_res.first->second;
+    }
+
+    unordered_map<string, inventory_item> items;
+    deque<pair<steady_clock::time_point, string>> order;
+    //  requested bodies that did not come yet, by the peer asked
+    unordered_map<string, pair<inventory::peer_id, steady_clock::time_point>> requests;
+    unordered_map<inventory::peer_id, inventory_peer> peers;
+
+    uint64_t announced;
+    uint64_t sent;
+    uint64_t duplicates;
+};
+}
+
+inventory::inventory()
+    : m_pimpl(new detail::inventory_internals())
+{
+}
+
+inventory::~inventory() = default;
+
+vector<inventory::peer_id> inventory::add(string const& digest,
+                                          shared_ptr<string const> const& body,
+                                          peer_id const& from,
+                                          unordered_set<peer_id> const& peers)
+{
+    auto& impl = *m_pimpl;
+    impl.item(digest).body = body;
+
+    vector<peer_id> push_peers;
+    for (auto const& peer : peers)
+    {
+        auto& state = impl.peers[peer];
+        if (false == state.know(digest) || peer == from)
+            continue;
+
+        if (state.speaks)
+            state.pending.push_back(digest);
+        else
+            push_peers.push_back(peer);
+    }
+
+    return push_peers;
+}
+
+void inventory::received(string const& digest, peer_id const& peer)
+{
+    auto& impl = *m_pimpl;
+
+    impl.peers[peer].know(digest);
+    impl.requests.erase(digest);
+
+    if (impl.items.count(digest))
+        ++impl.duplicates;
+    else
+        impl.item(digest);
+}
+
+vector<string> inventory::announced(peer_id const& peer,
+                                    vector<string> const& digests)
+{
+    auto& impl = *m_pimpl;
+    auto& state = impl.peers[peer];
+    state.speaks = true;
+
+    auto now = steady_clock::now();
+    vector<string> result;
+
+    for (auto const& digest : digests)
+    {
+        state.know(digest);
+
+        if (impl.items.count(digest))
+            continue;
+
+        //  one peer is asked at a time, another one if it does not answer
+        auto it = impl.requests.find(digest);
+        if (it != impl.requests.end() &&
+            now - it->second.second < std::chrono::seconds(INVENTORY_REQUEST_TIMEOUT))
+            continue;
+
+        impl.requests[digest] = std::make_pair(peer, now);
+        result.push_back(digest);
+    }
+
+    return result;
+}
+
+vector<shared_ptr<string const>> inventory::requested(peer_id const& peer,
+                                                     vector<string> const& digests)
+{
+    auto& impl = *m_pimpl;
+    auto& state = impl.peers[peer];
+    state.speaks = true;
+
+    vector<shared_ptr<string const>> result;
+    for (auto const& digest : digests)
+    {
+        auto it = impl.items.find(digest);
+        if (it == impl.items.end() || nullptr == it->second.body)
+            continue;
+
+        state.know(digest);
+        result.push_back(it->second.body);
+    }
+
+    impl.sent += result.size();
+    return result;
+}
+
+unordered_map<inventory::peer_id, vector<string>> inventory::take_announcements()
+{
+    auto& impl = *m_pimpl;
+    unordered_map<peer_id, vector<string>> result;
+
+    for (auto& item : impl.peers)
+    {
+        if (item.second.pending.empty())
+            continue;
+
+        impl.announced += item.second.pending.size();
+        result[item.first] = std::move(item.second.pending);
+        item.second.pending.clear();
+    }
+
+    return result;
+}
+
+bool inventory::speaks(peer_id const& peer) const
+{
+    auto it = m_pimpl->peers.find(peer);
+    return it != m_pimpl->peers.end() && it->second.speaks;
+}
+
+void inventory::remove_peer(peer_id const& peer)
+{
+    auto& impl = *m_pimpl;
+    impl.peers.erase(peer);
+
+    for (auto it = impl.requests.begin(); it != impl.requests.end();)
+    {
+        if (it->second.first == peer)
+            it = impl.requests.erase(it);
+        else
+            ++it;
+    }
+}
+
+void inventory::cleanup()
+{
+    auto& impl = *m_pimpl;
+    auto now = steady_clock::now();
+
+    while (false == impl.order.empty() &&
+           now - impl.order.front().first > std::chrono::seconds(INVENTORY_KEEP_SECONDS))
+    {
+        impl.items.erase(impl.order.front().second);
+        impl.order.pop_front();
+    }
+
+    for (auto it = impl.requests.begin(); it != impl.requests.end();)
+    {
+        if (now - it->second.second > std::chrono::seconds(INVENTORY_REQUEST_TIMEOUT))
+            it = impl.requests.erase(it);
+        else
+            ++it;
+    }
+}
+
+uint64_t inventory::announced_count() const
+{
+    return m_pimpl->announced;
+}
+
+uint64_t inventory::sent_count() const
+{
+    return m_pimpl->sent;
+}
+
+uint64_t inventory::duplicate_count() const
+{
+    return m_pimpl->duplicates;
+}
+
+}
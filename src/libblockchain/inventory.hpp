@@ -0,0 +1,64 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <belt.pp/socket.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include <unordered_map>
+
+namespace publiqpp
+{
+
+namespace detail
+{
+class inventory_internals;
+}
+
+//  broadcasts this node has seen and which peers know of them
+//  bodies are announced to the peers by digest and sent only to those that ask
+//  a peer that never sent Inventory or InventoryRequest is taken
+//  for one that does not speak it, and gets the bodies pushed as before
+class inventory
+{
+public:
+    using peer_id = beltpp::stream::peer_id;
+
+    inventory();
+    ~inventory();
+
+    //  keeps the body, the peers that do not know it yet will have it announced
+    //  returns those of them that need the body pushed instead
+    std::vector<peer_id> add(std::string const& digest,
+                             std::shared_ptr<std::string const> const& body,
+                             peer_id const& from,
+                             std::unordered_set<peer_id> const& peers);
+    //  the body came from the peer, it is not to be requested anymore
+    void received(std::string const& digest, peer_id const& peer);
+    //  the peer has these, returns the ones to request from it
+    std::vector<std::string> announced(peer_id const& peer,
+                                       std::vector<std::string> const& digests);
+    //  the bodies the peer asked for that are still kept
+    std::vector<std::shared_ptr<std::string const>> requested(peer_id const& peer,
+                                                              std::vector<std::string> const& digests);
+    //  announcements collected since the last call
+    std::unordered_map<peer_id, std::vector<std::string>> take_announcements();
+
+    //  whether the peer sent Inventory or InventoryRequest, which
+    //  nodes that know the messages added together with them do
+    bool speaks(peer_id const& peer) const;
+    void remove_peer(peer_id const& peer);
+    //  forgets what is older than INVENTORY_KEEP_SECONDS
+    void cleanup();
+
+    uint64_t announced_count() const;
+    uint64_t sent_count() const;
+    uint64_t duplicate_count() const;
+private:
+    std::unique_ptr<detail::inventory_internals> m_pimpl;
+};
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "global.hpp"
+#include "message.hpp"
+
+#include <mesh.pp/cryptoutility.hpp>
+
+#include <string>
+#include <vector>
+
+namespace publiqpp
+{
+//  canonical json and its digest of an idl value, each computed on first use
+//  the value is seen as const, so what is computed stays valid while the view lives
+//  a digest known already, for example from a verified header, can be handed in
+template <typename T>
+class memoized
+{
+public:
+    explicit memoized(T const& value)
+        : m_pvalue(&value)
+        , m_has_string(false)
+        , m_has_digest(false)
+    {}
+
+    memoized(T const& value, std::string const& digest)
+        : m_pvalue(&value)
+        , m_has_string(false)
+        , m_has_digest(true)
+        , m_digest(digest)
+    {}
+
+    T const& value() const
+    {
+        return *m_pvalue;
+    }
+
+    std::string const& str() const
+    {
+        if (false == m_has_string)
+        {
+            m_string = m_pvalue->to_string();
+            m_has_string = true;
+        }
+        return m_string;
+    }
+
+    std::string const& digest() const
+    {
+        if (false == m_has_digest)
+        {
+            m_digest = meshpp::hash(str());
+            m_has_digest = true;
+        }
+        return m_digest;
+    }
+private:
+    T const* m_pvalue;
+    mutable bool m_has_string;
+    mutable bool m_has_digest;
+    mutable std::string m_string;
+    mutable std::string m_digest;
+};
+
+//  the digest of a signed transaction is its hash in the pool and in the action log,
+//  the details are what is signed and what the transaction cache is keyed by
+class memoized_transaction : public memoized<BlockchainMessage::SignedTransaction>
+{
+public:
+    explicit memoized_transaction(BlockchainMessage::SignedTransaction const& value)
+        : memoized<BlockchainMessage::SignedTransaction>(value)
+        , m_details(value.transaction_details)
+    {}
+
+    memoized<BlockchainMessage::Transaction> const& details() const
+    {
+        return m_details;
+    }
+private:
+    memoized<BlockchainMessage::Transaction> m_details;
+};
+
+//  the digest of the block details is the block hash,
+//  the transactions of the block are memoized on first use
+class memoized_block : public memoized<BlockchainMessage::Block>
+{
+public:
+    explicit memoized_block(BlockchainMessage::SignedBlock const& value)
+        : memoized<BlockchainMessage::Block>(value.block_details)
+        , m_psigned_block(&value)
+    {}
+
+    memoized_block(BlockchainMessage::SignedBlock const& value, std::string const& digest)
+        : memoized<BlockchainMessage::Block>(value.block_details, digest)
+        , m_psigned_block(&value)
+    {}
+
+    BlockchainMessage::SignedBlock const& signed_block() const
+    {
+        return *m_psigned_block;
+    }
+
+    memoized_transaction const& transaction(size_t index) const
+    {
+        auto const& signed_transactions = value().signed_transactions;
+        if (m_transactions.empty())
+        {
+            m_transactions.reserve(signed_transactions.size());
+            for (auto const& signed_transaction : signed_transactions)
+                m_transactions.emplace_back(signed_transaction);
+        }
+        return m_transactions.at(index);
+    }
+private:
+    BlockchainMessage::SignedBlock const* m_psigned_block;
+    mutable std::vector<memoized_transaction> m_transactions;
+};
+}
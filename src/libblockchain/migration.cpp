@@ -0,0 +1,16 @@
+#include "migration.hpp"
+#include "blockchain.hpp"
+#include "storage.hpp"
+
+namespace publiqpp
+{
+uint64_t migrate_blockchain(boost::filesystem::path const& fs_blockchain)
+{
+    return blockchain::migrate(fs_blockchain);
+}
+
+uint64_t migrate_storage(boost::filesystem::path const& fs_storage)
+{
+    return storage::migrate(fs_storage);
+}
+}
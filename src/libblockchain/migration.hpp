@@ -0,0 +1,21 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+
+namespace publiqpp
+{
+//  one time conversions of the data directory layout,
+//  to be run before the node is constructed
+
+//  moves blocks and headers from json chunks to segment files
+//  returns the number of converted blocks
+BLOCKCHAINSHARED_EXPORT uint64_t migrate_blockchain(boost::filesystem::path const& fs_blockchain);
+
+//  moves storage files from base64 json chunks to raw blob files
+//  returns the number of converted files
+BLOCKCHAINSHARED_EXPORT uint64_t migrate_storage(boost::filesystem::path const& fs_storage);
+}
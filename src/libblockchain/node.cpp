@@ -7,7 +7,9 @@
 #include "transaction_handler.hpp"
 
 #include "open_container_packet.hpp"
+#include "memoized.hpp"
 #include "sessions.hpp"
+#include "serialized_packet.hpp"
 #include "message.tmpl.hpp"
 #include "types.hpp"
 
@@ -16,10 +18,12 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <functional>
 #include <chrono>
 #include <unordered_set>
 #include <unordered_map>
 #include <utility>
+#include <algorithm>
 #include <exception>
 #include <stdexcept>
 
@@ -52,6 +56,186 @@ string value(unordered_map<string, string> const& map, string const& key)
     
     return it->second;
 }
+//  rpc clients get the answer from the query threads, so the event loop
+//  is not held by them, through p2p they are answered right away
+//  the client is held until answered, its next requests wait for their turn
+void run_query(detail::node_internals& impl,
+               beltpp::stream& sk,
+               peer_id const& peerid,
+               bool rpc,
+               std::function<packet()> const& query)
+{
+    if (rpc)
+    {
+        impl.m_query_executor.run(peerid, query);
+        impl.m_event_queue.hold(peerid);
+    }
+    else
+        sk.send(peerid, query());
+}
+//  the requests of a batch are answered in one response, the stateless ones
+//  and those served from the committed views together on the query threads,
+//  those reading the node state itself right here
+void run_batch(detail::node_internals& impl,
+               beltpp::stream& sk,
+               peer_id const& peerid,
+               BatchRequest&& batch_request)
+{
+    if (batch_request.requests.size() > RPC_BATCH_MAX_REQUESTS)
+        throw wrong_request_exception("too many requests in a batch, the limit is " +
+                                      std::to_string(RPC_BATCH_MAX_REQUESTS));
+
+    auto responses = std::make_shared<vector<packet>>(batch_request.requests.size());
+    auto queries = std::make_shared<vector<std::function<void()>>>();
+
+    for (size_t index = 0; index != batch_request.requests.size(); ++index)
+    {
+        auto& request = batch_request.requests[index];
+        auto& response = (*responses)[index];
+
+        auto query = stateless_query(request);
+        if (query)
+        {
+            queries->push_back([query, &response] { response = answer_query(query); });
+            continue;
+        }
+
+        switch (request.type())
+        {
+        case LoggedTransactionsRequest::rtt:
+        {
+            LoggedTransactionsRequest msg;
+            std::move(request).get(msg);
+            auto view = impl.m_action_log.view();
+            if (msg.start_index >= view->begin)
+                queries->push_back([view, msg, &response]
+                {
+                    response = answer_query([&view, &msg] { return get_actions(msg, *view); });
+                });
+            else
+                response = answer_query([&impl, &msg] { return get_actions(msg, impl.m_action_log); });
+            break;
+        }
+        case PublicAddressesRequest::rtt:
+        {
+            PublicAddressesRequest msg;
+            std::move(request).get(msg);
+            if (msg.address_type == PublicAddressType::rpc)
+            {
+                auto addresses = impl.m_nodeid_service.addresses();
+                queries->push_back([addresses, &response]
+                {
+                    response = get_public_addresses(*addresses);
+                });
+            }
+            else
+                response = get_peers_addresses(impl);
+            break;
+        }
+        default:
+        {
+            RemoteError msg;
+            msg.message = "request type " + std::to_string(request.type()) +
+                          " is not allowed in a batch";
+            response = packet(std::move(msg));
+            break;
+        }
+        }
+    }
+
+    run_query(impl, sk, peerid, true, [responses, queries]
+    {
+        for (auto const& query : *queries)
+            query();
+
+        BatchResponse batch_response;
+        batch_response.responses = std::move(*responses);
+        return packet(std::move(batch_response));
+    });
+}
+//  rate limits, and the checks of broadcast transactions that come before
+//  their signatures, false for what is not to be processed further
+//  the broadcast body is serialized and hashed once, here and after
+bool admit_message(detail::node_internals& impl,
+                   beltpp::stream& sk,
+                   peer_id const& peerid,
+                   bool rpc,
+                   packet& package,
+                   memoized<packet> const* pbroadcast_body)
+{
+    switch (package.type())
+    {
+    case beltpp::stream_join::rtt:
+    case beltpp::stream_drop::rtt:
+    case beltpp::stream_protocol_error::rtt:
+    case beltpp::socket_open_refused::rtt:
+    case beltpp::socket_open_error::rtt:
+        return true;
+    }
+
+    string address;
+    if (rpc)
+        address = impl.m_ptr_rpc_socket->info_connection(peerid).remote.address;
+
+    auto why = impl.m_admission.take(peerid, address, package.type(), rpc);
+    if (why != admission::reason::none)
+    {
+        impl.m_admission.reject(why);
+        if (rpc)
+        {
+            RemoteError msg;
+            msg.message = "too many requests, try again later";
+            sk.send(peerid, packet(std::move(msg)));
+        }
+        return false;
+    }
+
+    if (package.type() != Broadcast::rtt)
+        return true;
+
+    Broadcast* p_broadcast = nullptr;
+    package.get(p_broadcast);
+
+    if (p_broadcast->package.type() != SignedTransaction::rtt)
+        return true;
+
+    SignedTransaction* p_signed_tx = nullptr;
+    p_broadcast->package.get(p_signed_tx);
+
+    if (pbroadcast_body->str().size() > ADMISSION_TRANSACTION_MAX_BYTES)
+    {
+        impl.m_admission.reject(admission::reason::too_large);
+        throw wrong_data_exception("too large transaction");
+    }
+
+    beltpp::on_failure guard_expired([&impl]
+    {
+        impl.m_admission.reject(admission::reason::expired);
+    });
+    transaction_time_validate(p_signed_tx->transaction_details,
+                              system_clock::now(),
+                              chrono::seconds(NODES_TIME_SHIFT));
+    guard_expired.dismiss();
+
+    if (impl.m_transaction_cache.contains(*p_signed_tx))
+    {
+        impl.m_admission.reject(admission::reason::duplicate);
+        if (rpc)
+            sk.send(peerid, packet(Done()));
+        else
+            impl.m_inventory.received(pbroadcast_body->digest(), peerid);
+        return false;
+    }
+
+    beltpp::on_failure guard_balance([&impl]
+    {
+        impl.m_admission.reject(admission::reason::balance);
+    });
+    fee_validate(impl, *p_signed_tx);
+    guard_balance.dismiss();
+
+    return true;
+}
 /*
  * node
  */
@@ -144,6 +328,20 @@ void node::run(bool& stop_check)
                                 m_pimpl->m_ptr_p2p_socket.get(),
                                 m_pimpl->m_ptr_direct_stream.get());
 
+    //  the client may have gone while the query was run
+    for (auto& item : m_pimpl->m_query_executor.take_results())
+    {
+        try
+        {
+            m_pimpl->m_event_queue.release(item.peerid);
+            m_pimpl->m_ptr_rpc_socket->send(item.peerid, std::move(item.package));
+        }
+        catch (std::exception const& e)
+        {
+            m_pimpl->writeln_node("query answer not sent: " + string(e.what()));
+        }
+    }
+
     if (m_pimpl->m_event_queue.is_timer())
     {
         m_pimpl->m_ptr_p2p_socket->timer_action();
@@ -169,8 +367,18 @@ void node::run(bool& stop_check)
 
         try
         {
+            //  computed on first use, by then the sessions have not taken the message
+            unique_ptr<memoized<packet>> pbroadcast_body;
+            if (m_pimpl->m_event_queue.message().type() == Broadcast::rtt)
+            {
+                Broadcast* p_broadcast = nullptr;
+                m_pimpl->m_event_queue.message().get(p_broadcast);
+                pbroadcast_body.reset(new memoized<packet>(p_broadcast->package));
+            }
+
             if (false == m_pimpl->m_nodeid_sessions.process(peerid, std::move(m_pimpl->m_event_queue.message())) &&
-                false == m_pimpl->m_sync_sessions.process(peerid, std::move(m_pimpl->m_event_queue.message())))
+                false == m_pimpl->m_sync_sessions.process(peerid, std::move(m_pimpl->m_event_queue.message())) &&
+                admit_message(*m_pimpl, *psk, peerid, it == interface_type::rpc, m_pimpl->m_event_queue.message(), pbroadcast_body.get()))
             {
                 auto& received_package = m_pimpl->m_event_queue.message();
 
@@ -187,6 +395,13 @@ void node::run(bool& stop_check)
 
                 packet& ref_packet = *p_package;
 
+                if (it == interface_type::p2p &&
+                    p_package != &received_package)
+                {
+                    //  the body is here, not to be requested anymore
+                    m_pimpl->m_inventory.received(pbroadcast_body->digest(), peerid);
+                }
+
                 switch (ref_packet.type())
                 {
                 case beltpp::stream_join::rtt:
@@ -202,6 +417,9 @@ void node::run(bool& stop_check)
 
                         m_pimpl->add_peer(peerid);
 
+                        //  tells the peer that inventory is spoken here
+                        psk->send(peerid, beltpp::packet(Inventory()));
+
                         beltpp::ip_address external_address =
                                 m_pimpl->m_ptr_p2p_socket->external_address();
                         assert(external_address.local.empty() == false);
@@ -287,11 +505,10 @@ void node::run(bool& stop_check)
                     if (action_process_on_chain(signed_tx, *m_pimpl))
                     {
                         broadcast_message(std::move(broadcast),
-                                          m_pimpl->m_ptr_p2p_socket->name(),
+                                          pbroadcast_body->digest(),
                                           peerid,
-                                          it == interface_type::rpc,
-                                          nullptr,
                                           m_pimpl->m_p2p_peers,
+                                          m_pimpl->m_inventory,
                                           m_pimpl->m_ptr_p2p_socket.get());
                     }
 
@@ -392,27 +609,17 @@ void node::run(bool& stop_check)
                         {
                             // rebroadcast command direct peer or to all
                             std::unordered_set<beltpp::stream::peer_id> broadcast_peers;
-                            bool full_broadcast;
 
                             if (0 == m_pimpl->m_p2p_peers.count(update_command.storage_address))
-                            {
                                 broadcast_peers = m_pimpl->m_p2p_peers;
-                                full_broadcast = true;
-                                // or may do as below to follow refined broadcast rules
-                                //full_broadcast = (it == interface_type::rpc);
-                            }
                             else
-                            {
                                 broadcast_peers.insert(update_command.storage_address);
-                                full_broadcast = true;
-                            }
 
                             broadcast_message(std::move(broadcast),
-                                              m_pimpl->m_ptr_p2p_socket->name(),
+                                              pbroadcast_body->digest(),
                                               peerid,
-                                              full_broadcast,
-                                              nullptr,
                                               broadcast_peers,
+                                              m_pimpl->m_inventory,
                                               m_pimpl->m_ptr_p2p_socket.get());
                         }
                     }
@@ -514,20 +721,43 @@ void node::run(bool& stop_check)
                     {
                         LoggedTransactionsRequest msg_get_actions;
                         std::move(ref_packet).get(msg_get_actions);
-                        get_actions(msg_get_actions, m_pimpl->m_action_log, *psk, peerid);
+
+                        //  followers of the log are answered from the committed tail,
+                        //  older start indexes read the log itself right here
+                        auto view = m_pimpl->m_action_log.view();
+                        if (msg_get_actions.start_index >= view->begin)
+                            run_query(*m_pimpl, *psk, peerid, true, [view, msg_get_actions]
+                            {
+                                return get_actions(msg_get_actions, *view);
+                            });
+                        else
+                            psk->send(peerid, get_actions(msg_get_actions, m_pimpl->m_action_log));
                     }
                     break;
                 }
                 case DigestRequest::rtt:
+                case MasterKeyRequest::rtt:
+                case KeyPairRequest::rtt:
+                case SignRequest::rtt:
+                case Signature::rtt:
+                case PublicKeyRequest::rtt:
+                case Encrypt::rtt:
+                case Decrypt::rtt:
                 {
-                    DigestRequest msg_get_hash;
-                    std::move(ref_packet).get(msg_get_hash);
-                    get_hash(std::move(msg_get_hash), *psk, peerid);
+                    run_query(*m_pimpl, *psk, peerid, it == interface_type::rpc,
+                              stateless_query(ref_packet));
                     break;
                 }
-                case MasterKeyRequest::rtt:
+                case BatchRequest::rtt:
                 {
-                    get_random_seed(*psk, peerid);
+                    if (it != interface_type::rpc ||
+                        m_pimpl->m_ptr_rpc_socket->get_peer_type(peerid) !=
+                        beltpp::socket::peer_type::streaming_accepted)
+                        throw wrong_request_exception("BatchRequest is accepted from rpc clients only!");
+
+                    BatchRequest batch_request;
+                    std::move(ref_packet).get(batch_request);
+                    run_batch(*m_pimpl, *psk, peerid, std::move(batch_request));
                     break;
                 }
                 case PublicAddressesRequest::rtt:
@@ -535,34 +765,20 @@ void node::run(bool& stop_check)
                     PublicAddressesRequest msg;
                     std::move(ref_packet).get(msg);
 
+                    //  the peers are read from the sockets, so right here
                     if (msg.address_type == PublicAddressType::rpc)
-                        get_public_addresses(*psk, peerid, *m_pimpl);
+                    {
+                        auto addresses = m_pimpl->m_nodeid_service.addresses();
+                        run_query(*m_pimpl, *psk, peerid, it == interface_type::rpc, [addresses]
+                        {
+                            return get_public_addresses(*addresses);
+                        });
+                    }
                     else
-                        get_peers_addresses(*psk, peerid, *m_pimpl);
+                        psk->send(peerid, get_peers_addresses(*m_pimpl));
 
                     break;
                 }
-                case KeyPairRequest::rtt:
-                {
-                    KeyPairRequest kpr_msg;
-                    std::move(ref_packet).get(kpr_msg);
-                    get_key_pair(kpr_msg, *psk, peerid);
-                    break;
-                }
-                case SignRequest::rtt:
-                {
-                    SignRequest msg_sign_request;
-                    std::move(ref_packet).get(msg_sign_request);
-                    get_signature(std::move(msg_sign_request), *psk, peerid);
-                    break;
-                }
-                case Signature::rtt:
-                {
-                    Signature msg_signature;
-                    std::move(ref_packet).get(msg_signature);
-                    verify_signature(msg_signature, *psk, peerid);
-                    break;
-                }
                 case SyncRequest::rtt:
                 {
                     BlockHeaderExtended const& header_ex = m_pimpl->m_blockchain.last_header_ex();
@@ -590,6 +806,69 @@ void node::run(bool& stop_check)
 
                     break;
                 }
+                case Inventory::rtt:
+                {
+                    if (it != interface_type::p2p)
+                        throw wrong_request_exception("Inventory received through rpc!");
+
+                    Inventory inventory;
+                    std::move(ref_packet).get(inventory);
+
+                    if (inventory.hashes.size() > INVENTORY_MAX_HASHES)
+                        throw wrong_data_exception("too many hashes in inventory");
+
+                    InventoryRequest inventory_request;
+                    inventory_request.hashes = m_pimpl->m_inventory.announced(peerid, inventory.hashes);
+
+                    if (false == inventory_request.hashes.empty())
+                        psk->send(peerid, beltpp::packet(std::move(inventory_request)));
+
+                    break;
+                }
+                case InventoryRequest::rtt:
+                {
+                    if (it != interface_type::p2p)
+                        throw wrong_request_exception("InventoryRequest received through rpc!");
+
+                    InventoryRequest inventory_request;
+                    std::move(ref_packet).get(inventory_request);
+
+                    if (inventory_request.hashes.size() > INVENTORY_MAX_HASHES)
+                        throw wrong_data_exception("too many hashes in inventory request");
+
+                    for (auto const& body : m_pimpl->m_inventory.requested(peerid, inventory_request.hashes))
+                        psk->send(peerid, serialized_packet(Broadcast::rtt, body));
+
+                    break;
+                }
+                case CompactBlockchainRequest::rtt:
+                {
+                    if (it != interface_type::p2p)
+                        throw wrong_request_exception("CompactBlockchainRequest received through rpc!");
+
+                    CompactBlockchainRequest compact_request;
+                    std::move(ref_packet).get(compact_request);
+
+                    session_action_block::process_compact_request(peerid,
+                                                                  compact_request,
+                                                                  *m_pimpl);
+
+                    break;
+                }
+                case BlockTransactionsRequest::rtt:
+                {
+                    if (it != interface_type::p2p)
+                        throw wrong_request_exception("BlockTransactionsRequest received through rpc!");
+
+                    BlockTransactionsRequest transactions_request;
+                    std::move(ref_packet).get(transactions_request);
+
+                    session_action_block::process_transactions_request(peerid,
+                                                                       transactions_request,
+                                                                       *m_pimpl);
+
+                    break;
+                }
                 case BlockchainRequest::rtt:
                 {
                     if (it != interface_type::p2p)
@@ -633,12 +912,9 @@ void node::run(bool& stop_check)
                         broadcast.package = std::move(signed_transaction);
 
                         broadcast_message(std::move(broadcast),
-                                          m_pimpl->m_ptr_p2p_socket->name(),
                                           peerid,
-                                          it == interface_type::rpc,
-                                          //m_pimpl->plogger_node,
-                                          nullptr,
                                           m_pimpl->m_p2p_peers,
+                                          m_pimpl->m_inventory,
                                           m_pimpl->m_ptr_p2p_socket.get());
                     }
 
@@ -673,27 +949,17 @@ void node::run(bool& stop_check)
                         {
                             // rebroadcast message direct peer or to all
                             std::unordered_set<beltpp::stream::peer_id> broadcast_peers;
-                            bool full_broadcast;
 
                             if (0 == m_pimpl->m_p2p_peers.count(letter.to))
-                            {
                                 broadcast_peers = m_pimpl->m_p2p_peers;
-                                full_broadcast = true;
-                                // or may do as below to follow refined broadcast rules
-                                //full_broadcast = (it == interface_type::rpc);
-                            }
                             else
-                            {
                                 broadcast_peers.insert(letter.to);
-                                full_broadcast = true;
-                            }
 
                             broadcast_message(std::move(broadcast),
-                                              m_pimpl->m_ptr_p2p_socket->name(),
+                                              pbroadcast_body->digest(),
                                               peerid,
-                                              full_broadcast,
-                                              nullptr,
                                               broadcast_peers,
+                                              m_pimpl->m_inventory,
                                               m_pimpl->m_ptr_p2p_socket.get());
                         }
                     }
@@ -754,46 +1020,6 @@ void node::run(bool& stop_check)
 
                     break;
                 }
-                case PublicKeyRequest::rtt:
-                {
-                    PublicKeyRequest msg;
-                    std::move(ref_packet).get(msg);
-
-                    meshpp::private_key pv(msg.private_key);
-
-                    PublicKeyResponse response;
-                    response.public_key = pv.get_public_key().to_string();
-
-                    psk->send(peerid, beltpp::packet(std::move(response)));
-
-                    break;
-                }
-                case Encrypt::rtt:
-                {
-                    Encrypt msg;
-                    std::move(ref_packet).get(msg);
-
-                    EncryptedMessage response;
-                    response.cipher_b64_msg = meshpp::ECIES_encrypt(msg.public_key,
-                                                                    msg.plain_b64_msg);
-
-                    psk->send(peerid, beltpp::packet(std::move(response)));
-
-                    break;
-                }
-                case Decrypt::rtt:
-                {
-                    Decrypt msg;
-                    std::move(ref_packet).get(msg);
-
-                    DecryptedMessage response;
-                    response.plain_b64_msg = meshpp::ECIES_decrypt(msg.private_key,
-                                                                   msg.cipher_b64_msg);
-
-                    psk->send(peerid, beltpp::packet(std::move(response)));
-
-                    break;
-                }
                 case Ping::rtt:
                 {
                     Ping msg;
@@ -1155,9 +1381,10 @@ void node::run(bool& stop_check)
 
             auto current_time = system_clock::now();
 
-            for (size_t pool_index = 0; pool_index != pool_size; ++pool_index)
+            //  higher fee rate ones first
+            for (auto ptransaction : m_pimpl->m_transaction_pool.by_fee())
             {
-                SignedTransaction const& signed_transaction = m_pimpl->m_transaction_pool.at(pool_index);
+                SignedTransaction const& signed_transaction = *ptransaction;
 
                 if (current_time < system_clock::from_time_t(signed_transaction.transaction_details.expiry.tm) &&
                     current_time > system_clock::from_time_t(signed_transaction.transaction_details.creation.tm) + chrono::seconds(BLOCK_MINE_DELAY))
@@ -1168,24 +1395,46 @@ void node::run(bool& stop_check)
 
                     broadcast_message(std::move(broadcast),
                                       m_pimpl->m_ptr_p2p_socket->name(),
-                                      m_pimpl->m_ptr_p2p_socket->name(),
-                                      true, // like from rpc
-                                      nullptr, // no logger
                                       m_pimpl->m_p2p_peers,
+                                      m_pimpl->m_inventory,
                                       m_pimpl->m_ptr_p2p_socket.get());
                 }
             }
         }
     }
 
+    // announce the collected broadcasts in batches
+    if (m_pimpl->m_inventory_timer.expired())
+    {
+        m_pimpl->m_inventory_timer.update();
+
+        for (auto& item : m_pimpl->m_inventory.take_announcements())
+        {
+            auto& hashes = item.second;
+            for (size_t index = 0; index < hashes.size(); index += INVENTORY_MAX_HASHES)
+            {
+                Inventory inventory;
+                auto it_end = hashes.begin() + std::min(hashes.size(), index + INVENTORY_MAX_HASHES);
+                inventory.hashes.assign(hashes.begin() + index, it_end);
+
+                m_pimpl->m_ptr_p2p_socket->send(item.first, beltpp::packet(std::move(inventory)));
+            }
+        }
+    }
+
     // clean old transaction keys from cache
     // to minimize it and make it work faster
     if (m_pimpl->m_cache_cleanup_timer.expired())
     {
         m_pimpl->m_cache_cleanup_timer.update();
 
+        m_pimpl->m_inventory.cleanup();
+        m_pimpl->m_admission.cleanup();
+
         m_pimpl->clean_transaction_cache();
 
+        m_pimpl->check_snapshot(false);
+
         //  temp place
         m_pimpl->m_nodeid_service.take_actions([this](std::string const& node_address,
                                                       beltpp::ip_address const& address,
@@ -1235,6 +1484,32 @@ void node::run(bool& stop_check)
         broadcast_address_info(m_pimpl);
     }
 
+    if (m_pimpl->m_summary_report_timer.expired())
+    {
+        m_pimpl->m_summary_report_timer.update();
+
+        auto const& verifier = m_pimpl->m_signature_verifier;
+        m_pimpl->writeln_node("signature cache: " +
+                              std::to_string(verifier.cache_hits()) + " hits, " +
+                              std::to_string(verifier.cache_misses()) + " misses, " +
+                              std::to_string(verifier.cache_size()) + " entries");
+        m_pimpl->writeln_node("broadcast: " +
+                              std::to_string(broadcast_encoded()) + " serialized, " +
+                              std::to_string(broadcast_bytes_saved()) + " bytes not serialized again");
+        m_pimpl->writeln_node("inventory: " +
+                              std::to_string(m_pimpl->m_inventory.announced_count()) + " announced, " +
+                              std::to_string(m_pimpl->m_inventory.sent_count()) + " sent on request, " +
+                              std::to_string(m_pimpl->m_inventory.duplicate_count()) + " duplicates received");
+        m_pimpl->writeln_node("queries: " +
+                              std::to_string(m_pimpl->m_query_executor.answered()) + " answered, " +
+                              std::to_string(m_pimpl->m_query_executor.pending()) + " pending on " +
+                              std::to_string(m_pimpl->m_query_executor.thread_count()) + " threads");
+        m_pimpl->writeln_node("event queue: " +
+                              std::to_string(m_pimpl->m_event_queue.backlog()) + " waiting, " +
+                              std::to_string(m_pimpl->m_event_queue.refused()) + " rpc requests answered busy");
+        m_pimpl->writeln_node("admission: " + m_pimpl->m_admission.summary());
+    }
+
     // init sync process and block mining
     if (m_pimpl->m_check_timer.expired())
     {
@@ -1688,8 +1963,13 @@ void block_worker(detail::node_internals& impl)
 
     if (impl.all_sync_info.headers_actions_data.end() != it_chosen)
     {
+        auto download = std::make_shared<block_download>(it_chosen->second.headers);
+        string top_hash = it_chosen->second.headers.front().block_hash;
+        uint64_t top_number = download->top_block_number();
+        beltpp::stream::peer_id chosen_peerid = it_chosen->first;
+
         vector<unique_ptr<meshpp::session_action<meshpp::nodeid_session_header>>> actions;
-        actions.emplace_back(new session_action_block(impl, t_reason));
+        actions.emplace_back(new session_action_block(impl, t_reason, download));
 
         meshpp::nodeid_session_header header;
         header.nodeid = it_chosen->first;
@@ -1697,6 +1977,52 @@ void block_worker(detail::node_internals& impl)
         impl.m_sync_sessions.add(header,
                                  std::move(actions),
                                  chrono::seconds(SYNC_TIMER));
+
+        //  other peers that have the same top block help to download the blocks
+        //  those are the ones on it already, or the ones with headers passing through it
+        size_t helpers = 0;
+        for (auto const& peerid : impl.m_p2p_peers)
+        {
+            if (helpers == BLOCK_DOWNLOAD_PEERS)
+                break;
+            if (peerid == chosen_peerid)
+                continue;
+
+            bool has_top = false;
+
+            auto it_response = impl.all_sync_info.sync_responses.find(peerid);
+            if (it_response != impl.all_sync_info.sync_responses.end() &&
+                it_response->second.own_header.block_hash == top_hash)
+                has_top = true;
+
+            auto it_headers = impl.all_sync_info.headers_actions_data.find(peerid);
+            if (false == has_top &&
+                it_headers != impl.all_sync_info.headers_actions_data.end() &&
+                false == it_headers->second.headers.empty())
+            {
+                auto const& peer_headers = it_headers->second.headers;
+                uint64_t peer_top = peer_headers.front().block_number;
+                if (peer_top >= top_number &&
+                    peer_top - top_number < peer_headers.size() &&
+                    peer_headers[peer_top - top_number].block_hash == top_hash)
+                    has_top = true;
+            }
+
+            if (false == has_top)
+                continue;
+
+            vector<unique_ptr<meshpp::session_action<meshpp::nodeid_session_header>>> helper_actions;
+            helper_actions.emplace_back(new session_action_p2pconnections(*impl.m_ptr_p2p_socket.get()));
+            helper_actions.emplace_back(new session_action_block_part(impl, download));
+
+            meshpp::nodeid_session_header helper_header;
+            helper_header.nodeid = peerid;
+            helper_header.address = impl.m_ptr_p2p_socket->info_connection(peerid);
+            impl.m_sync_sessions.add(helper_header,
+                                     std::move(helper_actions),
+                                     chrono::seconds(SYNC_TIMER));
+            ++helpers;
+        }
     }
 }
 
@@ -3,6 +3,8 @@
 #include "communication_p2p.hpp"
 #include "message.tmpl.hpp"
 
+#include <boost/filesystem/operations.hpp>
+
 namespace publiqpp
 {
 namespace detail
@@ -11,6 +13,16 @@ bool node_internals::initialize()
 {
     bool stop_check = false;
 
+    if (m_state.legacy_accounts())
+        migrate_state();
+
+    string snapshot_path = pconfig->load_snapshot();
+    if (false == snapshot_path.empty())
+    {
+        pconfig->set_load_snapshot(string());
+        load_snapshot(snapshot_path);
+    }
+
     if (0 != m_revert_actions_count)
     {
         writeln_node("reverting " + std::to_string(m_revert_actions_count) + " actions");
@@ -37,8 +49,13 @@ bool node_internals::initialize()
         revert_pool(system_clock::to_time_t(system_clock::now()), *this);
 
         //  revert last block
-        //  calculate back
-        SignedBlock const& signed_block = m_blockchain.at(m_blockchain.last_header().block_number);
+        //  from its undo record, or calculate back
+        uint64_t last_block_number = m_blockchain.last_header().block_number;
+        if (last_block_number < m_blockchain.first_block())
+            throw std::runtime_error("cannot revert the blocks before the loaded snapshot");
+
+        SignedBlock signed_block = m_blockchain.at(last_block_number);
+        bool undone = undo_block(last_block_number);
         m_blockchain.remove_last_block();
         m_action_log.revert();
 
@@ -47,27 +64,30 @@ bool node_internals::initialize()
         string signed_block_miner_authority = signed_block.authorization.address;
         string signed_block_miner_address = blockchain::get_miner(signed_block);
 
-        map<string, map<string, uint64_t>> unit_uri_view_counts;
-        map<string, coin> unit_sponsor_applied;
-        // verify block rewards before reverting, this also reclaims advertisement coins
-        if (check_rewards(block,
-                          signed_block_miner_address,
-                          rewards_type::revert,
-                          *this,
-                          unit_uri_view_counts,
-                          unit_sponsor_applied))
-            throw std::logic_error(std::to_string(block.header.block_number) + "- block rewards reverting error!");
+        if (false == undone)
+        {
+            map<string, map<string, uint64_t>> unit_uri_view_counts;
+            map<string, coin> unit_sponsor_applied;
+            // verify block rewards before reverting, this also reclaims advertisement coins
+            if (check_rewards(block,
+                              signed_block_miner_address,
+                              rewards_type::revert,
+                              *this,
+                              unit_uri_view_counts,
+                              unit_sponsor_applied))
+                throw std::logic_error(std::to_string(block.header.block_number) + "- block rewards reverting error!");
 
-        B_UNUSED(unit_uri_view_counts);
-        B_UNUSED(unit_sponsor_applied);
+            B_UNUSED(unit_uri_view_counts);
+            B_UNUSED(unit_sponsor_applied);
 
-        // decrease all reward amounts from balances and revert reward
-        for (auto it = block.rewards.crbegin(); it != block.rewards.crend(); ++it)
-            m_state.decrease_balance(it->to, it->amount, state_layer::chain);
+            // decrease all reward amounts from balances and revert reward
+            for (auto it = block.rewards.crbegin(); it != block.rewards.crend(); ++it)
+                m_state.decrease_balance(it->to, it->amount, state_layer::chain);
 
-        // calculate back transactions
-        for (auto it = block.signed_transactions.crbegin(); it != block.signed_transactions.crend(); ++it)
-            revert_transaction(*it, *this, signed_block_miner_address);
+            // calculate back transactions
+            for (auto it = block.signed_transactions.crbegin(); it != block.signed_transactions.crend(); ++it)
+                revert_transaction(*it, *this, signed_block_miner_address);
+        }
 
         --m_revert_blocks_count;
         writeln_node(std::to_string(block.header.block_number) + " block reverted");
@@ -121,11 +141,14 @@ bool node_internals::initialize()
             insert_genesis(m_genesis_signed_block);
         else
         {
-            SignedBlock const& signed_block = m_blockchain.at(0);
             SignedBlock signed_block_hardcode;
             signed_block_hardcode.from_string(m_genesis_signed_block);
 
-            if (signed_block.to_string() != signed_block_hardcode.to_string())
+            //  a node loaded from a snapshot may keep only the header of it
+            if (m_blockchain.header_ex_at(0).block_hash !=
+                meshpp::hash(signed_block_hardcode.block_details.to_string()) ||
+                (0 == m_blockchain.first_block() &&
+                 m_blockchain.at(0).to_string() != signed_block_hardcode.to_string()))
                 throw std::runtime_error("the stored genesis is different from the one built in");
         }
 
@@ -142,5 +165,168 @@ bool node_internals::initialize()
     return stop_check;
 }
 
+void node_internals::prepare_snapshot()
+{
+    uint64_t snapshot_interval = pconfig->snapshot_interval();
+    uint64_t block_number = m_blockchain.length() - 1;
+    filesystem::path fs_snapshot = snapshot_path(block_number);
+
+    if (0 == snapshot_interval ||
+        0 != block_number % snapshot_interval ||
+        filesystem::exists(fs_snapshot))
+        return;
+
+    filesystem::create_directories(fs_snapshot.parent_path());
+
+    unique_ptr<snapshot_writer> writer(new snapshot_writer(fs_snapshot, block_number, m_blockchain.last_hash()));
+    m_state.export_snapshot(*writer);
+    m_documents.export_snapshot(*writer);
+    m_authority_manager.export_snapshot(*writer);
+    m_blockchain.export_snapshot(*writer);
+
+    m_snapshot_pending = std::move(writer);
+}
+
+void node_internals::write_snapshot()
+{
+    check_snapshot(true);
+
+    std::shared_ptr<snapshot_writer> writer(std::move(m_snapshot_pending));
+    uint64_t block_number = m_blockchain.length() - 1;
+
+    try
+    {
+        //  hashing and writing the copied records does not hold the event loop
+        m_snapshot_written = std::async(std::launch::async, [writer, block_number]
+        {
+            return "snapshot at block " + std::to_string(block_number) + ": " + writer->finish();
+        });
+    }
+    catch (std::exception const& e)
+    {
+        writeln_node_warning("snapshot at block " + std::to_string(block_number) + " is not written: " + e.what());
+    }
+}
+
+void node_internals::check_snapshot(bool wait)
+{
+    if (false == m_snapshot_written.valid())
+        return;
+
+    if (false == wait &&
+        std::future_status::ready != m_snapshot_written.wait_for(chrono::seconds(0)))
+        return;
+
+    try
+    {
+        writeln_node(m_snapshot_written.get());
+    }
+    catch (std::exception const& e)
+    {
+        writeln_node_warning(string("snapshot is not written: ") + e.what());
+    }
+}
+
+void node_internals::migrate_state()
+{
+    writeln_node("separating pool balances from the chain state");
+
+    beltpp::on_failure guard([this]
+    {
+        discard();
+    });
+
+    //  the legacy balances include the pool, they are reverted
+    //  as the pool layer before becoming the chain balances
+    m_state.load_legacy_accounts();
+    load_transaction_cache(*this, true);
+    size_t discarded_count = m_transaction_pool.length();
+    revert_pool(system_clock::to_time_t(system_clock::now()), *this);
+    m_state.apply_pool_to_chain();
+
+    save(guard);
+    m_state.close_legacy_accounts();
+
+    writeln_node("done, " + std::to_string(discarded_count) + " pool transactions discarded");
+}
+
+bool node_internals::undo_block(uint64_t block_number)
+{
+    auto undo = m_blockchain.undo_at(block_number);
+    if (false == undo.recorded)
+        return false;
+
+    for (auto it = undo.entries.crbegin(); it != undo.entries.crend(); ++it)
+    {
+        if (false == m_state.restore(*it) &&
+            false == m_documents.restore(*it) &&
+            false == m_authority_manager.restore(*it))
+            throw std::logic_error("node_internals::undo_block: unknown table " + it->table +
+                                   " in the undo record of block " + std::to_string(block_number));
+    }
+
+    return true;
+}
+
+void node_internals::load_snapshot(string const& value)
+{
+    //  the digest is base58, a colon followed by a path separator belongs to the path
+    string path = value;
+    string expected_digest;
+    auto pos = value.rfind(':');
+    if (pos != string::npos && pos > 1 &&
+        value.find_first_of("/\\", pos) == string::npos)
+    {
+        path = value.substr(0, pos);
+        expected_digest = value.substr(pos + 1);
+    }
+
+    writeln_node("loading snapshot " + path);
+
+    snapshot_reader reader(path);
+    uint64_t block_number = reader.block_number();
+
+    //  nothing is stored unless the snapshot digest is verified
+    beltpp::on_failure guard([this]
+    {
+        discard();
+    });
+
+    load_transaction_cache(*this, true);
+    revert_pool(system_clock::to_time_t(system_clock::now()), *this);
+
+    //  the state of the removed blocks is replaced by the snapshot
+    while (m_blockchain.length() > block_number + 1)
+    {
+        m_blockchain.remove_last_block();
+        m_action_log.revert();
+    }
+
+    //  a node behind the snapshot gets the blocks from it, and
+    //  the action log starts over like after a resync
+    if (m_blockchain.length() <= block_number)
+        m_action_log.clear();
+
+    m_state.import_snapshot(reader);
+    m_documents.import_snapshot(reader);
+    m_authority_manager.import_snapshot(reader);
+    m_blockchain.import_snapshot(reader);
+    string digest = reader.finish();
+
+    //  the file only proves it is whole, the expected digest
+    //  comes from a node or a publication the operator trusts
+    if (false == expected_digest.empty() &&
+        expected_digest != digest)
+        throw std::runtime_error("snapshot digest " + digest +
+                                 " is different from the expected " + expected_digest);
+
+    save(guard);
+
+    writeln_node("snapshot loaded at block " + std::to_string(block_number) + ": " + digest);
+    if (expected_digest.empty())
+        writeln_node_warning("the snapshot digest was not checked, "
+                             "compare it with the one of a trusted node");
+}
+
 }
 }
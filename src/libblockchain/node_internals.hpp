@@ -14,6 +14,13 @@
 #include "storage_node.hpp"
 #include "inbox.hpp"
 #include "config.hpp"
+#include "save_journal.hpp"
+#include "snapshot.hpp"
+#include "signature_verifier.hpp"
+#include "block_undo.hpp"
+#include "inventory.hpp"
+#include "admission.hpp"
+#include "query_executor.hpp"
 
 #include <belt.pp/ievent.hpp>
 #include <belt.pp/socket.hpp>
@@ -33,6 +40,7 @@
 
 #include <chrono>
 #include <thread>
+#include <future>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -242,138 +250,237 @@ private:
     unordered_map<service_unit, service_unit_counter_map, service_unit_hash> m_served;
 };
 
+//  keys are 32 byte digests of the transaction details and its authorizations,
+//  so a multi signature transaction also blocks each of its single signature parts
+//  entries are grouped by creation hour, expiry drops whole hours
+//  backup() starts an undo log that restore() plays back,
+//  commit() ends it when the guarded change is kept
 class transaction_cache
 {
 public:
+    transaction_cache()
+        : undo_enabled(false)
+    {}
+
     bool add_chain(SignedTransaction const& signed_transaction)
     {
-        string key = meshpp::hash(signed_transaction.to_string());
-
-        if (data.count(key))
-            return false;
+        return add_chain(memoized_transaction(signed_transaction));
+    }
+    bool add_chain(memoized_transaction const& signed_transaction)
+    {
+        vector<string> keys;
+        int64_t hour = make_keys(signed_transaction, keys);
 
-        if (signed_transaction.authorizations.size() > 1)
+        for (auto const& key : keys)
         {
-            SignedTransaction st = signed_transaction;
-            auto authorizations = st.authorizations;
-
-            for (auto const& authorization : authorizations)
-            {
-                st.authorizations = {authorization};
-                string key_sub = meshpp::hash(st.to_string());
-
-                if (data.count(key_sub))
-                    return false;
-            }
-
-            for (auto const& authorization : authorizations)
-            {
-                st.authorizations = {authorization};
-                string key_sub = meshpp::hash(st.to_string());
-                auto insert_result = data.insert({key_sub, {true, system_clock::from_time_t(signed_transaction.transaction_details.creation.tm)}});
-                assert(insert_result.second);
-                B_UNUSED(insert_result);
-            }
+            if (data.count(key))
+                return false;
         }
 
-        auto insert_result = data.insert({key, {true, system_clock::from_time_t(signed_transaction.transaction_details.creation.tm)}});
-        assert(insert_result.second);
-        B_UNUSED(insert_result);
+        for (auto const& key : keys)
+            insert(key, data_type{true, hour});
 
         return true;
     }
     void erase_chain(SignedTransaction const& signed_transaction)
     {
-        string key = meshpp::hash(signed_transaction.to_string());
-        auto count = data.erase(key);
-        B_UNUSED(count);
-        /*if (0 == count)
-            throw std::logic_error("inconsistent transaction cache");*/
-
-        if (signed_transaction.authorizations.size() > 1)
-        {
-            SignedTransaction st = signed_transaction;
-            auto authorizations = st.authorizations;
+        erase_chain(memoized_transaction(signed_transaction));
+    }
+    void erase_chain(memoized_transaction const& signed_transaction)
+    {
+        vector<string> keys;
+        make_keys(signed_transaction, keys);
 
-            for (auto const& authorization : authorizations)
-            {
-                st.authorizations = {authorization};
-                string key_sub = meshpp::hash(st.to_string());
-                count = data.erase(key_sub);
-                /*if (0 == count)
-                    throw std::logic_error("inconsistent transaction cache");*/
-            }
-        }
+        for (auto const& key : keys)
+            erase(key);
     }
 
     bool add_pool(SignedTransaction const& signed_transaction,
                   bool complete)
     {
-        string key = meshpp::hash(signed_transaction.to_string());
+        return add_pool(memoized_transaction(signed_transaction), complete);
+    }
+    bool add_pool(memoized_transaction const& signed_transaction,
+                  bool complete)
+    {
+        string key = make_key(signed_transaction.details().digest(),
+                              signed_transaction.value().authorizations);
 
-        auto insert_result = data.insert({key, {complete, system_clock::from_time_t(signed_transaction.transaction_details.creation.tm)}});
-        if (false == insert_result.second)
+        if (data.count(key))
             return false;
 
+        insert(key, data_type{complete, creation_hour(signed_transaction.value())});
         return true;
     }
 
     bool erase_pool(SignedTransaction const& signed_transaction)
     {
-        bool complete = false;
-        string key = meshpp::hash(signed_transaction.to_string());
+        return erase_pool(memoized_transaction(signed_transaction));
+    }
+    bool erase_pool(memoized_transaction const& signed_transaction)
+    {
+        string key = make_key(signed_transaction.details().digest(),
+                              signed_transaction.value().authorizations);
+
         auto it = data.find(key);
-        /*if (it == data.end())
-            throw std::logic_error("inconsistent transaction cache");*/
-        if (it != data.end())
-        {
-            if (it->second.complete)
-                complete = true;
+        if (it == data.end())
+            return false;
 
-            data.erase(it);
-        }
+        bool complete = it->second.complete;
+        erase(key);
 
         return complete;
     }
 
     void clean(system_clock::time_point const& tp)
     {
-        auto it = data.begin();
-        while (it != data.end())
+        //  we don't need to keep in hash the transactions that are definitely expired
+        auto expiry = tp -
+                      std::chrono::hours(TRANSACTION_MAX_LIFETIME_HOURS) -
+                      std::chrono::seconds(NODES_TIME_SHIFT);
+        //  the hours that ended before the expiry
+        int64_t hour_end = int64_t(system_clock::to_time_t(expiry)) / 3600;
+
+        while (false == hours.empty() &&
+               hours.begin()->first < hour_end)
         {
-            if (tp - it->second.tp >
-                std::chrono::hours(TRANSACTION_MAX_LIFETIME_HOURS) +
-                std::chrono::seconds(NODES_TIME_SHIFT))
-                //  we don't need to keep in hash the transactions that are definitely expired
-                it = data.erase(it);
-            else
-                ++it;
+            auto keys = std::move(hours.begin()->second);
+            hours.erase(hours.begin());
+
+            for (auto const& key : keys)
+            {
+                auto it = data.find(key);
+                if (undo_enabled)
+                    undo.push_back(undo_type{key, true, it->second});
+                data.erase(it);
+            }
         }
     }
 
     bool contains(SignedTransaction const& signed_transaction) const
     {
-        string key = meshpp::hash(signed_transaction.to_string());
+        return contains(memoized_transaction(signed_transaction));
+    }
+    bool contains(memoized_transaction const& signed_transaction) const
+    {
+        string key = make_key(signed_transaction.details().digest(),
+                              signed_transaction.value().authorizations);
         return data.count(key) > 0;
     }
 
     void backup()
     {
-        data_backup = data;
+        undo.clear();
+        undo_enabled = true;
     }
     void restore() noexcept
     {
-        data = std::move(data_backup);
+        undo_enabled = false;
+
+        for (auto it = undo.rbegin(); it != undo.rend(); ++it)
+        {
+            if (it->existed)
+                insert(it->key, it->value);
+            else
+                erase(it->key);
+        }
+
+        undo.clear();
+    }
+    void commit() noexcept
+    {
+        undo_enabled = false;
+        undo.clear();
     }
 protected:
     class data_type
     {
     public:
         bool complete;
-        system_clock::time_point tp;
+        int64_t hour;
+    };
+    class undo_type
+    {
+    public:
+        string key;
+        bool existed;
+        data_type value;
     };
+
+    static
+    int64_t creation_hour(SignedTransaction const& signed_transaction)
+    {
+        return int64_t(signed_transaction.transaction_details.creation.tm) / 3600;
+    }
+
+    //  the details are hashed once, a key only adds the authorizations to their digest
+    static
+    string make_key(string const& details_digest,
+                    std::vector<Authority> const& authorizations)
+    {
+        string buffer = details_digest;
+        for (auto const& authorization : authorizations)
+        {
+            buffer += "\n" + authorization.address;
+            buffer += "\n" + authorization.signature;
+        }
+
+        return meshpp::from_base58(meshpp::hash(buffer));
+    }
+
+    //  the key of the transaction, then one for each authorization if there are many
+    static
+    int64_t make_keys(memoized_transaction const& signed_transaction,
+                      vector<string>& keys)
+    {
+        string const& details = signed_transaction.details().digest();
+        auto const& authorizations = signed_transaction.value().authorizations;
+
+        keys.push_back(make_key(details, authorizations));
+
+        if (authorizations.size() > 1)
+        {
+            for (auto const& authorization : authorizations)
+                keys.push_back(make_key(details, {authorization}));
+        }
+
+        return creation_hour(signed_transaction.value());
+    }
+
+    void insert(string const& key, data_type const& value)
+    {
+        auto insert_result = data.insert({key, value});
+        if (false == insert_result.second)
+            return;
+
+        hours[value.hour].insert(key);
+        if (undo_enabled)
+            undo.push_back(undo_type{key, false, value});
+    }
+
+    void erase(string const& key)
+    {
+        auto it = data.find(key);
+        if (it == data.end())
+            return;
+
+        auto it_hour = hours.find(it->second.hour);
+        if (it_hour != hours.end())
+        {
+            it_hour->second.erase(key);
+            if (it_hour->second.empty())
+                hours.erase(it_hour);
+        }
+
+        if (undo_enabled)
+            undo.push_back(undo_type{key, true, it->second});
+        data.erase(it);
+    }
+
     unordered_map<string, data_type> data;
-    unordered_map<string, data_type> data_backup;
+    map<int64_t, unordered_set<string>> hours;
+    vector<undo_type> undo;
+    bool undo_enabled;
 };
 
 using fp_counts_per_channel_views =
@@ -475,16 +582,23 @@ public:
         , m_broadcast_timer()
         , m_cache_cleanup_timer()
         , m_summary_report_timer()
+        , m_inventory_timer()
         , m_storage_sync_delay()
         , m_stuck_on_old_blockchain_timer()
         , m_blockchain(fs_blockchain)
+        , m_save_journal(fs_blockchain)
+        , m_saved_chain_hash()
+        , m_snapshot_pending()
+        , m_snapshot_written()
+        , m_block_undo()
         , m_action_log(fs_action_log, ref_config.action_log())
         , m_transaction_pool(fs_transaction_pool)
-        , m_state(fs_state, *this)
-        , m_documents(fs_documents, fs_storages)
-        , m_authority_manager(fs_authority_store)
+        , m_state(fs_state, *this, m_block_undo)
+        , m_documents(fs_documents, fs_storages, m_block_undo)
+        , m_authority_manager(fs_authority_store, m_block_undo)
         , m_storage_controller(fs_storage)
         , m_inbox(fs_inbox)
+        , m_signature_verifier(ref_config.verification_threads())
         , all_sync_info(*this)
         , pconfig(&ref_config)
         , m_service_statistics_broadcast_triggered(false)
@@ -502,12 +616,14 @@ public:
         , pcontent_unit_validate_check(nullptr != p_content_unit_validate_check ?
                                                       p_content_unit_validate_check :
                                                       &content_unit_validate_check)
+        , m_query_executor(ref_config.query_threads(), *m_ptr_eh)
     {
         m_sync_timer.set(chrono::seconds(SYNC_TIMER));
         m_check_timer.set(chrono::seconds(CHECK_TIMER));
         m_broadcast_timer.set(chrono::seconds(BROADCAST_TIMER));
         m_cache_cleanup_timer.set(chrono::seconds(CACHE_CLEANUP_TIMER));
         m_summary_report_timer.set(chrono::seconds(SUMMARY_REPORT_TIMER));
+        m_inventory_timer.set(chrono::seconds(INVENTORY_TIMER));
         m_storage_sync_delay.set(chrono::seconds(2 * CACHE_CLEANUP_TIMER));
         m_stuck_on_old_blockchain_timer.set(chrono::seconds(BLOCK_MINE_DELAY));
 
@@ -516,6 +632,18 @@ public:
         m_broadcast_timer.update();
         m_storage_sync_delay.update();
 
+        //  the containers of an interrupted save cannot be matched back,
+        //  the data is kept as is and the operator chooses how to recover
+        string interrupted_save;
+        if (false == resync &&
+            ref_config.load_snapshot().empty() &&
+            m_save_journal.interrupted(interrupted_save))
+            throw std::runtime_error("the node stopped while committing the state with " +
+                                     interrupted_save +
+                                     ", the stored data may be inconsistent. start with"
+                                     " --resync_blockchain to clean it up and sync again,"
+                                     " or with --load_snapshot to replace the state");
+
         if (false == pconfig->get_rpc_bind_to_address().local.empty())
             m_ptr_rpc_socket->listen(pconfig->get_rpc_bind_to_address());
 
@@ -556,6 +684,7 @@ public:
         m_sync_sessions.remove(peerid);
         m_nodeid_sessions.remove(peerid);
         m_sessions.remove(peerid);
+        m_inventory.remove_peer(peerid);
         if (0 == m_p2p_peers.erase(peerid))
             throw std::runtime_error("p2p peer not found to remove: " + peerid);
     }
@@ -569,18 +698,37 @@ public:
         m_transaction_pool.save();
         m_authority_manager.save();
 
+        //  a partially committed pool only save is not worth
+        //  two syncs each time, such saves are not journaled
+        string chain_hash = m_blockchain.last_hash();
+        bool journaled = (chain_hash != m_saved_chain_hash);
+        if (journaled)
+            m_save_journal.begin("blockchain length: " + std::to_string(m_blockchain.length()) +
+                                 ", last hash: " + chain_hash +
+                                 ", pool length: " + std::to_string(m_transaction_pool.length()));
+
         guard.dismiss();
 
+        m_transaction_cache.commit();
         m_state.commit();
         m_documents.commit();
         m_blockchain.commit();
         m_action_log.commit();
         m_transaction_pool.commit();
         m_authority_manager.commit();
+
+        if (journaled)
+            m_save_journal.end();
+        m_saved_chain_hash = chain_hash;
+
+        if (m_snapshot_pending)
+            write_snapshot();
     }
 
     void discard()
     {
+        m_snapshot_pending.reset();
+        m_block_undo.discard();
         m_state.discard();
         m_documents.discard();
         m_blockchain.discard();
@@ -639,8 +787,9 @@ public:
             m_state.increase_balance(item.to, item.amount, state_layer::chain);
 
         // insert to blockchain and action_log
-        m_blockchain.insert(signed_block);
-        m_action_log.log_block(signed_block, map<string, map<string, uint64_t>>(), map<string, coin>());
+        memoized_block block(signed_block);
+        m_blockchain.insert(signed_block, block.digest());
+        m_action_log.log_block(block, map<string, map<string, uint64_t>>(), map<string, coin>());
 
         save(guard);
     }
@@ -670,6 +819,23 @@ public:
 
     bool initialize();
 
+    filesystem::path snapshot_path(uint64_t block_number) const
+    {
+        return filesystem::path(pconfig->snapshot_directory()) /
+               ("snapshot." + std::to_string(block_number));
+    }
+    //  called right after a block is inserted, while the chain layer is free of the pool
+    //  the state is copied if the block is at the snapshot interval, and written on save
+    void prepare_snapshot();
+    void write_snapshot();
+    //  reports the snapshot written in the background, waits for it if asked
+    void check_snapshot(bool wait);
+    //  "path" or "path:digest" to check the snapshot against the expected digest
+    void load_snapshot(string const& value);
+    void migrate_state();
+    //  puts back what the block changed, false if it has no undo record
+    bool undo_block(uint64_t block_number);
+
     beltpp::ilog* plogger_p2p;
     beltpp::ilog* plogger_node;
     beltpp::event_handler_ptr m_ptr_eh;
@@ -682,10 +848,16 @@ public:
     beltpp::timer m_broadcast_timer;
     beltpp::timer m_cache_cleanup_timer;
     beltpp::timer m_summary_report_timer;
+    beltpp::timer m_inventory_timer;
     beltpp::timer m_storage_sync_delay;
     beltpp::timer m_stuck_on_old_blockchain_timer;
 
     publiqpp::blockchain m_blockchain;
+    publiqpp::save_journal m_save_journal;
+    string m_saved_chain_hash;
+    unique_ptr<snapshot_writer> m_snapshot_pending;
+    std::future<string> m_snapshot_written;
+    publiqpp::block_undo m_block_undo;
     publiqpp::action_log m_action_log;
     publiqpp::transaction_pool m_transaction_pool;
     publiqpp::state m_state;
@@ -693,6 +865,7 @@ public:
     publiqpp::authority_manager m_authority_manager;
     publiqpp::storage_controller m_storage_controller;
     publiqpp::inbox m_inbox;
+    publiqpp::signature_verifier m_signature_verifier;
 
     node_synchronization all_sync_info;
     detail::service_counter service_counter;
@@ -703,7 +876,11 @@ public:
     meshpp::session_manager<meshpp::session_header> m_sessions;
 
     unordered_set<beltpp::stream::peer_id> m_p2p_peers;
+    publiqpp::inventory m_inventory;
+    publiqpp::admission m_admission;
     transaction_cache m_transaction_cache;
+    //  transaction ids of the recent blocks served in compact form, by block hash
+    unordered_map<string, vector<string>> m_compact_transaction_ids;
 
     config* pconfig;
 
@@ -732,6 +909,8 @@ public:
     unordered_map<string, vote_info> m_votes;
     unordered_map<string, string> m_nodeid_authorities;
     event_queue_manager m_event_queue;
+    //  last, so the query threads are stopped before the sockets go
+    publiqpp::query_executor m_query_executor;
 };
 
 }
@@ -98,6 +98,7 @@ class nodeid_service_impl
 {
 public:
     nodeid_container::type nodeids;
+    mutable std::shared_ptr<nodeid_addresses const> addresses;
 };
 }
 
@@ -111,6 +112,8 @@ void nodeid_service::add(std::string const& node_address,
                          beltpp::ip_address const& ssl_address,
                          std::unique_ptr<session_action_broadcast_address_info>&& ptr_action)
 {
+    m_pimpl->addresses.reset();
+
     nodeid_address_unit nodeid_item;
     nodeid_item.header.address = address;
     nodeid_item.header.node_address = node_address;
@@ -159,6 +162,8 @@ void nodeid_service::keep_successful(std::string const& node_address,
                                      beltpp::ip_address const& address,
                                      bool verified)
 {
+    m_pimpl->addresses.reset();
+
     auto it = m_pimpl->nodeids.find(node_address);
     if (it == m_pimpl->nodeids.end())
     {
@@ -228,6 +233,8 @@ void nodeid_service::keep_successful(std::string const& node_address,
 void nodeid_service::erase_failed(std::string const& node_address,
                                   beltpp::ip_address const& address)
 {
+    m_pimpl->addresses.reset();
+
     auto it = m_pimpl->nodeids.find(node_address);
     if (it == m_pimpl->nodeids.end())
     {
@@ -289,10 +296,13 @@ void nodeid_service::take_actions(std::function<void (std::string const&/* node_
     }
 }
 
-BlockchainMessage::PublicAddressesInfo nodeid_service::get_addresses() const
+std::shared_ptr<nodeid_addresses const> nodeid_service::addresses() const
 {
-    BlockchainMessage::PublicAddressesInfo result;
-    BlockchainMessage::PublicAddressesInfo result_verified;
+    if (m_pimpl->addresses)
+        return m_pimpl->addresses;
+
+    std::shared_ptr<nodeid_addresses> result(new nodeid_addresses());
+    vector<nodeid_addresses::item> items_checked;
 
     auto& index_by_checked_time_point = m_pimpl->nodeids.template get<nodeid_container::by_checked_time_point>();
 
@@ -300,37 +310,57 @@ BlockchainMessage::PublicAddressesInfo nodeid_service::get_addresses() const
          it != index_by_checked_time_point.rend();
          ++it)
     {
-        BlockchainMessage::PublicAddressInfo address_info;
-        beltpp::assign(address_info.ip_address, it->header.address);
-        address_info.node_address = it->header.node_address;
+        nodeid_addresses::item item;
+        beltpp::assign(item.info.ip_address, it->header.address);
+        item.info.node_address = it->header.node_address;
+        beltpp::assign(item.info.ssl_ip_address, it->ssl_address);
+        item.info.seconds_since_checked = 0;
+
+        item.current = (it->verified == nodeid_address_unit::verified_type::current);
+        item.never_checked = (it->verified == nodeid_address_unit::verified_type::never);
+        item.checked_time_point = it->header.checked_time_point;
+
+        if (item.current)
+            result->items.push_back(std::move(item));
+        else
+            items_checked.push_back(std::move(item));
+    }
 
-        beltpp::assign(address_info.ssl_ip_address, it->ssl_address);
+    result->items.insert(result->items.end(),
+                         items_checked.begin(),
+                         items_checked.end());
 
-        if (it->verified == nodeid_address_unit::verified_type::current)
-        {
-            address_info.seconds_since_checked = 0;
+    m_pimpl->addresses = result;
+    return m_pimpl->addresses;
+}
 
-            result_verified.addresses_info.push_back(std::move(address_info));
-        }
-        else
+BlockchainMessage::PublicAddressesInfo nodeid_service::get_addresses() const
+{
+    return addresses()->get_addresses();
+}
+
+BlockchainMessage::PublicAddressesInfo nodeid_addresses::get_addresses() const
+{
+    BlockchainMessage::PublicAddressesInfo result;
+    result.addresses_info.reserve(items.size());
+
+    for (auto const& item : items)
+    {
+        BlockchainMessage::PublicAddressInfo address_info = item.info;
+
+        if (false == item.current)
         {
             chrono::seconds seconds_since;
-            if (it->verified == nodeid_address_unit::verified_type::never)
+            if (item.never_checked)
                 seconds_since = chrono::duration_cast<chrono::seconds>(system_clock::now() - system_clock::time_point());
             else
-                seconds_since = chrono::duration_cast<chrono::seconds>(steady_clock::now() - it->header.checked_time_point);
+                seconds_since = chrono::duration_cast<chrono::seconds>(steady_clock::now() - item.checked_time_point);
 
             address_info.seconds_since_checked = uint64_t(seconds_since.count());
-
-            result.addresses_info.push_back(std::move(address_info));
         }
-    }
-
-    result_verified.addresses_info.insert(result_verified.addresses_info.end(),
-                                          result.addresses_info.begin(),
-                                          result.addresses_info.end());
 
-    result = std::move(result_verified);
+        result.addresses_info.push_back(std::move(address_info));
+    }
 
     return result;
 }
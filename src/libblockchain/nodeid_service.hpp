@@ -7,6 +7,8 @@
 
 #include <memory>
 #include <functional>
+#include <chrono>
+#include <vector>
 
 namespace publiqpp
 {
@@ -17,6 +19,26 @@ namespace detail
     class nodeid_service_impl;
 }
 
+//  the addresses as they were when taken, never changed after
+//  so the answer can be made out of them on the query threads
+class nodeid_addresses
+{
+public:
+    class item
+    {
+    public:
+        BlockchainMessage::PublicAddressInfo info;
+        bool current;
+        bool never_checked;
+        std::chrono::steady_clock::time_point checked_time_point;
+    };
+
+    //  verified ones first, then the recently checked
+    std::vector<item> items;
+
+    BlockchainMessage::PublicAddressesInfo get_addresses() const;
+};
+
 class nodeid_service
 {
 public:
@@ -39,6 +61,8 @@ public:
                                           beltpp::ip_address const& address,
                                           std::unique_ptr<session_action_broadcast_address_info>&& ptr_action)> const& callback);
 
+    //  taken again only after the addresses have changed
+    std::shared_ptr<nodeid_addresses const> addresses() const;
     BlockchainMessage::PublicAddressesInfo get_addresses() const;
 private:
     std::unique_ptr<detail::nodeid_service_impl> m_pimpl;
@@ -0,0 +1,185 @@
+#include "query_executor.hpp"
+#include "message.hpp"
+#include "message.tmpl.hpp"
+
+#include <mesh.pp/cryptoutility.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+using std::string;
+using std::vector;
+using std::mutex;
+using std::unique_lock;
+using namespace BlockchainMessage;
+
+namespace publiqpp
+{
+namespace detail
+{
+class query_item
+{
+public:
+    beltpp::stream::peer_id peerid;
+    std::function<beltpp::packet()> query;
+};
+
+class query_executor_internals
+{
+public:
+    query_executor_internals(size_t thread_count, beltpp::event_handler& _eh)
+        : peh(&_eh)
+        , answered(0)
+        , stop(false)
+    {
+        if (0 == thread_count)
+            thread_count = std::thread::hardware_concurrency();
+        if (0 == thread_count)
+            thread_count = 1;
+
+        for (size_t index = 0; index < thread_count; ++index)
+            workers.push_back(std::thread([this]{ worker(); }));
+    }
+
+    ~query_executor_internals()
+    {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            stop = true;
+        }
+        cv_work.notify_all();
+
+        for (auto& item : workers)
+            item.join();
+    }
+
+    void worker()
+    {
+        unique_lock<mutex> lock(m_mutex);
+
+        while (true)
+        {
+            cv_work.wait(lock, [this]
+            {
+                return stop || false == queries.empty();
+            });
+
+            if (stop)
+                break;
+
+            query_item item = std::move(queries.front());
+            queries.pop_front();
+            lock.unlock();
+
+            query_executor::result item_result;
+            item_result.peerid = std::move(item.peerid);
+            item_result.package = publiqpp::answer_query(item.query);
+
+            lock.lock();
+            results.push_back(std::move(item_result));
+            ++answered;
+
+            //  the loop may be waiting for socket events
+            peh->wake();
+        }
+    }
+
+    beltpp::event_handler* peh;
+    mutable mutex m_mutex;
+    std::condition_variable cv_work;
+    std::deque<query_item> queries;
+    vector<query_executor::result> results;
+    vector<std::thread> workers;
+    std::atomic<uint64_t> answered;
+    bool stop;
+};
+}
+
+beltpp::packet answer_query(std::function<beltpp::packet()> const& query)
+{
+    try
+    {
+        return query();
+    }
+    catch (meshpp::exception_public_key const& e)
+    {
+        InvalidPublicKey msg;
+        msg.public_key = e.pub_key;
+        return beltpp::packet(std::move(msg));
+    }
+    catch (meshpp::exception_private_key const& e)
+    {
+        InvalidPrivateKey msg;
+        msg.private_key = e.priv_key;
+        return beltpp::packet(std::move(msg));
+    }
+    catch (meshpp::exception_signature const& e)
+    {
+        InvalidSignature msg;
+        msg.details.public_key = e.sgn.pb_key.to_string();
+        msg.details.signature = e.sgn.base58;
+        BlockchainMessage::detail::loader(msg.details.package,
+                                          string(e.sgn.message.begin(), e.sgn.message.end()),
+                                          nullptr);
+        return beltpp::packet(std::move(msg));
+    }
+    catch (std::exception const& e)
+    {
+        RemoteError msg;
+        msg.message = e.what();
+        return beltpp::packet(std::move(msg));
+    }
+    catch (...)
+    {
+        RemoteError msg;
+        msg.message = "unknown exception";
+        return beltpp::packet(std::move(msg));
+    }
+}
+
+query_executor::query_executor(size_t thread_count, beltpp::event_handler& eh)
+    : m_pimpl(new detail::query_executor_internals(thread_count, eh))
+{
+}
+
+query_executor::~query_executor() = default;
+
+size_t query_executor::thread_count() const
+{
+    return m_pimpl->workers.size();
+}
+
+void query_executor::run(beltpp::stream::peer_id const& peerid,
+                         std::function<beltpp::packet()> const& query)
+{
+    {
+        unique_lock<mutex> lock(m_pimpl->m_mutex);
+        m_pimpl->queries.push_back(detail::query_item{peerid, query});
+    }
+    m_pimpl->cv_work.notify_one();
+}
+
+vector<query_executor::result> query_executor::take_results()
+{
+    vector<result> taken;
+
+    unique_lock<mutex> lock(m_pimpl->m_mutex);
+    taken.swap(m_pimpl->results);
+
+    return taken;
+}
+
+size_t query_executor::pending() const
+{
+    unique_lock<mutex> lock(m_pimpl->m_mutex);
+    return m_pimpl->queries.size();
+}
+
+uint64_t query_executor::answered() const
+{
+    return m_pimpl->answered;
+}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <belt.pp/ievent.hpp>
+#include <belt.pp/isocket.hpp>
+#include <belt.pp/packet.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace publiqpp
+{
+
+namespace detail
+{
+class query_executor_internals;
+}
+
+//  answers rpc queries that do not touch the node state on a pool of threads
+//  the sockets belong to the event loop, so the answers are queued and the
+//  event handler is woken up, the loop sends them with take_results()
+//  a query that throws is answered with the error message an rpc client gets
+class query_executor
+{
+public:
+    class result
+    {
+    public:
+        beltpp::stream::peer_id peerid;
+        beltpp::packet package;
+    };
+
+    //  thread_count 0 means one thread per hardware thread
+    query_executor(size_t thread_count, beltpp::event_handler& eh);
+    ~query_executor();
+
+    size_t thread_count() const;
+
+    void run(beltpp::stream::peer_id const& peerid,
+             std::function<beltpp::packet()> const& query);
+    std::vector<result> take_results();
+
+    size_t pending() const;
+    uint64_t answered() const;
+private:
+    std::unique_ptr<detail::query_executor_internals> m_pimpl;
+};
+
+//  runs the query, what it throws becomes the error message an rpc client gets
+beltpp::packet answer_query(std::function<beltpp::packet()> const& query);
+
+}
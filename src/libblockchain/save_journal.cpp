@@ -0,0 +1,98 @@
+#include "save_journal.hpp"
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <stdexcept>
+
+#ifdef P_OS_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace filesystem = boost::filesystem;
+using std::string;
+
+namespace publiqpp
+{
+namespace
+{
+string const prefix_begin = "begin ";
+string const prefix_end = "end ";
+}
+
+save_journal::save_journal(filesystem::path const& path)
+    : m_path(path / "save.journal")
+    , m_sequence(0)
+{
+    filesystem::ifstream fl(m_path);
+    string line;
+    if (std::getline(fl, line))
+    {
+        auto pos = line.find(' ');
+        if (pos != string::npos)
+            m_sequence = std::stoull(line.substr(pos + 1));
+    }
+}
+
+bool save_journal::interrupted(string& description) const
+{
+    filesystem::ifstream fl(m_path);
+    string line;
+    if (false == bool(std::getline(fl, line)) ||
+        0 != line.compare(0, prefix_begin.length(), prefix_begin))
+        return false;
+
+    std::getline(fl, description);
+    return true;
+}
+
+void save_journal::begin(string const& description)
+{
+    ++m_sequence;
+    write(prefix_begin + std::to_string(m_sequence) + "\n" + description + "\n");
+}
+
+void save_journal::end() noexcept
+{
+    try
+    {
+        //  if this fails the begin record stays, and the
+        //  next start refuses to run on the committed data
+        write(prefix_end + std::to_string(m_sequence) + "\n");
+    }
+    catch (...)
+    {}
+}
+
+void save_journal::write(string const& record)
+{
+    string path = m_path.string();
+#ifdef P_OS_WINDOWS
+    int fd = ::_open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0)
+        throw std::runtime_error("save_journal: cannot open: " + path);
+
+    bool code = true;
+#ifdef P_OS_WINDOWS
+    code = (int(record.size()) == ::_write(fd, record.data(), unsigned(record.size())));
+    if (code)
+        code = (0 == ::_commit(fd));
+    ::_close(fd);
+#else
+    code = (ssize_t(record.size()) == ::write(fd, record.data(), record.size()));
+    if (code)
+        code = (0 == ::fsync(fd));
+    ::close(fd);
+#endif
+
+    if (false == code)
+        throw std::runtime_error("save_journal: cannot write: " + path);
+}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+
+namespace publiqpp
+{
+//  marks the commit phase of a save that spans several containers
+//  begin() is written once per batch, after every container has saved
+//  and before the first one commits, end() follows the last commit.
+//  a begin() without end() found on startup means the containers were
+//  committed only partially. both records are synced to disk, so a save
+//  that completed is never reported as interrupted after a power loss
+class save_journal
+{
+public:
+    save_journal(boost::filesystem::path const& path);
+
+    bool interrupted(std::string& description) const;
+
+    void begin(std::string const& description);
+    void end() noexcept;
+private:
+    void write(std::string const& record);
+
+    boost::filesystem::path m_path;
+    uint64_t m_sequence;
+};
+}
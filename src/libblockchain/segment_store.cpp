@@ -0,0 +1,409 @@
+#include "segment_store.hpp"
+#include "file_sync.hpp"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <set>
+
+namespace filesystem = boost::filesystem;
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::unordered_map;
+
+namespace publiqpp
+{
+namespace detail
+{
+struct segment_index_entry
+{
+    uint64_t offset;
+    uint32_t segment;
+    uint32_t size;
+};
+static_assert(sizeof(segment_index_entry) == 16, "index entry must be fixed width");
+
+//  every record in a segment file is preceded by its size
+size_t const record_prefix_size = sizeof(uint32_t);
+
+class segment_store_internals
+{
+public:
+    segment_store_internals(string const& _name,
+                            filesystem::path const& _path,
+                            uint64_t _segment_size)
+        : name(_name)
+        , path(_path)
+        , segment_size(_segment_size)
+        , base(0)
+        , flushed(0)
+        , saved(false)
+    {}
+
+    filesystem::path segment_path(uint32_t segment) const
+    {
+        return path / (name + "." + std::to_string(segment) + ".seg");
+    }
+    filesystem::path index_path() const
+    {
+        return path / (name + ".idx");
+    }
+    filesystem::path state_path() const
+    {
+        return path / (name + ".state");
+    }
+    filesystem::path state_tmp_path() const
+    {
+        return path / (name + ".state.tmp");
+    }
+
+    uint64_t size() const
+    {
+        return base + pending.size();
+    }
+
+    segment_index_entry tail() const
+    {
+        segment_index_entry result = {0, 0, 0};
+        if (false == index.empty())
+        {
+            result.segment = index.back().segment;
+            result.offset = index.back().offset + record_prefix_size + index.back().size;
+        }
+        return result;
+    }
+
+    void load()
+    {
+        boost::system::error_code ec;
+        filesystem::remove(state_tmp_path(), ec);
+
+        index.clear();
+
+        filesystem::ifstream fl_index(index_path(), std::ios_base::binary);
+        if (fl_index)
+        {
+            segment_index_entry entry;
+            while (fl_index.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+                index.push_back(entry);
+        }
+        fl_index.close();
+
+        filesystem::ifstream fl_state(state_path(), std::ios_base::binary);
+        if (false == fl_state.is_open())
+        {
+            index.clear();
+            base = 0;
+            flushed = 0;
+            return;
+        }
+
+        uint64_t count = 0, first = 0;
+        fl_state.read(reinterpret_cast<char*>(&count), sizeof(count));
+        fl_state.read(reinterpret_cast<char*>(&first), sizeof(first));
+        if (!fl_state || first > count)
+            throw std::runtime_error("segment_store: corrupted state: " + state_path().string());
+
+        if (first > index.size())
+            throw std::runtime_error("segment_store: index is behind state: " + index_path().string());
+
+        index.resize(count);
+        for (uint64_t number = first; number < count; ++number)
+        {
+            if (false == fl_state.read(reinterpret_cast<char*>(&index[number]), sizeof(segment_index_entry)).good())
+                throw std::runtime_error("segment_store: corrupted state: " + state_path().string());
+        }
+
+        base = index.size();
+        flushed = first;
+        flush_index();
+    }
+
+    //  replays the committed index entries starting from flushed into the index file
+    void flush_index()
+    {
+        if (flushed == index.size())
+            return;
+
+        if (false == filesystem::exists(index_path()))
+            filesystem::ofstream create(index_path(), std::ios_base::binary);
+
+        filesystem::fstream fl(index_path(), std::ios_base::binary |
+                                             std::ios_base::in |
+                                             std::ios_base::out);
+        fl.seekp(flushed * sizeof(segment_index_entry));
+        fl.write(reinterpret_cast<char const*>(&index[flushed]),
+                 (index.size() - flushed) * sizeof(segment_index_entry));
+        fl.flush();
+        if (!fl)
+            throw std::runtime_error("segment_store: cannot write index: " + index_path().string());
+        fl.close();
+
+        filesystem::resize_file(index_path(), index.size() * sizeof(segment_index_entry));
+        flushed = index.size();
+    }
+
+    filesystem::ifstream& reader(uint32_t segment) const
+    {
+        auto& ptr = readers[segment];
+        if (nullptr == ptr)
+        {
+            ptr.reset(new filesystem::ifstream(segment_path(segment), std::ios_base::binary));
+            if (false == ptr->is_open())
+            {
+                ptr.reset();
+                throw std::runtime_error("segment_store: cannot open: " + segment_path(segment).string());
+            }
+        }
+        ptr->clear();
+        return *ptr;
+    }
+
+    string name;
+    filesystem::path path;
+    uint64_t segment_size;
+    //  committed entries
+    vector<segment_index_entry> index;
+    //  records [0, base) are committed and not removed
+    uint64_t base;
+    //  records [base, size()) are kept in memory until commit
+    vector<string> pending;
+    vector<segment_index_entry> pending_entries;
+    //  count of entries in index file that match index
+    uint64_t flushed;
+    bool saved;
+    mutable unordered_map<uint32_t, unique_ptr<filesystem::ifstream>> readers;
+};
+}
+
+segment_store::segment_store(string const& name,
+                             filesystem::path const& path,
+                             uint64_t segment_size)
+    : m_pimpl(new detail::segment_store_internals(name, path, segment_size))
+{
+    m_pimpl->load();
+}
+
+segment_store::~segment_store() = default;
+
+void segment_store::save()
+{
+    auto& impl = *m_pimpl;
+    impl.pending_entries.clear();
+
+    //  new records go after the committed tail so that
+    //  nothing committed is overwritten before commit
+    detail::segment_index_entry position = impl.tail();
+    unique_ptr<filesystem::fstream> fl;
+    std::set<uint32_t> written_segments;
+
+    for (auto const& record : impl.pending)
+    {
+        if (record.size() > uint32_t(-1))
+            throw std::runtime_error("segment_store::save: record is too large");
+
+        uint64_t record_size = detail::record_prefix_size + record.size();
+        if (position.offset > 0 &&
+            position.offset + record_size > impl.segment_size)
+        {
+            ++position.segment;
+            position.offset = 0;
+            fl.reset();
+        }
+
+        if (nullptr == fl)
+        {
+            auto segment_path = impl.segment_path(position.segment);
+            if (false == filesystem::exists(segment_path))
+                filesystem::ofstream create(segment_path, std::ios_base::binary);
+
+            fl.reset(new filesystem::fstream(segment_path, std::ios_base::binary |
+                                                           std::ios_base::in |
+                                                           std::ios_base::out));
+            if (false == fl->is_open())
+                throw std::runtime_error("segment_store::save: cannot open: " + segment_path.string());
+        }
+
+        uint32_t size = uint32_t(record.size());
+        fl->seekp(position.offset);
+        fl->write(reinterpret_cast<char const*>(&size), sizeof(size));
+        fl->write(record.data(), record.size());
+        fl->flush();
+        if (false == fl->good())
+            throw std::runtime_error("segment_store::save: cannot write: " +
+                                     impl.segment_path(position.segment).string());
+
+        position.size = size;
+        impl.pending_entries.push_back(position);
+        written_segments.insert(position.segment);
+        position.offset += record_size;
+    }
+    fl.reset();
+
+    for (auto segment : written_segments)
+        sync_file(impl.segment_path(segment));
+
+    //  the journal holds every index entry that the index file may still miss
+    uint64_t count = impl.size();
+    uint64_t first = std::min(impl.base, impl.flushed);
+
+    filesystem::ofstream fl_state(impl.state_tmp_path(), std::ios_base::binary | std::ios_base::trunc);
+    fl_state.write(reinterpret_cast<char const*>(&count), sizeof(count));
+    fl_state.write(reinterpret_cast<char const*>(&first), sizeof(first));
+    for (uint64_t number = first; number < count; ++number)
+    {
+        auto const& entry = number < impl.base ?
+                                impl.index[number] :
+                                impl.pending_entries[number - impl.base];
+        fl_state.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+    }
+    fl_state.close();
+    if (fl_state.fail())
+        throw std::runtime_error("segment_store::save: cannot write: " + impl.state_tmp_path().string());
+    sync_file(impl.state_tmp_path());
+
+    impl.readers.clear();
+    impl.saved = true;
+}
+
+void segment_store::commit() noexcept
+{
+    auto& impl = *m_pimpl;
+    if (false == impl.saved)
+        return;
+
+    boost::system::error_code ec;
+    filesystem::rename(impl.state_tmp_path(), impl.state_path(), ec);
+    if (ec)
+        return;
+
+    impl.flushed = std::min(impl.base, impl.flushed);
+    impl.index.resize(impl.base);
+    impl.index.insert(impl.index.end(), impl.pending_entries.begin(), impl.pending_entries.end());
+    impl.base = impl.index.size();
+    impl.pending.clear();
+    impl.pending_entries.clear();
+    impl.saved = false;
+
+    try
+    {
+        //  if this fails the journal in state file will be replayed on load
+        impl.flush_index();
+    }
+    catch (...)
+    {}
+
+    //  segments after the tail hold only removed records
+    uint32_t segment = impl.tail().segment + 1;
+    while (filesystem::exists(impl.segment_path(segment), ec))
+    {
+        impl.readers.erase(segment);
+        filesystem::remove(impl.segment_path(segment), ec);
+        ++segment;
+    }
+
+    //  and after clear() the segments before the head hold only cleared ones
+    if (false == impl.index.empty())
+    {
+        segment = impl.index.front().segment;
+        while (segment > 0 && filesystem::exists(impl.segment_path(segment - 1), ec))
+        {
+            --segment;
+            impl.readers.erase(segment);
+            filesystem::remove(impl.segment_path(segment), ec);
+        }
+    }
+}
+
+void segment_store::discard() noexcept
+{
+    auto& impl = *m_pimpl;
+
+    impl.pending.clear();
+    impl.pending_entries.clear();
+    impl.base = impl.index.size();
+
+    if (impl.saved)
+    {
+        boost::system::error_code ec;
+        filesystem::remove(impl.state_tmp_path(), ec);
+        impl.saved = false;
+    }
+}
+
+void segment_store::clear()
+{
+    m_pimpl->pending.clear();
+    m_pimpl->base = 0;
+    m_pimpl->saved = false;
+}
+
+uint64_t segment_store::size() const
+{
+    return m_pimpl->size();
+}
+
+uint64_t segment_store::stable_size() const
+{
+    return m_pimpl->base;
+}
+
+void segment_store::push_back(string&& record)
+{
+    m_pimpl->pending.push_back(std::move(record));
+    m_pimpl->saved = false;
+}
+
+void segment_store::pop_back()
+{
+    if (0 == size())
+        throw std::logic_error("segment_store::pop_back: 0 == size()");
+
+    if (m_pimpl->pending.empty())
+        --m_pimpl->base;
+    else
+        m_pimpl->pending.pop_back();
+
+    m_pimpl->saved = false;
+}
+
+string segment_store::at(uint64_t number) const
+{
+    auto const& impl = *m_pimpl;
+    if (number >= impl.size())
+        throw std::out_of_range("segment_store::at: " + std::to_string(number));
+
+    if (number >= impl.base)
+        return impl.pending[number - impl.base];
+
+    auto const& entry = impl.index[number];
+    auto& fl = impl.reader(entry.segment);
+
+    uint32_t size = 0;
+    fl.seekg(entry.offset);
+    fl.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (false == fl.good() || size != entry.size)
+        throw std::runtime_error("segment_store::at: corrupted record " + std::to_string(number) +
+                                 " in " + impl.segment_path(entry.segment).string());
+
+    string result(size, '\0');
+    if (size)
+        fl.read(&result[0], size);
+    if (false == fl.good())
+        throw std::runtime_error("segment_store::at: cannot read record " + std::to_string(number) +
+                                 " from " + impl.segment_path(entry.segment).string());
+
+    return result;
+}
+
+bool segment_store::exists(string const& name,
+                           filesystem::path const& path)
+{
+    return filesystem::exists(path / (name + ".state"));
+}
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "global.hpp"
+#include "binary.hpp"
+
+#include <belt.pp/packet.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+#include <memory>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <stdexcept>
+
+namespace publiqpp
+{
+
+namespace detail
+{
+class segment_store_internals;
+}
+
+//  append-only record store
+//  records are written into segment files "<name>.<number>.seg" and addressed
+//  by the fixed width offset index "<name>.idx", one entry per record number
+//  save() writes the records and prepares the index journal "<name>.state.tmp"
+//  commit() makes it current by renaming to "<name>.state", discard() drops it
+class BLOCKCHAINSHARED_EXPORT segment_store
+{
+public:
+    segment_store(std::string const& name,
+                  boost::filesystem::path const& path,
+                  uint64_t segment_size);
+    ~segment_store();
+
+    void save();
+    void commit() noexcept;
+    void discard() noexcept;
+    void clear();
+
+    uint64_t size() const;
+    //  records below this number are the same as on disk,
+    //  the rest may disappear on discard
+    uint64_t stable_size() const;
+
+    void push_back(std::string&& record);
+    void pop_back();
+    std::string at(uint64_t number) const;
+
+    static bool exists(std::string const& name,
+                       boost::filesystem::path const& path);
+private:
+    std::unique_ptr<detail::segment_store_internals> m_pimpl;
+};
+
+enum class segment_encoding { json, binary };
+
+//  segment_store of idl messages with a bounded cache of decoded records
+//  at() shares the decoded record with the cache, so it outlives the eviction
+//  the cache is locked, reads may come from other threads than the writes
+//  new records are written with the given encoding, binary ones start with a zero
+//  byte that json never does, so stores written with either are read back alike
+template <typename T>
+class segment_loader
+{
+public:
+    segment_loader(std::string const& name,
+                   boost::filesystem::path const& path,
+                   uint64_t segment_size,
+                   size_t cache_size,
+                   segment_encoding encoding,
+                   beltpp::void_unique_ptr&& putl)
+        : m_store(name, path, segment_size)
+        , m_cache_size(cache_size)
+        , m_encoding(encoding)
+        , m_putl(std::move(putl))
+    {
+        if (0 == m_cache_size)
+            m_cache_size = 1;
+    }
+
+    void save()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_store.save();
+    }
+    void commit() noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_store.commit();
+    }
+    void discard() noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uncache(m_store.stable_size());
+        m_store.discard();
+    }
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uncache(0);
+        m_store.clear();
+    }
+
+    uint64_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_store.size();
+    }
+
+    void push_back(T const& value)
+    {
+        std::string record;
+        if (segment_encoding::binary == m_encoding)
+            record = std::string(1, '\0') + to_binary(value);
+        else
+            record = value.to_string();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t number = m_store.size();
+        m_store.push_back(std::move(record));
+        cache(number, std::make_shared<T const>(value));
+    }
+    void pop_back()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uncache(m_store.size() - 1);
+        m_store.pop_back();
+    }
+
+    std::shared_ptr<T const> at(uint64_t number) const
+    {
+        std::string record;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (number >= m_store.size())
+                throw std::out_of_range("segment_loader::at: " + std::to_string(number));
+
+            auto it = m_cache.find(number);
+            if (it != m_cache.end())
+            {
+                m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+                return it->second.first;
+            }
+
+            record = m_store.at(number);
+        }
+
+        //  decoded outside of the lock, a concurrent read of
+        //  the same record only costs a second decoding
+        auto value = std::make_shared<T>();
+        if (false == record.empty() && '\0' == record.front())
+            from_binary(record.data() + 1, record.data() + record.size(), *value, m_putl.get());
+        else
+            value->from_string(record, m_putl.get());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        //  the record may have been popped meanwhile
+        if (number < m_store.size())
+            cache(number, value);
+        return value;
+    }
+
+private:
+    void cache(uint64_t number, std::shared_ptr<T const> const& value) const
+    {
+        auto it = m_cache.find(number);
+        if (it != m_cache.end())
+        {
+            m_lru.erase(it->second.second);
+            m_cache.erase(it);
+        }
+
+        while (m_cache.size() >= m_cache_size)
+        {
+            m_cache.erase(m_lru.back());
+            m_lru.pop_back();
+        }
+
+        m_lru.push_front(number);
+        m_cache.emplace(number, std::make_pair(value, m_lru.begin()));
+    }
+    void uncache(uint64_t from_number) const
+    {
+        for (auto it = m_lru.begin(); it != m_lru.end();)
+        {
+            if (*it >= from_number)
+            {
+                m_cache.erase(*it);
+                it = m_lru.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+
+    segment_store m_store;
+    size_t m_cache_size;
+    segment_encoding m_encoding;
+    beltpp::void_unique_ptr m_putl;
+    mutable std::mutex m_mutex;
+    mutable std::list<uint64_t> m_lru;
+    mutable std::unordered_map<uint64_t, std::pair<std::shared_ptr<T const>, std::list<uint64_t>::iterator>> m_cache;
+};
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <belt.pp/packet.hpp>
+
+#include <string>
+#include <memory>
+
+namespace publiqpp
+{
+//  a message serialized once and shared by every packet made from it
+//  the socket asks the saver for each packet, which only copies the bytes
+//  these packets are only to be sent, get() of the original type must not be used
+class serialized_message
+{
+public:
+    std::shared_ptr<std::string const> buffer;
+
+    static std::string pvoid_saver(void* p)
+    {
+        return *static_cast<serialized_message*>(p)->buffer;
+    }
+};
+
+inline
+beltpp::packet serialized_packet(size_t rtt, std::shared_ptr<std::string const> const& buffer)
+{
+    auto p = beltpp::new_void_unique_ptr<serialized_message>();
+    serialized_message& ref = *reinterpret_cast<serialized_message*>(p.get());
+    ref.buffer = buffer;
+
+    beltpp::packet result;
+    result.set(rtt, std::move(p), &serialized_message::pvoid_saver);
+
+    return result;
+}
+}
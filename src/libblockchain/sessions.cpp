@@ -16,6 +16,7 @@
 #include <algorithm>
 #include <map>
 #include <vector>
+#include <utility>
 
 namespace chrono = std::chrono;
 using chrono::system_clock;
@@ -249,11 +250,9 @@ session_action_broadcast_address_info::~session_action_broadcast_address_info()
 void session_action_broadcast_address_info::initiate(meshpp::nodeid_session_header&)
 {
     broadcast_message(std::move(msg),
-                      pimpl->m_ptr_p2p_socket->name(),
                       source_peer,
-                      true,
-                      nullptr,
                       pimpl->m_p2p_peers,
+                      pimpl->m_inventory,
                       pimpl->m_ptr_p2p_socket.get());
 
     expected_next_package_type = size_t(-1);
@@ -495,7 +494,7 @@ void session_action_header::process_response(meshpp::nodeid_session_header& head
             prev_hash = pimpl->m_blockchain.last_hash();
         else if (r_it->block_number < pimpl->m_blockchain.length())
         {
-            BlockHeader const& _header = pimpl->m_blockchain.header_at(r_it->block_number);
+            BlockHeader _header = pimpl->m_blockchain.header_at(r_it->block_number);
             prev_hash = _header.prev_hash;
         }
 
@@ -529,7 +528,7 @@ void session_action_header::process_response(meshpp::nodeid_session_header& head
             index = lcb_index + 1 - DELTA_STEP;
         for (; index <= lcb_index; ++index)
         {
-            BlockHeader const& tmp_header = pimpl->m_blockchain.header_at(index);
+            BlockHeader tmp_header = pimpl->m_blockchain.header_at(index);
             delta_vector.push_back(std::make_pair(tmp_header.delta, tmp_header.c_const));
         }
 
@@ -578,19 +577,264 @@ bool session_action_header::check_headers_vector(std::vector<BlockchainMessage::
     return t;
 }
 
+// --------------------------- block_download ---------------------------
+
+block_download::block_download(vector<BlockHeaderExtended> const& headers)
+    : powner(nullptr)
+    , lowest_block_number(headers.back().block_number)
+    , block_hashes()
+    , chunks()
+    , next_chunk(0)
+    , duplicates(0)
+    , received_chunks()
+    , requests()
+    , stats()
+    , dropped()
+{
+    for (auto it = headers.crbegin(); it != headers.crend(); ++it)
+        block_hashes.push_back(it->block_hash);
+
+    size_t length = BLOCK_TR_LENGTH + 1;
+    chunks.resize((block_hashes.size() + length - 1) / length, chunk_state::pending);
+}
+
+uint64_t block_download::top_block_number() const
+{
+    return lowest_block_number + block_hashes.size() - 1;
+}
+
+string const& block_download::block_hash(uint64_t block_number) const
+{
+    return block_hashes.at(block_number - lowest_block_number);
+}
+
+bool block_download::assign(beltpp::stream::peer_id const& peerid,
+                            bool head_of_line,
+                            uint64_t& from,
+                            uint64_t& to)
+{
+    if (dropped.count(peerid))
+        return false;
+
+    auto& peer_requests = requests[peerid];
+    if (peer_requests.size() >= BLOCK_DOWNLOAD_PEER_REQUESTS)
+        return false;
+
+    size_t window_end = std::min(chunks.size(), next_chunk + BLOCK_DOWNLOAD_WINDOW);
+    size_t chunk = window_end;
+    for (size_t index = next_chunk; index != window_end; ++index)
+    {
+        if (chunks[index] == chunk_state::pending)
+        {
+            chunk = index;
+            break;
+        }
+    }
+
+    //  the rest is processed only after this one,
+    //  so it is worth asking for it twice if the first peer is slow
+    if (chunk == window_end &&
+        head_of_line &&
+        next_chunk != chunks.size() &&
+        chunks[next_chunk] == chunk_state::requested &&
+        false == requested_by(peerid, next_chunk))
+        chunk = next_chunk;
+
+    if (chunk == window_end)
+        return false;
+
+    chunks[chunk] = chunk_state::requested;
+    peer_requests.push_back(request{chunk, steady_clock::now()});
+
+    from = lowest_block_number + chunk * (BLOCK_TR_LENGTH + 1);
+    to = from + chunk_length(chunk) - 1;
+
+    return true;
+}
+
+bool block_download::received(beltpp::stream::peer_id const& peerid,
+                              BlockchainResponse&& response)
+{
+    auto it_requests = requests.find(peerid);
+    if (it_requests == requests.end() ||
+        it_requests->second.empty())
+        return false;
+
+    //  a peer answers the requests in the order they were sent
+    request current = it_requests->second.front();
+    it_requests->second.pop_front();
+
+    uint64_t from = lowest_block_number + current.chunk * (BLOCK_TR_LENGTH + 1);
+    bool ok = (response.signed_blocks.size() == chunk_length(current.chunk));
+    for (size_t index = 0; ok && index != response.signed_blocks.size(); ++index)
+    {
+        Block const& block = response.signed_blocks[index].block_details;
+        if (block.header.block_number != from + index ||
+            meshpp::hash(block.to_string()) != block_hashes[from + index - lowest_block_number])
+            ok = false;
+    }
+
+    if (false == ok)
+    {
+        if (chunks[current.chunk] == chunk_state::requested &&
+            false == is_requested(current.chunk))
+            chunks[current.chunk] = chunk_state::pending;
+
+        dropped.insert(peerid);
+        failed(peerid);
+        return false;
+    }
+
+    auto& peer_stats = stats[peerid];
+    peer_stats.blocks += response.signed_blocks.size();
+    peer_stats.chunks += 1;
+    peer_stats.waited += steady_clock::now() - current.since;
+
+    if (chunks[current.chunk] != chunk_state::requested)
+        ++duplicates;
+    else
+    {
+        chunks[current.chunk] = chunk_state::received;
+        received_chunks[current.chunk] = std::move(response);
+    }
+
+    return true;
+}
+
+void block_download::failed(beltpp::stream::peer_id const& peerid)
+{
+    auto it_requests = requests.find(peerid);
+    if (it_requests == requests.end())
+        return;
+
+    auto peer_requests = std::move(it_requests->second);
+    requests.erase(it_requests);
+
+    for (auto const& item : peer_requests)
+    {
+        if (chunks[item.chunk] == chunk_state::requested &&
+            false == is_requested(item.chunk))
+            chunks[item.chunk] = chunk_state::pending;
+    }
+}
+
+size_t block_download::active_peers() const
+{
+    size_t count = 0;
+    for (auto const& item : requests)
+    {
+        if (false == item.second.empty())
+            ++count;
+    }
+    return count;
+}
+
+bool block_download::take(BlockchainResponse& response)
+{
+    if (next_chunk == chunks.size() ||
+        chunks[next_chunk] != chunk_state::received)
+        return false;
+
+    auto it = received_chunks.find(next_chunk);
+    assert(it != received_chunks.end());
+    response = std::move(it->second);
+    received_chunks.erase(it);
+
+    chunks[next_chunk] = chunk_state::taken;
+    ++next_chunk;
+
+    return true;
+}
+
+size_t block_download::requested(beltpp::stream::peer_id const& peerid) const
+{
+    auto it_requests = requests.find(peerid);
+    if (it_requests == requests.end())
+        return 0;
+    return it_requests->second.size();
+}
+
+string block_download::summary() const
+{
+    string result = std::to_string(next_chunk) + " of " + std::to_string(chunks.size()) + " chunks, " +
+                    std::to_string(duplicates) + " received twice";
+
+    for (auto const& item : stats)
+    {
+        auto waited = chrono::duration_cast<chrono::milliseconds>(item.second.waited).count();
+        result += "; " + detail::peer_short_names(item.first) + ": " +
+                  std::to_string(item.second.blocks) + " blocks, " +
+                  std::to_string(waited / int64_t(item.second.chunks)) + "ms per chunk";
+    }
+
+    return result;
+}
+
+size_t block_download::chunk_length(size_t chunk) const
+{
+    size_t length = BLOCK_TR_LENGTH + 1;
+    return std::min(length, block_hashes.size() - chunk * length);
+}
+
+bool block_download::requested_by(beltpp::stream::peer_id const& peerid, size_t chunk) const
+{
+    auto it_requests = requests.find(peerid);
+    if (it_requests == requests.end())
+        return false;
+
+    for (auto const& item : it_requests->second)
+    {
+        if (item.chunk == chunk)
+            return true;
+    }
+    return false;
+}
+
+bool block_download::is_requested(size_t chunk) const
+{
+    for (auto const& item : requests)
+    {
+        if (requested_by(item.first, chunk))
+            return true;
+    }
+    return false;
+}
+
 // --------------------------- session_action_block ---------------------------
 
-session_action_block::session_action_block(detail::node_internals& impl, reason e_reason)
+session_action_block::session_action_block(detail::node_internals& impl,
+                                           reason e_reason,
+                                           std::shared_ptr<block_download> const& download)
     : session_action<meshpp::nodeid_session_header>()
     , pimpl(&impl)
     , m_reason(e_reason)
+    , m_download(download)
+    , current_peerid()
+    , m_compact(false)
+    , m_compact_response()
+    , m_compact_missing()
+    , m_compact_block(0)
+    , m_compact_checked(0)
+    , m_compact_found(0)
+    , m_compact_fetched(0)
+    , m_compact_full(0)
 {
     assert(false == pimpl->all_sync_info.blockchain_sync_in_progress);
     pimpl->all_sync_info.blockchain_sync_in_progress = true;
+
+    m_download->powner = this;
 }
 
 session_action_block::~session_action_block()
 {
+    m_download->powner = nullptr;
+    if (false == current_peerid.empty())
+        pimpl->writeln_node("block download. " + m_download->summary());
+    if (m_compact_found || m_compact_fetched)
+        pimpl->writeln_node("compact blocks. " + std::to_string(m_compact_found) + " transactions from pool, " +
+                            std::to_string(m_compact_fetched) + " fetched, " +
+                            std::to_string(m_compact_full) + " blocks asked for in full");
+
     pimpl->all_sync_info.blockchain_sync_in_progress = false;
 }
 
@@ -600,12 +844,18 @@ void session_action_block::initiate(meshpp::nodeid_session_header& header)
     //  this assert means that the current session must have session_action_p2pconnections
 
     sync_headers = std::move(pimpl->all_sync_info.headers_actions_data[header.peerid].headers);
-    BlockchainRequest blockchain_request;
-    blockchain_request.blocks_from = sync_headers.back().block_number;
-    blockchain_request.blocks_to = sync_headers.front().block_number;
+    current_peerid = header.peerid;
+
+    //  close to the top the pool is expected to have most of the transactions
+    m_compact = pimpl->m_inventory.speaks(current_peerid) &&
+                m_download->top_block_number() < pimpl->m_blockchain.length() + BLOCK_COMPACT_DEPTH;
 
-    pimpl->m_ptr_p2p_socket->send(header.peerid, beltpp::packet(blockchain_request));
-    expected_next_package_type = BlockchainMessage::BlockchainResponse::rtt;
+    if (m_compact)
+        expected_next_package_type = BlockchainMessage::CompactBlockchainResponse::rtt;
+    else
+        expected_next_package_type = BlockchainMessage::BlockchainResponse::rtt;
+
+    request_more();
 }
 
 bool session_action_block::process(beltpp::packet&& package, meshpp::nodeid_session_header& header)
@@ -622,44 +872,28 @@ bool session_action_block::process(beltpp::packet&& package, meshpp::nodeid_sess
             BlockchainResponse blockchain_response;
             std::move(package).get(blockchain_response);
 
-            bool have_signed_blocks = (false == blockchain_response.signed_blocks.empty());
-            if (have_signed_blocks)
-            {
-                uint64_t temp_from = 0;
-                uint64_t temp_to = 0;
-
-                auto const& front = blockchain_response.signed_blocks.front().block_details;
-                auto const& back = blockchain_response.signed_blocks.back().block_details;
-
-                temp_from = front.header.block_number;
-                temp_to = back.header.block_number;
-
-                string s_code;
-
-                switch (m_reason.v)
-                {
-                case reason::safe_better:
-                    s_code = "[sf]";
-                    break;
-                case reason::safe_revert:
-                    s_code = "[sf,rv]";
-                    break;
-                case reason::unsafe_better:
-                    s_code = "[unsf,btr][" + std::to_string(m_reason.poll_participants) + "][" + std::to_string(m_reason.poll_participants_with_stake) + "]";
-                    break;
-                case reason::unsafe_best:
-                    s_code = "[unsf,bst][" + std::to_string(m_reason.poll_participants) + "][" + std::to_string(m_reason.poll_participants_with_stake) + "]";
-                    break;
-                }
+            if (m_compact)
+                process_compact_full_block(std::move(blockchain_response));
+            else if (m_download->received(header.peerid, std::move(blockchain_response)))
+                pump();
+            else
+                dropped_source("blockchain response. not the requested blocks!");
+            break;
+        }
+        case CompactBlockchainResponse::rtt:
+        {
+            CompactBlockchainResponse compact_response;
+            std::move(package).get(compact_response);
 
-                if(temp_from == temp_to)
-                    pimpl->writeln_node(s_code + "  " + std::to_string(temp_from) + " - " + blockchain::get_miner(blockchain_response.signed_blocks.back()));
-                else
-                    pimpl->writeln_node(s_code + "  [" + std::to_string(temp_from) +
-                                        "," + std::to_string(temp_to) + "]" + " - " + blockchain::get_miner(blockchain_response.signed_blocks.back()));
-            }
+            process_compact_response(std::move(compact_response));
+            break;
+        }
+        case BlockTransactions::rtt:
+        {
+            BlockTransactions block_transactions;
+            std::move(package).get(block_transactions);
 
-            process_response(header, std::move(blockchain_response));
+            process_block_transactions(std::move(block_transactions));
             break;
         }
         default:
@@ -680,24 +914,122 @@ bool session_action_block::permanent() const
     return true;
 }
 
-void session_action_block::process_request(beltpp::stream::peer_id const& peerid,
-                                           BlockchainMessage::BlockchainRequest const& blockchain_request,
-                                           publiqpp::detail::node_internals& impl)
+void session_action_block::pump()
 {
-    // blocks are always requested in regular order
+    BlockchainResponse blockchain_response;
+    while (false == completed &&
+           false == errored &&
+           m_download->take(blockchain_response))
+    {
+        uint64_t temp_from = 0;
+        uint64_t temp_to = 0;
 
+        auto const& front = blockchain_response.signed_blocks.front().block_details;
+        auto const& back = blockchain_response.signed_blocks.back().block_details;
+
+        temp_from = front.header.block_number;
+        temp_to = back.header.block_number;
+
+        string s_code;
+
+        switch (m_reason.v)
+        {
+        case reason::safe_better:
+            s_code = "[sf]";
+            break;
+        case reason::safe_revert:
+            s_code = "[sf,rv]";
+            break;
+        case reason::unsafe_better:
+            s_code = "[unsf,btr][" + std::to_string(m_reason.poll_participants) + "][" + std::to_string(m_reason.poll_participants_with_stake) + "]";
+            break;
+        case reason::unsafe_best:
+            s_code = "[unsf,bst][" + std::to_string(m_reason.poll_participants) + "][" + std::to_string(m_reason.poll_participants_with_stake) + "]";
+            break;
+        }
+
+        if(temp_from == temp_to)
+            pimpl->writeln_node(s_code + "  " + std::to_string(temp_from) + " - " + blockchain::get_miner(blockchain_response.signed_blocks.back()));
+        else
+            pimpl->writeln_node(s_code + "  [" + std::to_string(temp_from) +
+                                "," + std::to_string(temp_to) + "]" + " - " + blockchain::get_miner(blockchain_response.signed_blocks.back()));
+
+        process_response(std::move(blockchain_response));
+    }
+
+    if (false == completed && false == errored)
+        request_more();
+}
+
+void session_action_block::dropped_source(string const& message)
+{
+    pimpl->writeln_node_warning("block download. " + message + " " +
+                                detail::peer_short_names(current_peerid) + " is not asked any more");
+
+    if (0 == m_download->active_peers())
+        set_errored(message, true);
+}
+
+void session_action_block::request_more()
+{
+    if (m_compact)
+    {
+        //  the missing transactions of a chunk are asked for before the next one
+        CompactBlockchainRequest compact_request;
+        if (0 == m_download->requested(current_peerid) &&
+            m_download->assign(current_peerid,
+                               true,
+                               compact_request.blocks_from,
+                               compact_request.blocks_to))
+        {
+            pimpl->m_ptr_p2p_socket->send(current_peerid, beltpp::packet(compact_request));
+            expected_next_package_type = CompactBlockchainResponse::rtt;
+        }
+        return;
+    }
+
+    BlockchainRequest blockchain_request;
+    while (m_download->assign(current_peerid,
+                              true,
+                              blockchain_request.blocks_from,
+                              blockchain_request.blocks_to))
+        pimpl->m_ptr_p2p_socket->send(current_peerid, beltpp::packet(blockchain_request));
+}
+
+namespace detail
+{
+//  blocks are always requested in regular order
+void requested_blocks(uint64_t blocks_from,
+                      uint64_t blocks_to,
+                      publiqpp::detail::node_internals& impl,
+                      uint64_t& from,
+                      uint64_t& to)
+{
     uint64_t number = impl.m_blockchain.length() - 1;
-    uint64_t from = number < blockchain_request.blocks_from ? number : blockchain_request.blocks_from;
+    from = number < blocks_from ? number : blocks_from;
 
-    uint64_t to = blockchain_request.blocks_to;
+    to = blocks_to;
     to = to < from ? from : to;
     to = to > from + BLOCK_TR_LENGTH ? from + BLOCK_TR_LENGTH : to;
     to = to > number ? number : to;
 
+    if (from < impl.m_blockchain.first_block())
+        throw wrong_request_exception("blockchain request. the blocks before the loaded snapshot are not stored");
+}
+}
+
+void session_action_block::process_request(beltpp::stream::peer_id const& peerid,
+                                           BlockchainMessage::BlockchainRequest const& blockchain_request,
+                                           publiqpp::detail::node_internals& impl)
+{
+    uint64_t from = 0;
+    uint64_t to = 0;
+    detail::requested_blocks(blockchain_request.blocks_from, blockchain_request.blocks_to, impl, from, to);
+
     BlockchainResponse chain_response;
     for (auto i = from; i <= to; ++i)
     {
-        SignedBlock const& signed_block = impl.m_blockchain.at(i);
+        SignedBlock signed_block = impl.m_blockchain.at(i);
 
         chain_response.signed_blocks.push_back(std::move(signed_block));
     }
@@ -705,8 +1037,209 @@ void session_action_block::process_request(beltpp::stream::peer_id const& peerid
     impl.m_ptr_p2p_socket->send(peerid, beltpp::packet(chain_response));
 }
 
-void session_action_block::process_response(meshpp::nodeid_session_header& header,
-                                            BlockchainMessage::BlockchainResponse&& blockchain_response)
+void session_action_block::process_compact_request(beltpp::stream::peer_id const& peerid,
+                                                   BlockchainMessage::CompactBlockchainRequest const& compact_request,
+                                                   publiqpp::detail::node_internals& impl)
+{
+    uint64_t from = 0;
+    uint64_t to = 0;
+    detail::requested_blocks(compact_request.blocks_from, compact_request.blocks_to, impl, from, to);
+
+    CompactBlockchainResponse compact_response;
+    for (auto i = from; i <= to; ++i)
+    {
+        SignedBlock signed_block = impl.m_blockchain.at(i);
+
+        CompactBlock compact_block;
+        compact_block.header = signed_block.block_details.header;
+        compact_block.rewards = signed_block.block_details.rewards;
+        compact_block.authorization = signed_block.authorization;
+
+        //  the same recent blocks are asked by every peer
+        string block_hash = impl.m_blockchain.header_ex_at(i).block_hash;
+        auto it_ids = impl.m_compact_transaction_ids.find(block_hash);
+        if (it_ids == impl.m_compact_transaction_ids.end())
+        {
+            if (impl.m_compact_transaction_ids.size() >= 2 * BLOCK_COMPACT_DEPTH)
+                impl.m_compact_transaction_ids.clear();
+
+            vector<string> transaction_ids;
+            for (auto const& signed_transaction : signed_block.block_details.signed_transactions)
+                transaction_ids.push_back(
+                            meshpp::hash(signed_transaction.to_string()).substr(0, BLOCK_COMPACT_ID_LENGTH));
+
+            it_ids = impl.m_compact_transaction_ids.insert(std::make_pair(block_hash, std::move(transaction_ids))).first;
+        }
+        compact_block.transaction_ids = it_ids->second;
+
+        compact_response.compact_blocks.push_back(std::move(compact_block));
+    }
+
+    impl.m_ptr_p2p_socket->send(peerid, beltpp::packet(std::move(compact_response)));
+}
+
+void session_action_block::process_transactions_request(beltpp::stream::peer_id const& peerid,
+                                                        BlockchainMessage::BlockTransactionsRequest const& transactions_request,
+                                                        publiqpp::detail::node_internals& impl)
+{
+    if (transactions_request.block_number >= impl.m_blockchain.length() ||
+        transactions_request.block_number < impl.m_blockchain.first_block())
+        throw wrong_request_exception("block transactions request. no such block");
+
+    SignedBlock signed_block = impl.m_blockchain.at(transactions_request.block_number);
+    auto const& signed_transactions = signed_block.block_details.signed_transactions;
+
+    BlockTransactions block_transactions;
+    block_transactions.block_number = transactions_request.block_number;
+
+    for (auto index : transactions_request.indexes)
+    {
+        if (index >= signed_transactions.size())
+            throw wrong_request_exception("block transactions request. no such transaction");
+
+        block_transactions.signed_transactions.push_back(signed_transactions[index]);
+    }
+
+    impl.m_ptr_p2p_socket->send(peerid, beltpp::packet(std::move(block_transactions)));
+}
+
+void session_action_block::process_compact_response(BlockchainMessage::CompactBlockchainResponse&& compact_response)
+{
+    if (compact_response.compact_blocks.empty())
+        return set_errored("compact blockchain response. empty response received!", true);
+
+    m_compact_response.signed_blocks.clear();
+    m_compact_missing.clear();
+    m_compact_block = 0;
+    m_compact_checked = 0;
+
+    for (auto& compact_block : compact_response.compact_blocks)
+    {
+        SignedBlock signed_block;
+        signed_block.authorization = std::move(compact_block.authorization);
+        signed_block.block_details.header = std::move(compact_block.header);
+        signed_block.block_details.rewards = std::move(compact_block.rewards);
+
+        vector<uint64_t> missing;
+        auto& signed_transactions = signed_block.block_details.signed_transactions;
+
+        for (auto const& transaction_id : compact_block.transaction_ids)
+        {
+            if (transaction_id.size() != BLOCK_COMPACT_ID_LENGTH)
+                return set_errored("compact blockchain response. wrong transaction id!", true);
+
+            auto ptransaction = pimpl->m_transaction_pool.find_prefix(transaction_id);
+            if (ptransaction)
+            {
+                signed_transactions.push_back(*ptransaction);
+                ++m_compact_found;
+            }
+            else
+            {
+                missing.push_back(signed_transactions.size());
+                signed_transactions.push_back(SignedTransaction());
+            }
+        }
+
+        m_compact_response.signed_blocks.push_back(std::move(signed_block));
+        m_compact_missing.push_back(std::move(missing));
+    }
+
+    request_missing();
+}
+
+void session_action_block::process_block_transactions(BlockchainMessage::BlockTransactions&& block_transactions)
+{
+    if (m_compact_block >= m_compact_missing.size())
+        return set_errored("block transactions. not requested!", true);
+
+    auto& signed_block = m_compact_response.signed_blocks[m_compact_block];
+    auto& missing = m_compact_missing[m_compact_block];
+
+    if (block_transactions.block_number != signed_block.block_details.header.block_number ||
+        block_transactions.signed_transactions.size() != missing.size())
+        return set_errored("block transactions. not the requested transactions!", true);
+
+    for (size_t index = 0; index != missing.size(); ++index)
+        signed_block.block_details.signed_transactions[missing[index]] =
+                std::move(block_transactions.signed_transactions[index]);
+
+    m_compact_fetched += missing.size();
+    missing.clear();
+
+    request_missing();
+}
+
+void session_action_block::request_missing()
+{
+    while (m_compact_block < m_compact_missing.size() &&
+           m_compact_missing[m_compact_block].empty())
+        ++m_compact_block;
+
+    if (m_compact_block < m_compact_missing.size())
+    {
+        BlockTransactionsRequest transactions_request;
+        transactions_request.block_number =
+                m_compact_response.signed_blocks[m_compact_block].block_details.header.block_number;
+        transactions_request.indexes = m_compact_missing[m_compact_block];
+
+        pimpl->m_ptr_p2p_socket->send(current_peerid, beltpp::packet(std::move(transactions_request)));
+        expected_next_package_type = BlockTransactions::rtt;
+        return;
+    }
+
+    //  a transaction id may match another transaction in the pool,
+    //  the peer is not to blame for that, so the block is asked for in full
+    for (; m_compact_checked != m_compact_response.signed_blocks.size(); ++m_compact_checked)
+    {
+        auto const& block = m_compact_response.signed_blocks[m_compact_checked].block_details;
+        if (meshpp::hash(block.to_string()) != m_download->block_hash(block.header.block_number))
+        {
+            BlockchainRequest blockchain_request;
+            blockchain_request.blocks_from = block.header.block_number;
+            blockchain_request.blocks_to = block.header.block_number;
+
+            pimpl->m_ptr_p2p_socket->send(current_peerid, beltpp::packet(std::move(blockchain_request)));
+            expected_next_package_type = BlockchainResponse::rtt;
+            return;
+        }
+    }
+
+    //  the chunk is complete, the block hashes are checked once more when received
+    BlockchainResponse blockchain_response = std::move(m_compact_response);
+    m_compact_response.signed_blocks.clear();
+    m_compact_missing.clear();
+    m_compact_block = 0;
+    m_compact_checked = 0;
+
+    expected_next_package_type = CompactBlockchainResponse::rtt;
+
+    if (m_download->received(current_peerid, std::move(blockchain_response)))
+        pump();
+    else
+        dropped_source("compact blockchain response. not the requested blocks!");
+}
+
+void session_action_block::process_compact_full_block(BlockchainMessage::BlockchainResponse&& blockchain_response)
+{
+    if (m_compact_checked >= m_compact_response.signed_blocks.size() ||
+        blockchain_response.signed_blocks.size() != 1)
+        return set_errored("blockchain response. not the requested block!", true);
+
+    auto& signed_block = m_compact_response.signed_blocks[m_compact_checked];
+    if (blockchain_response.signed_blocks.front().block_details.header.block_number !=
+        signed_block.block_details.header.block_number)
+        return set_errored("blockchain response. not the requested block!", true);
+
+    //  if this one does not match either the chunk is refused when received
+    signed_block = std::move(blockchain_response.signed_blocks.front());
+    ++m_compact_checked;
+    ++m_compact_full;
+
+    request_missing();
+}
+
+void session_action_block::process_response(BlockchainMessage::BlockchainResponse&& blockchain_response)
 {
     bool throw_for_debugging_only = true;
 
@@ -738,8 +1271,8 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
         else
             prev_block_hash = pimpl->m_blockchain.header_at(block_number).prev_hash;
     }
-    else
-        prev_block_hash = meshpp::hash(sync_blocks.back().block_details.to_string());
+    else   //  the hash of this block was checked against its header when received
+        prev_block_hash = (sync_headers.rbegin() + sync_blocks.size() - 1)->block_hash;
 
     assert(sync_blocks.size() < sync_headers.size());
     auto header_it = sync_headers.rbegin() + sync_blocks.size();
@@ -747,18 +1280,23 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
     if (header_it->prev_hash != prev_block_hash)
         return set_errored("blockchain response. previous hash!", throw_for_debugging_only);
 
-    for (auto& block_item : blockchain_response.signed_blocks)
+    auto tp_checks = steady_clock::now();
+
+    //  stateless checks first, the signatures are collected
+    //  to be verified together on the verifier threads
+    vector<signature_verifier::item> signatures;
+    //  for each signature the block and the transaction in it, or -1 for the block itself
+    vector<std::pair<size_t, size_t>> signature_sources;
+
+    for (size_t block_index = 0; block_index != blockchain_response.signed_blocks.size(); ++block_index)
     {
-        Block& block = block_item.block_details;
+        auto const& block_item = blockchain_response.signed_blocks[block_index];
+        Block const& block = block_item.block_details;
         string block_to_string = block.to_string();
 
         if(block.signed_transactions.size() > BLOCK_MAX_TRANSACTIONS)
             return set_errored("blockchain response. block max transactions count!", throw_for_debugging_only);
 
-        // verify block signature
-        if (!meshpp::verify_signature(meshpp::public_key(block_item.authorization.address), block_to_string, block_item.authorization.signature))
-            return set_errored("blockchain response. block signature!", throw_for_debugging_only);
-
         BlockHeaderExtended& temp_header_ex = *header_it;
         BlockHeader temp_header;
         temp_header = temp_header_ex;
@@ -767,41 +1305,77 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
 
         ++header_it;
 
-        // verify block transactions
-        for (auto tr_it = block.signed_transactions.begin(); tr_it != block.signed_transactions.end(); ++tr_it)
+        // block signature
+        signature_verifier::item block_signature;
+        block_signature.public_key = block_item.authorization.address;
+        block_signature.message = std::move(block_to_string);
+        block_signature.signature = block_item.authorization.signature;
+        signatures.push_back(std::move(block_signature));
+        signature_sources.push_back(std::make_pair(block_index, size_t(-1)));
+
+        // block transactions
+        for (size_t tr_index = 0; tr_index != block.signed_transactions.size(); ++tr_index)
         {
-            signed_transaction_validate(*tr_it,
+            auto const& signed_transaction = block.signed_transactions[tr_index];
+
+            signed_transaction_validate(signed_transaction,
                                         system_clock::from_time_t(block.header.time_signed.tm),
                                         std::chrono::seconds(0),
-                                        *pimpl);
+                                        *pimpl,
+                                        signatures);
+            signature_sources.resize(signatures.size(), std::make_pair(block_index, tr_index));
 
-            action_validate(*pimpl, *tr_it, true);
+            action_validate(*pimpl, signed_transaction, true);
         }
-
-        // store blocks for future use
-        sync_blocks.push_back(std::move(block_item));
     }
 
-    // request new chain if needed
-    if (sync_blocks.size() < BLOCK_INSERT_LENGTH &&
-        sync_blocks.size() < sync_headers.size())
-    {
-        BlockchainRequest blockchain_request;
-        blockchain_request.blocks_from = header_it->block_number;
-        blockchain_request.blocks_to = sync_headers.begin()->block_number;
+    auto tp_signatures = steady_clock::now();
 
-        pimpl->m_ptr_p2p_socket->send(header.peerid, beltpp::packet(blockchain_request));
+    size_t failed = pimpl->m_signature_verifier.verify(signatures);
+    if (failed != signatures.size())
+    {
+        auto const& source = signature_sources[failed];
+        if (source.second == size_t(-1))
+            return set_errored("blockchain response. block signature!", throw_for_debugging_only);
 
-        return; // will wait for new chain
+        //  checked once more alone, to fail the way it always did
+        auto const& block = blockchain_response.signed_blocks[source.first].block_details;
+        signed_transaction_validate(block.signed_transactions[source.second],
+                                    system_clock::from_time_t(block.header.time_signed.tm),
+                                    std::chrono::seconds(0),
+                                    *pimpl);
+        return set_errored("blockchain response. transaction signature!", throw_for_debugging_only);
     }
 
+    auto tp_done = steady_clock::now();
+
+    pimpl->writeln_node("blockchain response. " +
+                        std::to_string(blockchain_response.signed_blocks.size()) + " blocks, " +
+                        std::to_string(signatures.size()) + " signatures, checks " +
+                        std::to_string(chrono::duration_cast<chrono::milliseconds>(tp_signatures - tp_checks).count()) + "ms, signatures " +
+                        std::to_string(chrono::duration_cast<chrono::milliseconds>(tp_done - tp_signatures).count()) + "ms on " +
+                        std::to_string(pimpl->m_signature_verifier.thread_count()) + " threads");
+
+    // store blocks for future use
+    for (auto& block_item : blockchain_response.signed_blocks)
+        sync_blocks.push_back(std::move(block_item));
+
+    // wait for more blocks if needed
+    if (sync_blocks.size() < BLOCK_INSERT_LENGTH &&
+        sync_blocks.size() < sync_headers.size())
+        return;
+
     size_t blockchain_length = pimpl->m_blockchain.length();
     uint64_t lcb_number = sync_headers.rbegin()->block_number - 1;
 
+    //  only the headers are kept for the blocks before the loaded snapshot
+    if (lcb_number + 1 < pimpl->m_blockchain.first_block())
+        return set_errored("block response. cannot revert the blocks before the loaded snapshot", throw_for_debugging_only);
+
     // resolve normal fork case
     if (sync_blocks.size() == 1 && lcb_number == blockchain_length - 2)
     {
-        auto& inserted_block = pimpl->m_blockchain.at(blockchain_length - 1);
+        SignedBlock inserted_block = pimpl->m_blockchain.at(blockchain_length - 1);
         string inserted_block_miner = blockchain::get_miner(inserted_block);
         string received_block_miner = blockchain::get_miner(sync_blocks.back());
         coin inserted_block_miner_balance = pimpl->m_state.get_balance(inserted_block_miner, state_layer::pool);
@@ -820,6 +1394,7 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
     }
     
     //3. all needed blocks received, start to check
+    auto tp_apply = steady_clock::now();
     pimpl->m_transaction_cache.backup();
 
     auto now = system_clock::now();
@@ -838,7 +1413,7 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
 
     for (size_t index = lcb_number + 1; index < blockchain_length; ++index)
     {
-        SignedBlock const& signed_block = pimpl->m_blockchain.at(index);
+        SignedBlock signed_block = pimpl->m_blockchain.at(index);
 
         reverted_transactions.insert(reverted_transactions.end(),
                                      signed_block.block_details.signed_transactions.begin(),
@@ -855,7 +1430,9 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
          index < blockchain_length && index > lcb_number;
          --index)
     {
-        SignedBlock const& signed_block = pimpl->m_blockchain.at(index);
+        SignedBlock signed_block = pimpl->m_blockchain.at(index);
+        //  blocks applied with undo records are reverted from them
+        bool undone = pimpl->undo_block(index);
         pimpl->m_blockchain.remove_last_block();
         pimpl->m_action_log.revert();
 
@@ -864,29 +1441,33 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
         string signed_block_miner_authority = signed_block.authorization.address;
         string signed_block_miner_address = blockchain::get_miner(signed_block);
 
-        map<string, map<string, uint64_t>> unit_uri_view_counts;
-        map<string, coin> unit_sponsor_applied;
-
-        // verify block rewards before reverting, this also reclaims advertisement coins
-        if (check_rewards(block,
-                          signed_block_miner_address,
-                          rewards_type::revert,
-                          *pimpl,
-                          unit_uri_view_counts,
-                          unit_sponsor_applied))
-            return set_errored("block response - " + std::to_string(block.header.block_number) + ". block rewards reverting error!", throw_for_debugging_only);
-
-        B_UNUSED(unit_uri_view_counts);
-        B_UNUSED(unit_sponsor_applied);
-
-        // decrease all reward amounts from balances and revert reward
-        for (auto it = block.rewards.crbegin(); it != block.rewards.crend(); ++it)
-            pimpl->m_state.decrease_balance(it->to, it->amount, state_layer::chain);
+        if (false == undone)
+        {
+            map<string, map<string, uint64_t>> unit_uri_view_counts;
+            map<string, coin> unit_sponsor_applied;
+
+            // verify block rewards before reverting, this also reclaims advertisement coins
+            if (check_rewards(block,
+                              signed_block_miner_address,
+                              rewards_type::revert,
+                              *pimpl,
+                              unit_uri_view_counts,
+                              unit_sponsor_applied))
+                return set_errored("block response - " + std::to_string(block.header.block_number) + ". block rewards reverting error!", throw_for_debugging_only);
+
+            B_UNUSED(unit_uri_view_counts);
+            B_UNUSED(unit_sponsor_applied);
+
+            // decrease all reward amounts from balances and revert reward
+            for (auto it = block.rewards.crbegin(); it != block.rewards.crend(); ++it)
+                pimpl->m_state.decrease_balance(it->to, it->amount, state_layer::chain);
+        }
 
         // calculate back transactions
         for (auto it = block.signed_transactions.crbegin(); it != block.signed_transactions.crend(); ++it)
         {
-            revert_transaction(*it, *pimpl, signed_block_miner_address);
+            if (false == undone)
+                revert_transaction(*it, *pimpl, signed_block_miner_address);
             pimpl->m_transaction_cache.erase_chain(*it);
         }
 
@@ -898,11 +1479,12 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
 
         uint64_t block_count_per_transaction_lifetime = TRANSACTION_MAX_LIFETIME_HOURS * 3600 / BLOCK_MINE_DELAY; // =144
 
-        if (index >= block_count_per_transaction_lifetime)
+        if (index >= block_count_per_transaction_lifetime &&
+            index - block_count_per_transaction_lifetime >= pimpl->m_blockchain.first_block())
         {
-            Block const& block_to_cache = pimpl->m_blockchain.at(index - block_count_per_transaction_lifetime).block_details;
-            
-            for (auto const& old_tr : block_to_cache.signed_transactions)
+            SignedBlock block_to_cache = pimpl->m_blockchain.at(index - block_count_per_transaction_lifetime);
+
+            for (auto const& old_tr : block_to_cache.block_details.signed_transactions)
                 pimpl->m_transaction_cache.add_chain(old_tr);
         }
     }
@@ -910,7 +1492,7 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
     blockchain_length = pimpl->m_blockchain.length();
 
     // verify new received blocks
-    BlockHeader const& prev_header = pimpl->m_blockchain.header_at(lcb_number);
+    BlockHeader prev_header = pimpl->m_blockchain.header_at(lcb_number);
     uint64_t c_const = prev_header.c_const;
 
     // reject blocks which not relevant statistics
@@ -921,9 +1503,13 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
                                  *pimpl))
         return set_errored("blockchain response. block service statistics!", throw_for_debugging_only);
 
+    auto sync_header_it = sync_headers.rbegin();
     for (auto const& signed_block : sync_blocks)
     {
         Block const& block = signed_block.block_details;
+        string const& block_hash = (sync_header_it++)->block_hash;
+
+        pimpl->m_block_undo.begin();
 
         // verify consensus_delta
         string signed_block_miner = blockchain::get_miner(signed_block);
@@ -946,11 +1532,15 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
             miner_node_type != NodeType::blockchain)
             return set_errored("blockchain response. node type!", throw_for_debugging_only);
 
+        //  the transactions are serialized and hashed once for the cache and the action log
+        memoized_block block_memo(signed_block, block_hash);
+
         // verify block transactions
         time_t prev_transaction_time = 0;
-        for (auto const& tr_item : block.signed_transactions)
+        for (size_t tr_index = 0; tr_index != block.signed_transactions.size(); ++tr_index)
         {
-            if (false == pimpl->m_transaction_cache.add_chain(tr_item))
+            auto const& tr_item = block.signed_transactions[tr_index];
+            if (false == pimpl->m_transaction_cache.add_chain(block_memo.transaction(tr_index)))
                 return set_errored("blockchain response. transaction double use!", throw_for_debugging_only);
 
             if (!apply_transaction(tr_item, *pimpl, signed_block_miner))
@@ -978,8 +1568,11 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
             pimpl->m_state.increase_balance(reward_item.to, reward_item.amount, state_layer::chain);
 
         // Insert to blockchain
-        pimpl->m_blockchain.insert(signed_block);
-        pimpl->m_action_log.log_block(signed_block, unit_uri_view_counts, applied_sponsor_items);
+        pimpl->m_blockchain.insert(signed_block, block_hash, pimpl->m_block_undo.end());
+        pimpl->m_action_log.log_block(block_memo,
+                                      unit_uri_view_counts,
+                                      applied_sponsor_items);
+        pimpl->prepare_snapshot();
 
         c_const = block.header.c_const;
     }
@@ -1004,9 +1597,11 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
             action_is_complete(*pimpl, signed_transaction))
             complete = true;
 
+        memoized_transaction transaction_memo(signed_transaction);
+
         if (now - chrono::seconds(NODES_TIME_SHIFT) <=
             system_clock::from_time_t(signed_transaction.transaction_details.expiry.tm) &&
-            false == pimpl->m_transaction_cache.contains(signed_transaction))
+            false == pimpl->m_transaction_cache.contains(transaction_memo))
         {
             bool ok_logic = true;
             if (complete ||
@@ -1017,13 +1612,13 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
             {
                 ok_logic = apply_transaction(signed_transaction, *pimpl);
                 if (ok_logic)
-                    pimpl->m_action_log.log_transaction(signed_transaction);
+                    pimpl->m_action_log.log_transaction(transaction_memo);
             }
 
             if (ok_logic)
             {
-                pimpl->m_transaction_pool.push_back(signed_transaction);
-                pimpl->m_transaction_cache.add_pool(signed_transaction, complete);
+                pimpl->m_transaction_pool.push_back(transaction_memo);
+                pimpl->m_transaction_cache.add_pool(transaction_memo, complete);
             }
         }
     }
@@ -1032,19 +1627,16 @@ void session_action_block::process_response(meshpp::nodeid_session_header& heade
     pimpl->save(guard);
     pimpl->m_storage_controller.commit();
 
-    // request new chain if the process was stopped
+    pimpl->writeln_node("blockchain response. " + std::to_string(sync_blocks.size()) + " blocks applied in " +
+                        std::to_string(chrono::duration_cast<chrono::milliseconds>(steady_clock::now() - tp_apply).count()) + "ms");
+
+    // continue with the rest of the blocks if the process was stopped
     // by BLOCK_INSERT_LENGTH restriction
     if (sync_blocks.size() < sync_headers.size())
     {
         // clear already inserted blocks and headers
         sync_headers.resize(sync_headers.size() - sync_blocks.size());
         sync_blocks.clear();
-
-        BlockchainRequest blockchain_request;
-        blockchain_request.blocks_from = sync_headers.back().block_number;
-        blockchain_request.blocks_to = sync_headers.front().block_number;
-
-        pimpl->m_ptr_p2p_socket->send(header.peerid, beltpp::packet(blockchain_request));
     }
     else
     {
@@ -1065,6 +1657,119 @@ void session_action_block::set_errored(string const& message, bool throw_for_deb
     errored = true;
 }
 
+// --------------------------- session_action_block_part ---------------------------
+
+session_action_block_part::session_action_block_part(detail::node_internals& impl,
+                                                     std::shared_ptr<block_download> const& download)
+    : session_action<meshpp::nodeid_session_header>()
+    , pimpl(&impl)
+    , m_download(download)
+    , current_peerid()
+{}
+
+session_action_block_part::~session_action_block_part()
+{
+    if (false == current_peerid.empty())
+        m_download->failed(current_peerid);
+}
+
+void session_action_block_part::initiate(meshpp::nodeid_session_header& header)
+{
+    assert(false == header.peerid.empty());
+    //  this assert means that the current session must have session_action_p2pconnections
+
+    current_peerid = header.peerid;
+
+    if (request_next())
+        expected_next_package_type = BlockchainMessage::BlockchainResponse::rtt;
+    else
+    {
+        completed = true;
+        expected_next_package_type = size_t(-1);
+    }
+}
+
+bool session_action_block_part::process(beltpp::packet&& package, meshpp::nodeid_session_header& header)
+{
+    bool code = true;
+
+    if (expected_next_package_type == package.type() &&
+        expected_next_package_type != size_t(-1))
+    {
+        switch (package.type())
+        {
+        case BlockchainResponse::rtt:
+        {
+            BlockchainResponse blockchain_response;
+            std::move(package).get(blockchain_response);
+
+            if (false == m_download->received(header.peerid, std::move(blockchain_response)))
+            {
+                pimpl->writeln_node_warning("block download. unexpected blocks from " +
+                                            detail::peer_short_names(header.peerid));
+                errored = true;
+                break;
+            }
+
+            session_action_block* powner = m_download->powner;
+            if (powner)
+            {
+                try
+                {
+                    powner->pump();
+                }
+                catch (wrong_data_exception const& ex)
+                {
+                    //  the blocks matched the headers, so it is the chain of the main peer
+                    //  that did not pass the checks, not something of this one
+                    pimpl->writeln_node_warning("block download. " + string(ex.what()));
+                    powner->errored = true;
+                }
+            }
+
+            if (nullptr == powner ||
+                powner->completed ||
+                powner->errored ||
+                false == request_next())
+            {
+                completed = true;
+                expected_next_package_type = size_t(-1);
+            }
+            break;
+        }
+        default:
+            assert(false);
+            break;
+        }
+    }
+    else
+    {
+        code = false;
+    }
+
+    return code;
+}
+
+bool session_action_block_part::permanent() const
+{
+    return true;
+}
+
+bool session_action_block_part::request_next()
+{
+    if (nullptr == m_download->powner)
+        return false;
+
+    BlockchainRequest blockchain_request;
+    while (m_download->assign(current_peerid,
+                              false,
+                              blockchain_request.blocks_from,
+                              blockchain_request.blocks_to))
+        pimpl->m_ptr_p2p_socket->send(current_peerid, beltpp::packet(blockchain_request));
+
+    return 0 != m_download->requested(current_peerid);
+}
+
 // --------------------------- session_action_request_file ---------------------------
 
 session_action_request_file::session_action_request_file(string const& _file_uri,
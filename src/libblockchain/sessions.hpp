@@ -10,6 +10,11 @@
 #include <string>
 #include <functional>
 #include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <deque>
+#include <memory>
+#include <chrono>
 
 namespace publiqpp
 {
@@ -134,6 +139,80 @@ protected:
     void _initiate(meshpp::nodeid_session_header& header, bool first);
 };
 
+class session_action_block;
+
+//  bodies of the blocks of known headers, fetched in chunks from several peers
+//  at most BLOCK_DOWNLOAD_WINDOW chunks starting with the one to be processed next
+//  are requested at a time, the received chunks are handed out in order
+class block_download
+{
+public:
+    //  headers as session_action_header collects them, the highest first
+    block_download(std::vector<BlockchainMessage::BlockHeaderExtended> const& headers);
+
+    uint64_t top_block_number() const;
+    std::string const& block_hash(uint64_t block_number) const;
+
+    //  gives a chunk to request from the peer, if the peer can take more
+    //  head_of_line lets the peer request the next chunk to be processed
+    //  even if it is requested from another peer already
+    bool assign(beltpp::stream::peer_id const& peerid,
+                bool head_of_line,
+                uint64_t& from,
+                uint64_t& to);
+    //  false if the response is not the chunk the peer was asked for first
+    //  or if the blocks do not hash to the headers, then the peer is dropped,
+    //  its chunks are given to others and it is not assigned any more
+    bool received(beltpp::stream::peer_id const& peerid,
+                  BlockchainMessage::BlockchainResponse&& response);
+    //  the chunks requested from the peer are given to others
+    void failed(beltpp::stream::peer_id const& peerid);
+    //  count of the peers with requests waiting for response
+    size_t active_peers() const;
+    bool take(BlockchainMessage::BlockchainResponse& response);
+    //  count of the requests waiting for response from the peer
+    size_t requested(beltpp::stream::peer_id const& peerid) const;
+
+    std::string summary() const;
+
+    session_action_block* powner;
+private:
+    enum class chunk_state {pending, requested, received, taken};
+    class request
+    {
+    public:
+        size_t chunk;
+        std::chrono::steady_clock::time_point since;
+    };
+    class peer_stats
+    {
+    public:
+        peer_stats()
+            : blocks(0)
+            , chunks(0)
+            , waited(std::chrono::steady_clock::duration::zero())
+        {}
+
+        uint64_t blocks;
+        uint64_t chunks;
+        std::chrono::steady_clock::duration waited;
+    };
+
+    size_t chunk_length(size_t chunk) const;
+    bool requested_by(beltpp::stream::peer_id const& peerid, size_t chunk) const;
+    bool is_requested(size_t chunk) const;
+
+    uint64_t lowest_block_number;
+    std::vector<std::string> block_hashes;
+    std::vector<chunk_state> chunks;
+    size_t next_chunk;
+    uint64_t duplicates;
+    std::map<size_t, BlockchainMessage::BlockchainResponse> received_chunks;
+    std::unordered_map<beltpp::stream::peer_id, std::deque<request>> requests;
+    std::unordered_map<beltpp::stream::peer_id, peer_stats> stats;
+    std::unordered_set<beltpp::stream::peer_id> dropped;
+};
+
 class session_action_block : public meshpp::session_action<meshpp::nodeid_session_header>
 {
 public:
@@ -146,7 +225,9 @@ public:
         double revert_coefficient = 0;
         e_v v = safe_better;
     };
-    session_action_block(detail::node_internals& impl, reason e_reason);
+    session_action_block(detail::node_internals& impl,
+                         reason e_reason,
+                         std::shared_ptr<block_download> const& download);
     ~session_action_block() override;
 
     void initiate(meshpp::nodeid_session_header& header) override;
@@ -157,9 +238,29 @@ public:
     void process_request(beltpp::stream::peer_id const& peerid,
                          BlockchainMessage::BlockchainRequest const& blockchain_request,
                          publiqpp::detail::node_internals& impl);
-
-    void process_response(meshpp::nodeid_session_header& header,
-                          BlockchainMessage::BlockchainResponse&& blockchain_response);
+    static
+    void process_compact_request(beltpp::stream::peer_id const& peerid,
+                                 BlockchainMessage::CompactBlockchainRequest const& compact_request,
+                                 publiqpp::detail::node_internals& impl);
+    static
+    void process_transactions_request(beltpp::stream::peer_id const& peerid,
+                                      BlockchainMessage::BlockTransactionsRequest const& transactions_request,
+                                      publiqpp::detail::node_internals& impl);
+
+    //  processes the chunks received so far in order and requests more
+    void pump();
+    void request_more();
+    //  the helpers fetch the chunks of the main peer once its blocks
+    //  do not match the headers, the sync fails if there are none
+    void dropped_source(std::string const& message);
+    void process_response(BlockchainMessage::BlockchainResponse&& blockchain_response);
+
+    //  fills the compact blocks from the pool, then asks for what is missing block by block
+    void process_compact_response(BlockchainMessage::CompactBlockchainResponse&& compact_response);
+    void process_block_transactions(BlockchainMessage::BlockTransactions&& block_transactions);
+    //  a block that does not hash to its header is asked for in full
+    void process_compact_full_block(BlockchainMessage::BlockchainResponse&& blockchain_response);
+    void request_missing();
 
     void set_errored(std::string const& message, bool throw_for_debugging_only);
 
@@ -167,6 +268,39 @@ public:
     std::vector<BlockchainMessage::SignedBlock> sync_blocks;
     std::vector<BlockchainMessage::BlockHeaderExtended> sync_headers;
     reason m_reason;
+    std::shared_ptr<block_download> m_download;
+    beltpp::stream::peer_id current_peerid;
+
+    //  the main peer is asked for compact blocks, one chunk at a time
+    bool m_compact;
+    BlockchainMessage::BlockchainResponse m_compact_response;
+    //  indexes of the transactions still missing, per block of the chunk
+    std::vector<std::vector<uint64_t>> m_compact_missing;
+    size_t m_compact_block;
+    //  the blocks of the chunk before this one hash to their headers
+    size_t m_compact_checked;
+    uint64_t m_compact_found;
+    uint64_t m_compact_fetched;
+    uint64_t m_compact_full;
+};
+
+//  fetches chunks of a block_download from one more peer
+class session_action_block_part : public meshpp::session_action<meshpp::nodeid_session_header>
+{
+public:
+    session_action_block_part(detail::node_internals& impl,
+                              std::shared_ptr<block_download> const& download);
+    ~session_action_block_part() override;
+
+    void initiate(meshpp::nodeid_session_header& header) override;
+    bool process(beltpp::packet&& package, meshpp::nodeid_session_header& header) override;
+    bool permanent() const override;
+
+    bool request_next();
+
+    detail::node_internals* pimpl;
+    std::shared_ptr<block_download> m_download;
+    beltpp::stream::peer_id current_peerid;
 };
 
 class session_action_request_file : public meshpp::session_action<meshpp::nodeid_session_header>
@@ -0,0 +1,284 @@
+#include "signature_verifier.hpp"
+#include "common.hpp"
+
+#include <mesh.pp/cryptoutility.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+using std::string;
+using std::vector;
+using std::mutex;
+using std::unique_lock;
+
+namespace publiqpp
+{
+namespace detail
+{
+//  a batch outlives verify() while late workers still hold it, but the
+//  items do not, so they are touched only after an index is claimed
+class signature_batch
+{
+public:
+    signature_batch(vector<signature_verifier::item> const& _items)
+        : items(&_items)
+        , size(_items.size())
+        , next(0)
+        , done(0)
+        , failed(_items.size())
+    {}
+
+    vector<signature_verifier::item> const* items;
+    size_t const size;
+    std::atomic<size_t> next;
+    std::atomic<size_t> done;
+    std::atomic<size_t> failed;
+};
+
+//  bounded, least recently used are dropped first
+class signature_cache
+{
+public:
+    signature_cache()
+        : hits(0)
+        , misses(0)
+    {}
+
+    static string key(string const& public_key,
+                      string const& message,
+                      string const& signature)
+    {
+        return public_key + "\n" + meshpp::hash(message) + "\n" + signature;
+    }
+
+    bool contains(string const& key)
+    {
+        unique_lock<mutex> lock(m_mutex);
+
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            ++misses;
+            return false;
+        }
+
+        ++hits;
+        order.splice(order.begin(), order, it->second);
+        return true;
+    }
+
+    void insert(string const& key)
+    {
+        unique_lock<mutex> lock(m_mutex);
+
+        if (index.count(key))
+            return;
+
+        order.push_front(key);
+        index[key] = order.begin();
+
+        if (order.size() > SIGNATURE_CACHE_SIZE)
+        {
+            index.erase(order.back());
+            order.pop_back();
+        }
+    }
+
+    mutable mutex m_mutex;
+    std::list<string> order;
+    std::unordered_map<string, std::list<string>::iterator> index;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+};
+
+bool verify_item(signature_verifier::item const& item)
+{
+    try
+    {
+        return meshpp::verify_signature(meshpp::public_key(item.public_key),
+                                        item.message,
+                                        item.signature);
+    }
+    catch (...)
+    {
+        //  wrong public key format
+    }
+    return false;
+}
+
+class signature_verifier_internals
+{
+public:
+    signature_verifier_internals(size_t thread_count)
+        : stop(false)
+    {
+        if (0 == thread_count)
+            thread_count = std::thread::hardware_concurrency();
+        if (0 == thread_count)
+            thread_count = 1;
+
+        //  the calling thread is one of them
+        for (size_t index = 1; index < thread_count; ++index)
+            workers.push_back(std::thread([this]{ worker(); }));
+    }
+
+    ~signature_verifier_internals()
+    {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            stop = true;
+        }
+        cv_work.notify_all();
+
+        for (auto& item : workers)
+            item.join();
+    }
+
+    void work(signature_batch& batch)
+    {
+        size_t const size = batch.size;
+
+        while (true)
+        {
+            size_t index = batch.next++;
+            if (index >= size)
+                break;
+
+            //  the items after a failed one are only counted, those before
+            //  are still checked, so the lowest failing index is reported
+            if (index < batch.failed.load())
+            {
+                auto const& item = (*batch.items)[index];
+                string key = signature_cache::key(item.public_key, item.message, item.signature);
+
+                if (false == cache.contains(key))
+                {
+                    if (verify_item(item))
+                        cache.insert(key);
+                    else
+                    {
+                        size_t expected = batch.failed.load();
+                        while (index < expected &&
+                               false == batch.failed.compare_exchange_weak(expected, index))
+                        {}
+                    }
+                }
+            }
+
+            if (++batch.done == size)
+            {
+                unique_lock<mutex> lock(m_mutex);
+                cv_done.notify_all();
+            }
+        }
+    }
+
+    void worker()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        std::shared_ptr<signature_batch> last_batch;
+
+        while (true)
+        {
+            cv_work.wait(lock, [this, &last_batch]
+            {
+                return stop || (batch && batch != last_batch);
+            });
+
+            if (stop)
+                break;
+
+            last_batch = batch;
+            auto current = batch;
+            lock.unlock();
+
+            work(*current);
+
+            lock.lock();
+        }
+    }
+
+    signature_cache cache;
+    mutex m_mutex;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+    std::shared_ptr<signature_batch> batch;
+    vector<std::thread> workers;
+    bool stop;
+};
+}
+
+signature_verifier::signature_verifier(size_t thread_count)
+    : m_pimpl(new detail::signature_verifier_internals(thread_count))
+{
+}
+
+signature_verifier::~signature_verifier() = default;
+
+size_t signature_verifier::thread_count() const
+{
+    return m_pimpl->workers.size() + 1;
+}
+
+size_t signature_verifier::verify(vector<item> const& items)
+{
+    auto batch = std::make_shared<detail::signature_batch>(items);
+
+    if (m_pimpl->workers.empty() || items.size() < 2)
+    {
+        m_pimpl->work(*batch);
+        return batch->failed;
+    }
+
+    {
+        unique_lock<mutex> lock(m_pimpl->m_mutex);
+        m_pimpl->batch = batch;
+    }
+    m_pimpl->cv_work.notify_all();
+
+    m_pimpl->work(*batch);
+
+    unique_lock<mutex> lock(m_pimpl->m_mutex);
+    m_pimpl->cv_done.wait(lock, [&batch]
+    {
+        return batch->done == batch->size;
+    });
+    m_pimpl->batch.reset();
+
+    return batch->failed;
+}
+
+void signature_verifier::check(string const& public_key,
+                               string const& message,
+                               string const& signature)
+{
+    string key = detail::signature_cache::key(public_key, message, signature);
+    if (m_pimpl->cache.contains(key))
+        return;
+
+    meshpp::public_key pb_key(public_key);
+    meshpp::signature signature_check(pb_key, message, signature);
+
+    m_pimpl->cache.insert(key);
+}
+
+uint64_t signature_verifier::cache_hits() const
+{
+    return m_pimpl->cache.hits;
+}
+
+uint64_t signature_verifier::cache_misses() const
+{
+    return m_pimpl->cache.misses;
+}
+
+size_t signature_verifier::cache_size() const
+{
+    unique_lock<mutex> lock(m_pimpl->cache.m_mutex);
+    return m_pimpl->cache.order.size();
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "global.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace publiqpp
+{
+
+namespace detail
+{
+class signature_verifier_internals;
+}
+
+//  checks batches of signatures on a pool of worker threads
+//  verify() blocks until the batch is done, the calling thread takes part in it
+//  successful checks are remembered by public key, message digest and signature
+//  so a transaction seen in the pool is not checked again when it comes in a block
+class signature_verifier
+{
+public:
+    class item
+    {
+    public:
+        std::string public_key;
+        std::string message;
+        std::string signature;
+    };
+
+    //  thread_count 0 means one thread per hardware thread
+    signature_verifier(size_t thread_count);
+    ~signature_verifier();
+
+    size_t thread_count() const;
+
+    //  returns the lowest position of an item that does not verify,
+    //  or items.size() when all of them do
+    size_t verify(std::vector<item> const& items);
+    //  throws the same as meshpp::signature does if it does not verify
+    void check(std::string const& public_key,
+               std::string const& message,
+               std::string const& signature);
+
+    uint64_t cache_hits() const;
+    uint64_t cache_misses() const;
+    size_t cache_size() const;
+private:
+    std::unique_ptr<detail::signature_verifier_internals> m_pimpl;
+};
+
+}
@@ -0,0 +1,282 @@
+#include "snapshot.hpp"
+#include "file_sync.hpp"
+
+#include <mesh.pp/cryptoutility.hpp>
+
+#include <belt.pp/scope_helper.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <stdexcept>
+
+namespace filesystem = boost::filesystem;
+using std::string;
+
+namespace publiqpp
+{
+namespace detail
+{
+string const snapshot_format = "publiq snapshot 2";
+
+//  a table is kept as a record with its name as key and the count as value
+class snapshot_record
+{
+public:
+    bool table;
+    bool canonical_is_value;
+    string key;
+    string value;
+    string canonical;
+};
+
+class snapshot_writer_internals
+{
+public:
+    snapshot_writer_internals(filesystem::path const& _path)
+        : path(_path)
+        , path_tmp(_path.string() + ".tmp")
+        , records_left(0)
+    {}
+
+    void write(filesystem::ofstream& fl, string const& value)
+    {
+        uint64_t size = value.size();
+        fl.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        fl.write(value.data(), value.size());
+        if (false == fl.good())
+            throw std::runtime_error("snapshot_writer: cannot write: " + path_tmp.string());
+    }
+
+    void chain(string const& value)
+    {
+        digest = meshpp::hash(digest + meshpp::hash(value));
+    }
+
+    filesystem::path path;
+    filesystem::path path_tmp;
+    string block_number;
+    string block_hash;
+    std::vector<snapshot_record> records;
+    string digest;
+    uint64_t records_left;
+};
+
+class snapshot_reader_internals
+{
+public:
+    snapshot_reader_internals(filesystem::path const& _path)
+        : path(_path)
+        , fl(_path, std::ios_base::binary)
+        , block_number(0)
+        , records_left(0)
+        , records_unhashed(0)
+    {
+        if (false == fl.is_open())
+            throw std::runtime_error("snapshot_reader: cannot open: " + path.string());
+    }
+
+    string read()
+    {
+        uint64_t size = 0;
+        fl.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (false == fl.good() || size > 1024 * 1024 * 1024)
+            throw std::runtime_error("snapshot_reader: corrupted: " + path.string());
+
+        string value(size, '\0');
+        if (size)
+            fl.read(&value[0], size);
+        if (false == fl.good())
+            throw std::runtime_error("snapshot_reader: corrupted: " + path.string());
+
+        return value;
+    }
+
+    void chain(string const& value)
+    {
+        digest = meshpp::hash(digest + meshpp::hash(value));
+    }
+
+    filesystem::path path;
+    filesystem::ifstream fl;
+    string digest;
+    uint64_t block_number;
+    string block_hash;
+    uint64_t records_left;
+    uint64_t records_unhashed;
+};
+}
+
+snapshot_writer::snapshot_writer(filesystem::path const& path,
+                                 uint64_t block_number,
+                                 string const& block_hash)
+    : m_pimpl(new detail::snapshot_writer_internals(path))
+{
+    m_pimpl->block_number = std::to_string(block_number);
+    m_pimpl->block_hash = block_hash;
+}
+
+snapshot_writer::~snapshot_writer() = default;
+
+void snapshot_writer::table(string const& name, uint64_t count)
+{
+    if (m_pimpl->records_left)
+        throw std::logic_error("snapshot_writer::table: previous table is not complete");
+
+    detail::snapshot_record item;
+    item.table = true;
+    item.canonical_is_value = false;
+    item.key = name;
+    item.value = std::to_string(count);
+    m_pimpl->records.push_back(std::move(item));
+    m_pimpl->records_left = count;
+}
+
+void snapshot_writer::record(string const& key,
+                             string const& value,
+                             string const& canonical)
+{
+    if (0 == m_pimpl->records_left)
+        throw std::logic_error("snapshot_writer::record: too many records");
+    --m_pimpl->records_left;
+
+    detail::snapshot_record item;
+    item.table = false;
+    item.canonical_is_value = (canonical == value);
+    item.key = key;
+    item.value = value;
+    if (false == item.canonical_is_value)
+        item.canonical = canonical;
+    m_pimpl->records.push_back(std::move(item));
+}
+
+string snapshot_writer::finish()
+{
+    if (m_pimpl->records_left)
+        throw std::logic_error("snapshot_writer::finish: table is not complete");
+
+    auto& impl = *m_pimpl;
+    filesystem::ofstream fl(impl.path_tmp, std::ios_base::binary | std::ios_base::trunc);
+    if (false == fl.is_open())
+        throw std::runtime_error("snapshot_writer: cannot open: " + impl.path_tmp.string());
+
+    beltpp::on_failure guard([&impl, &fl]
+    {
+        fl.close();
+        boost::system::error_code ec;
+        filesystem::remove(impl.path_tmp, ec);
+    });
+
+    impl.write(fl, detail::snapshot_format);
+    impl.write(fl, impl.block_number);
+    impl.write(fl, impl.block_hash);
+    impl.chain(impl.block_number + "\n" + impl.block_hash);
+
+    for (auto& item : impl.records)
+    {
+        impl.write(fl, item.key);
+        impl.write(fl, item.value);
+
+        if (item.table || item.canonical_is_value)
+            impl.chain(item.key + "\n" + item.value);
+        else
+            impl.chain(item.key + "\n" + item.canonical);
+
+        //  the memory is given back as the file grows
+        string().swap(item.value);
+        string().swap(item.canonical);
+    }
+    impl.records.clear();
+
+    impl.write(fl, string());
+    impl.write(fl, impl.digest);
+    fl.flush();
+    if (false == fl.good())
+        throw std::runtime_error("snapshot_writer: cannot write: " + impl.path_tmp.string());
+    fl.close();
+
+    sync_file(impl.path_tmp);
+    filesystem::rename(impl.path_tmp, impl.path);
+    guard.dismiss();
+    sync_directory(impl.path.parent_path());
+
+    return impl.digest;
+}
+
+snapshot_reader::snapshot_reader(filesystem::path const& path)
+    : m_pimpl(new detail::snapshot_reader_internals(path))
+{
+    if (m_pimpl->read() != detail::snapshot_format)
+        throw std::runtime_error("snapshot_reader: unknown format: " + path.string());
+
+    string str_block_number = m_pimpl->read();
+    m_pimpl->block_number = std::stoull(str_block_number);
+    m_pimpl->block_hash = m_pimpl->read();
+
+    m_pimpl->chain(str_block_number + "\n" + m_pimpl->block_hash);
+}
+
+snapshot_reader::~snapshot_reader() = default;
+
+uint64_t snapshot_reader::block_number() const
+{
+    return m_pimpl->block_number;
+}
+
+string snapshot_reader::block_hash() const
+{
+    return m_pimpl->block_hash;
+}
+
+uint64_t snapshot_reader::table(string const& name)
+{
+    if (m_pimpl->records_left)
+        throw std::logic_error("snapshot_reader::table: previous table is not complete");
+
+    string stored_name = m_pimpl->read();
+    if (stored_name != name)
+        throw std::runtime_error("snapshot_reader: expected table " + name + ", found " + stored_name);
+
+    string str_count = m_pimpl->read();
+    m_pimpl->records_left = std::stoull(str_count);
+
+    m_pimpl->chain(name + "\n" + str_count);
+
+    return m_pimpl->records_left;
+}
+
+void snapshot_reader::record(string& key, string& value)
+{
+    if (0 == m_pimpl->records_left)
+        throw std::logic_error("snapshot_reader::record: too many records");
+    --m_pimpl->records_left;
+
+    key = m_pimpl->read();
+    value = m_pimpl->read();
+    ++m_pimpl->records_unhashed;
+}
+
+void snapshot_reader::hash_record(string const& key, string const& canonical)
+{
+    if (0 == m_pimpl->records_unhashed)
+        throw std::logic_error("snapshot_reader::hash_record: no record to hash");
+    --m_pimpl->records_unhashed;
+
+    m_pimpl->chain(key + "\n" + canonical);
+}
+
+string snapshot_reader::finish()
+{
+    if (m_pimpl->records_left || m_pimpl->records_unhashed)
+        throw std::logic_error("snapshot_reader::finish: table is not complete");
+
+    if (false == m_pimpl->read().empty())
+        throw std::runtime_error("snapshot_reader: unexpected table in " + m_pimpl->path.string());
+
+    string digest = m_pimpl->read();
+    if (digest != m_pimpl->digest)
+        throw std::runtime_error("snapshot_reader: digest mismatch in " + m_pimpl->path.string());
+
+    return digest;
+}
+}
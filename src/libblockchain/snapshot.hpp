@@ -0,0 +1,163 @@
+#pragma once
+
+#include "global.hpp"
+#include "types.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <map>
+
+namespace publiqpp
+{
+namespace detail
+{
+class snapshot_writer_internals;
+class snapshot_reader_internals;
+}
+
+//  snapshot file is a sequence of length prefixed strings
+//  header: block number, block hash
+//  tables: name, record count, then key and value of each record
+//  trailer: digest
+//  the digest chains hashes of table names and records in written order,
+//  records are written sorted by key so the same state gives the same digest
+//  the writer keeps the records in memory, finish() hashes and writes them
+//  and touches nothing else, so it can run on another thread
+class snapshot_writer
+{
+public:
+    snapshot_writer(boost::filesystem::path const& path,
+                    uint64_t block_number,
+                    std::string const& block_hash);
+    ~snapshot_writer();
+
+    void table(std::string const& name, uint64_t count);
+    //  canonical is the form of value that is hashed, it must not
+    //  depend on container iteration order
+    void record(std::string const& key,
+                std::string const& value,
+                std::string const& canonical);
+    std::string finish();
+private:
+    std::unique_ptr<detail::snapshot_writer_internals> m_pimpl;
+};
+
+class snapshot_reader
+{
+public:
+    snapshot_reader(boost::filesystem::path const& path);
+    ~snapshot_reader();
+
+    uint64_t block_number() const;
+    std::string block_hash() const;
+
+    uint64_t table(std::string const& name);
+    void record(std::string& key, std::string& value);
+    //  every record read must be hashed back in its canonical form
+    void hash_record(std::string const& key, std::string const& canonical);
+    //  throws if the digest does not match the content read
+    std::string finish();
+private:
+    std::unique_ptr<detail::snapshot_reader_internals> m_pimpl;
+};
+
+template <typename T>
+inline
+std::string snapshot_canonical(T const& value)
+{
+    return value.to_string();
+}
+
+//  hash containers serialize in iteration order
+template <>
+inline
+std::string snapshot_canonical(StorageTypes::FileUriHolders const& value)
+{
+    std::vector<std::string> sorted(value.addresses.begin(), value.addresses.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string result;
+    for (auto const& item : sorted)
+        result += item + "\n";
+    return result;
+}
+
+template <>
+inline
+std::string snapshot_canonical(StorageTypes::SponsoredInformationHeaders const& value)
+{
+    std::map<std::string, std::string> sorted;
+    for (auto const& item : value.expirations)
+        sorted[item.first] = item.second.to_string();
+
+    std::string result;
+    for (auto const& item : sorted)
+        result += item.first + "\n" + item.second + "\n";
+    return result;
+}
+
+template <>
+inline
+std::string snapshot_canonical(StorageTypes::AccountAuthorizations const& value)
+{
+    std::map<std::string, std::string> sorted;
+    for (auto const& item : value.authorizations)
+    {
+        std::vector<uint64_t> action_ids(item.second.action_ids.begin(),
+                                         item.second.action_ids.end());
+        std::sort(action_ids.begin(), action_ids.end());
+
+        std::string& entry = sorted[item.first];
+        entry = item.second.default_full ? "full" : "partial";
+        for (auto action_id : action_ids)
+            entry += " " + std::to_string(action_id);
+    }
+
+    std::string result;
+    for (auto const& item : sorted)
+        result += item.first + "\n" + item.second + "\n";
+    return result;
+}
+
+template <typename LOADER>
+void snapshot_save(snapshot_writer& writer,
+                   std::string const& name,
+                   LOADER& loader)
+{
+    auto keys = loader.as_const().keys();
+    std::vector<std::string> sorted_keys(keys.begin(), keys.end());
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+
+    writer.table(name, sorted_keys.size());
+    for (auto const& key : sorted_keys)
+    {
+        auto const& value = loader.as_const().at(key);
+        writer.record(key, value.to_string(), snapshot_canonical(value));
+    }
+}
+
+template <typename T, typename LOADER>
+void snapshot_load(snapshot_reader& reader,
+                   std::string const& name,
+                   LOADER& loader,
+                   void* putl)
+{
+    loader.clear();
+
+    uint64_t count = reader.table(name);
+    for (uint64_t index = 0; index != count; ++index)
+    {
+        std::string key, value;
+        reader.record(key, value);
+
+        T item;
+        item.from_string(value, putl);
+        reader.hash_record(key, snapshot_canonical(item));
+        loader.insert(key, item);
+    }
+}
+}
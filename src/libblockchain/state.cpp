@@ -3,6 +3,8 @@
 #include "exception.hpp"
 #include "node_internals.hpp"
 #include "message.tmpl.hpp"
+#include "snapshot.hpp"
+#include "block_undo.hpp"
 
 #include <mesh.pp/fileutility.hpp>
 
@@ -17,27 +19,113 @@ namespace publiqpp
 namespace detail
 {
 
-class state_internals
+//  balances with pool effects, from before the pool layer was split out
+class state_legacy
 {
 public:
-    state_internals(filesystem::path const& path,
-                    detail::node_internals const& impl)
+    state_legacy(filesystem::path const& path)
         : m_accounts("account", path, 10000, detail::get_putl())
         , m_node_accounts("node_account", path, 10000, detail::get_putl())
-        , m_roles("role", path, 10, detail::get_putl())
-        , pimpl_node(&impl)
     {}
 
     meshpp::map_loader<Coin> m_accounts;
     meshpp::map_loader<Coin> m_node_accounts;
+};
+
+class state_internals
+{
+public:
+    state_internals(filesystem::path const& path,
+                    detail::node_internals const& impl,
+                    block_undo& undo)
+        : m_accounts("chain_account", path, 10000, detail::get_putl())
+        , m_pool_accounts("pool_account", path, 10000, detail::get_putl())
+        , m_roles("role", path, 10, detail::get_putl())
+        , m_plegacy(new state_legacy(path))
+        , pimpl_node(&impl)
+        , pundo(&undo)
+    {
+        //  kept open only until migrated
+        if (0 == m_plegacy->m_accounts.as_const().size() &&
+            0 == m_plegacy->m_node_accounts.as_const().size())
+            m_plegacy.reset();
+    }
+
+    coin chain_balance(string const& key) const
+    {
+        if (m_accounts.as_const().contains(key))
+            return m_accounts.as_const().at(key);
+
+        return coin(); // all accounts not included have 0 balance
+    }
+
+    coin pool_balance(string const& key) const
+    {
+        if (m_pool_accounts.as_const().contains(key))
+            return m_pool_accounts.as_const().at(key);
+
+        return chain_balance(key);
+    }
+
+    //  the pool layer keeps only the accounts where it differs from the chain
+    void set_pool(string const& key, coin const& amount)
+    {
+        pundo->touch("pool_account", m_pool_accounts, key);
+
+        if (amount == chain_balance(key))
+        {
+            m_pool_accounts.erase(key);
+            return;
+        }
+
+        Coin Amount;
+        amount.to_Coin(Amount);
+
+        if (m_pool_accounts.contains(key))
+            m_pool_accounts.at(key) = Amount;
+        else
+            m_pool_accounts.insert(key, Amount);
+    }
+
+    //  a change in the chain layer moves the pool balance by the same amount
+    void set_chain(string const& key, coin const& amount)
+    {
+        coin old_amount = chain_balance(key);
+        bool in_pool = m_pool_accounts.as_const().contains(key);
+        coin pool_amount = pool_balance(key);
+
+        if (amount < old_amount && pool_amount < old_amount - amount)
+            throw not_enough_balance_exception(key, pool_amount, old_amount - amount);
+
+        Coin Amount;
+        amount.to_Coin(Amount);
+
+        pundo->touch("chain_account", m_accounts, key);
+
+        if (amount.empty())
+            m_accounts.erase(key);
+        else if (m_accounts.contains(key))
+            m_accounts.at(key) = Amount;
+        else
+            m_accounts.insert(key, Amount);
+
+        if (in_pool)
+            set_pool(key, pool_amount + amount - old_amount);
+    }
+
+    meshpp::map_loader<Coin> m_accounts;
+    meshpp::map_loader<Coin> m_pool_accounts;
     meshpp::map_loader<Role> m_roles;
+    std::unique_ptr<state_legacy> m_plegacy;
     node_internals const* pimpl_node;
+    block_undo* pundo;
 };
 }
 
 state::state(filesystem::path const& fs_state,
-             detail::node_internals const& impl)
-    : m_pimpl(new detail::state_internals(fs_state, impl))
+             detail::node_internals const& impl,
+             block_undo& undo)
+    : m_pimpl(new detail::state_internals(fs_state, impl, undo))
 {
 }
 
@@ -46,72 +134,72 @@ state::~state() = default;
 void state::save()
 {
     m_pimpl->m_accounts.save();
-    m_pimpl->m_node_accounts.save();
+    m_pimpl->m_pool_accounts.save();
     m_pimpl->m_roles.save();
+
+    if (m_pimpl->m_plegacy)
+    {
+        m_pimpl->m_plegacy->m_accounts.save();
+        m_pimpl->m_plegacy->m_node_accounts.save();
+    }
 }
 
 void state::commit() noexcept
 {
     m_pimpl->m_accounts.commit();
-    m_pimpl->m_node_accounts.commit();
+    m_pimpl->m_pool_accounts.commit();
     m_pimpl->m_roles.commit();
+
+    if (m_pimpl->m_plegacy)
+    {
+        m_pimpl->m_plegacy->m_accounts.commit();
+        m_pimpl->m_plegacy->m_node_accounts.commit();
+    }
 }
 
 void state::discard() noexcept
 {
     m_pimpl->m_accounts.discard();
-    m_pimpl->m_node_accounts.discard();
+    m_pimpl->m_pool_accounts.discard();
     m_pimpl->m_roles.discard();
+
+    if (m_pimpl->m_plegacy)
+    {
+        m_pimpl->m_plegacy->m_accounts.discard();
+        m_pimpl->m_plegacy->m_node_accounts.discard();
+    }
 }
 
 void state::clear()
 {
     m_pimpl->m_accounts.clear();
-    m_pimpl->m_node_accounts.clear();
+    m_pimpl->m_pool_accounts.clear();
     m_pimpl->m_roles.clear();
+
+    if (m_pimpl->m_plegacy)
+    {
+        m_pimpl->m_plegacy->m_accounts.clear();
+        m_pimpl->m_plegacy->m_node_accounts.clear();
+    }
 }
 
 Coin state::get_balance(string const& key, state_layer layer) const
 {
-    if (layer == state_layer::pool &&
-        m_pimpl->m_accounts.as_const().contains(key))
-            return m_pimpl->m_accounts.as_const().at(key);
-
-    if (layer == state_layer::chain &&
-        m_pimpl->m_node_accounts.as_const().contains(key))
-        return m_pimpl->m_node_accounts.as_const().at(key);
+    Coin result;
+    if (layer == state_layer::pool)
+        m_pimpl->pool_balance(key).to_Coin(result);
+    else
+        m_pimpl->chain_balance(key).to_Coin(result);
 
-    return Coin(); // all accounts not included have 0 balance
+    return result;
 }
 
 void state::set_balance(std::string const& key, coin const& amount, state_layer layer)
 {
-    Coin Amount;
-    amount.to_Coin(Amount);
-
-    if (amount.empty())
-        m_pimpl->m_accounts.erase(key);
-    else if (m_pimpl->m_accounts.contains(key))
-    {
-        Coin& balance = m_pimpl->m_accounts.at(key);
-        balance = Amount;
-    }
+    if (state_layer::chain == layer)
+        m_pimpl->set_chain(key, amount);
     else
-        m_pimpl->m_accounts.insert(key, Amount);
-
-    if (state_layer::chain == layer &&
-        m_pimpl->pimpl_node->front_public_key().to_string() == key)
-    {
-        if (amount.empty())
-            m_pimpl->m_node_accounts.erase(key);
-        else if (m_pimpl->m_node_accounts.contains(key))
-        {
-            Coin& node_balance = m_pimpl->m_node_accounts.at(key);
-            node_balance = Amount;
-        }
-        else
-            m_pimpl->m_node_accounts.insert(key, Amount);
-    }
+        m_pimpl->set_pool(key, amount);
 }
 
 void state::increase_balance(string const& key, coin const& amount, state_layer layer)
@@ -119,8 +207,10 @@ void state::increase_balance(string const& key, coin const& amount, state_layer
     if (amount.empty())
         return;
 
-    Coin balance = get_balance(key, state_layer::pool);
-    set_balance(key, balance + amount, layer);
+    if (state_layer::chain == layer)
+        m_pimpl->set_chain(key, m_pimpl->chain_balance(key) + amount);
+    else
+        m_pimpl->set_pool(key, m_pimpl->pool_balance(key) + amount);
 }
 
 void state::decrease_balance(string const& key, coin const& amount, state_layer layer)
@@ -128,14 +218,60 @@ void state::decrease_balance(string const& key, coin const& amount, state_layer
     if (amount.empty())
         return;
 
-    Coin balance = get_balance(key, state_layer::pool);
+    coin balance = state_layer::chain == layer ?
+                   m_pimpl->chain_balance(key) :
+                   m_pimpl->pool_balance(key);
 
-    if (coin(balance) < amount)
-        throw not_enough_balance_exception(key, coin(balance), amount);
+    if (balance < amount)
+        throw not_enough_balance_exception(key, balance, amount);
 
     set_balance(key, balance - amount, layer);
 }
 
+bool state::legacy_accounts() const
+{
+    return nullptr != m_pimpl->m_plegacy;
+}
+
+void state::load_legacy_accounts()
+{
+    if (nullptr == m_pimpl->m_plegacy)
+        return;
+
+    if (m_pimpl->m_accounts.as_const().size() ||
+        m_pimpl->m_pool_accounts.as_const().size())
+        throw std::runtime_error("state::load_legacy_accounts: the account layers are not empty");
+
+    //  the node account map only repeats the own balance of the node
+    auto& legacy_accounts = m_pimpl->m_plegacy->m_accounts;
+    auto keys = legacy_accounts.as_const().keys();
+    for (auto const& key : keys)
+    {
+        m_pimpl->pundo->touch("pool_account", m_pimpl->m_pool_accounts, key);
+        m_pimpl->m_pool_accounts.insert(key, legacy_accounts.as_const().at(key));
+    }
+
+    legacy_accounts.clear();
+    m_pimpl->m_plegacy->m_node_accounts.clear();
+}
+
+void state::close_legacy_accounts()
+{
+    m_pimpl->m_plegacy.reset();
+}
+
+void state::apply_pool_to_chain()
+{
+    auto keys = m_pimpl->m_pool_accounts.as_const().keys();
+    for (auto const& key : keys)
+    {
+        coin amount = m_pimpl->m_pool_accounts.as_const().at(key);
+        m_pimpl->pundo->touch("pool_account", m_pimpl->m_pool_accounts, key);
+        m_pimpl->m_pool_accounts.erase(key);
+        m_pimpl->set_chain(key, amount);
+    }
+}
+
 bool state::get_role(string const& nodeid, NodeType& node_type) const
 {
     if (m_pimpl->m_roles.as_const().contains(nodeid))
@@ -152,11 +288,13 @@ void state::insert_role(Role const& role)
     if (m_pimpl->m_roles.as_const().contains(role.node_address))
         throw std::logic_error("role already exists");
 
+    m_pimpl->pundo->touch("role", m_pimpl->m_roles, role.node_address);
     m_pimpl->m_roles.insert(role.node_address, role);
 }
 
 void state::remove_role(string const& nodeid)
 {
+    m_pimpl->pundo->touch("role", m_pimpl->m_roles, nodeid);
     m_pimpl->m_roles.erase(nodeid);
 }
 
@@ -173,5 +311,38 @@ void state::get_nodes(BlockchainMessage::NodeType const& node_type, vector<strin
     }
 }
 
+void state::export_snapshot(snapshot_writer& writer)
+{
+    //  the pool layer is reverted before the snapshot is taken
+    snapshot_save(writer, "account", m_pimpl->m_accounts);
+    snapshot_save(writer, "role", m_pimpl->m_roles);
 }
 
+void state::import_snapshot(snapshot_reader& reader)
+{
+    snapshot_load<Coin>(reader, "account", m_pimpl->m_accounts, detail::get_putl().get());
+    snapshot_load<Role>(reader, "role", m_pimpl->m_roles, detail::get_putl().get());
+
+    m_pimpl->m_pool_accounts.clear();
+
+    if (m_pimpl->m_plegacy)
+    {
+        m_pimpl->m_plegacy->m_accounts.clear();
+        m_pimpl->m_plegacy->m_node_accounts.clear();
+    }
+}
+
+bool state::restore(StorageTypes::BlockUndoEntry const& entry)
+{
+    if (entry.table == "chain_account")
+        block_undo::restore<Coin>(m_pimpl->m_accounts, entry, detail::get_putl().get());
+    else if (entry.table == "pool_account")
+        block_undo::restore<Coin>(m_pimpl->m_pool_accounts, entry, detail::get_putl().get());
+    else if (entry.table == "role")
+        block_undo::restore<Role>(m_pimpl->m_roles, entry, detail::get_putl().get());
+    else
+        return false;
+
+    return true;
+}
+}
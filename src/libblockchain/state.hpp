@@ -2,6 +2,7 @@
 
 #include "coin.hpp"
 #include "message.hpp"
+#include "types.hpp"
 #include <boost/filesystem/path.hpp>
 
 #include <vector>
@@ -13,17 +14,24 @@ namespace detail
 {
 class node_internals;
 }
+//  chain layer holds the balances as of the last block, pool layer
+//  holds on top of it only the accounts changed by pool transactions
 enum class state_layer { chain, pool };
 
 namespace detail
 {
 class state_internals;
 }
+class snapshot_writer;
+class snapshot_reader;
+class block_undo;
+
 class state
 {
 public:
     state(boost::filesystem::path const& fs_state,
-          detail::node_internals const& impl);
+          detail::node_internals const& impl,
+          block_undo& undo);
     ~state();
 
     void save();
@@ -36,11 +44,26 @@ public:
     void increase_balance(std::string const& key, coin const& amount, state_layer layer);
     void decrease_balance(std::string const& key, coin const& amount, state_layer layer);
 
+    //  data directories from before the layers were split keep a single
+    //  account map with pool effects, load_legacy_accounts() takes it as the
+    //  pool layer, and once the pool is reverted apply_pool_to_chain() moves
+    //  it to the chain, the emptied legacy maps are closed after the commit
+    bool legacy_accounts() const;
+    void load_legacy_accounts();
+    void apply_pool_to_chain();
+    void close_legacy_accounts();
+
     bool get_role(std::string const& nodeid, BlockchainMessage::NodeType& node_type) const;
     void insert_role(BlockchainMessage::Role const& role);
     void remove_role(std::string const& nodeid);
     void get_nodes(BlockchainMessage::NodeType const& node_type, std::vector<std::string>& nodes) const;
 
+    void export_snapshot(snapshot_writer& writer);
+    void import_snapshot(snapshot_reader& reader);
+
+    //  false if the entry is not of a state container
+    bool restore(StorageTypes::BlockUndoEntry const& entry);
+
 private:
     std::unique_ptr<detail::state_internals> m_pimpl;
 };
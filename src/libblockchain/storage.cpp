@@ -1,5 +1,6 @@
 #include "storage.hpp"
 #include "common.hpp"
+#include "file_sync.hpp"
 
 #include "types.hpp"
 #include "message.hpp"
@@ -9,9 +10,16 @@
 
 #include <belt.pp/utility.hpp>
 
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
 #include <string>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
 
 namespace filesystem = boost::filesystem;
+using std::chrono::system_clock;
 using std::string;
 using std::unordered_map;
 using std::unordered_set;
@@ -25,6 +33,88 @@ class storage_internals
 {
 public:
     storage_internals(filesystem::path const& path)
+        : map("storage_info", path, 10000, detail::get_putl_types())
+        , blobs(path / "blobs")
+    {}
+
+    //  blobs are sharded by the leading characters of the uri
+    filesystem::path blob_path(string const& uri) const
+    {
+        if (uri.length() < 4)
+            throw std::runtime_error("storage: invalid uri: " + uri);
+
+        return blobs / uri.substr(0, 2) / uri.substr(2, 2) / uri;
+    }
+
+    void write_blob(string const& uri, string const& data) const
+    {
+        auto path = blob_path(uri);
+        auto path_tmp = path;
+        path_tmp += ".tmp";
+
+        bool created = filesystem::create_directories(path.parent_path());
+
+        {
+            filesystem::ofstream fl(path_tmp, std::ios_base::binary | std::ios_base::trunc);
+            fl.write(data.data(), data.size());
+            fl.flush();
+            if (false == fl.good())
+                throw std::runtime_error("storage: cannot write: " + path_tmp.string());
+        }
+
+        //  the blob is on disk before the info pointing to it is committed
+        sync_file(path_tmp);
+        filesystem::rename(path_tmp, path);
+        sync_directory(path.parent_path());
+        if (created)
+        {
+            sync_directory(path.parent_path().parent_path());
+            sync_directory(blobs);
+            sync_directory(blobs.parent_path());
+        }
+    }
+
+    bool read_blob(string const& uri, string& data) const
+    {
+        filesystem::ifstream fl(blob_path(uri), std::ios_base::binary);
+        if (false == fl.is_open())
+            return false;
+
+        std::istreambuf_iterator<char> begin(fl), end;
+        data.assign(begin, end);
+
+        return true;
+    }
+
+    bool read_blob(string const& uri, uint64_t offset, uint64_t length, string& data) const
+    {
+        filesystem::ifstream fl(blob_path(uri), std::ios_base::binary);
+        if (false == fl.is_open())
+            return false;
+
+        data.resize(length);
+        fl.seekg(offset);
+        fl.read(&data[0], length);
+        data.resize(size_t(fl.gcount()));
+
+        return true;
+    }
+
+    void remove_blob(string const& uri) const
+    {
+        boost::system::error_code ec;
+        filesystem::remove(blob_path(uri), ec);
+    }
+
+    meshpp::map_loader<StorageTypes::StorageFileInfo> map;
+    filesystem::path blobs;
+};
+
+//  the layout used before blob files, base64 data inside json chunks
+class storage_legacy
+{
+public:
+    storage_legacy(filesystem::path const& path)
         : map("storage", path, 10000, detail::get_putl())
     {}
 
@@ -34,28 +124,40 @@ public:
 
 storage::storage(boost::filesystem::path const& fs_storage)
     : m_pimpl(new detail::storage_internals(fs_storage))
-{}
+{
+    if (false == detail::storage_legacy(fs_storage).map.keys().empty())
+        throw std::runtime_error("storage is stored in old format, run with --migrate_storage once");
+}
 storage::~storage()
 {}
 
 bool storage::put(BlockchainMessage::StorageFile&& file, string& uri)
 {
-    bool code = false;
     uri = meshpp::hash(file.data);
-    file.data = meshpp::to_base64(file.data, true);
+
+    if (contains(uri))
+        return false;
+
+    //  the blob is written first, a blob without info is
+    //  invisible and will be overwritten by the same upload
+    m_pimpl->write_blob(uri, file.data);
+
+    StorageTypes::StorageFileInfo info;
+    info.mime_type = file.mime_type;
+    info.size = file.data.size();
+    info.stored_at.tm = system_clock::to_time_t(system_clock::now());
+
     beltpp::on_failure guard([this]
     {
         m_pimpl->map.discard();
     });
 
-    if (m_pimpl->map.insert(uri, file))
-        code = true;
-
+    m_pimpl->map.insert(uri, info);
     m_pimpl->map.save();
 
     guard.dismiss();
     m_pimpl->map.commit();
-    return code;
+    return true;
 }
 
 bool storage::get(string const& uri, BlockchainMessage::StorageFile& file)
@@ -63,9 +165,10 @@ bool storage::get(string const& uri, BlockchainMessage::StorageFile& file)
     if (false == m_pimpl->map.contains(uri))
         return false;
 
-    file = m_pimpl->map.as_const().at(uri);
+    file.mime_type = m_pimpl->map.as_const().at(uri).mime_type;
 
-    file.data = meshpp::from_base64(file.data);
+    if (false == m_pimpl->read_blob(uri, file.data))
+        throw std::runtime_error("storage::get: missing blob for " + uri);
 
     if (beltpp::chance_one_of(1000))
         m_pimpl->map.discard();
@@ -73,6 +176,42 @@ bool storage::get(string const& uri, BlockchainMessage::StorageFile& file)
     return true;
 }
 
+bool storage::contains(string const& uri) const
+{
+    return m_pimpl->map.contains(uri);
+}
+
+bool storage::get_info(string const& uri, StorageTypes::StorageFileInfo& info) const
+{
+    if (false == m_pimpl->map.contains(uri))
+        return false;
+
+    info = m_pimpl->map.as_const().at(uri);
+    return true;
+}
+
+bool storage::get_part(string const& uri,
+                       uint64_t offset,
+                       uint64_t length,
+                       BlockchainMessage::StorageFile& file)
+{
+    StorageTypes::StorageFileInfo info;
+    if (false == get_info(uri, info))
+        return false;
+
+    if (offset > info.size)
+        throw std::logic_error("storage::get_part: offset > info.size");
+    length = std::min(length, info.size - offset);
+
+    file.mime_type = info.mime_type;
+    file.data.clear();
+    if (length > 0 &&
+        false == m_pimpl->read_blob(uri, offset, length, file.data))
+        throw std::runtime_error("storage::get_part: missing blob for " + uri);
+
+    return true;
+}
+
 bool storage::remove(string const& uri)
 {
     if (false == m_pimpl->map.contains(uri))
@@ -88,6 +227,8 @@ bool storage::remove(string const& uri)
     guard.dismiss();
     m_pimpl->map.commit();
 
+    m_pimpl->remove_blob(uri);
+
     return true;
 }
 
@@ -96,6 +237,60 @@ unordered_set<string> storage::get_file_uris() const
     return m_pimpl->map.keys();
 }
 
+uint64_t storage::migrate(boost::filesystem::path const& fs_storage)
+{
+    detail::storage_legacy legacy(fs_storage);
+    detail::storage_internals current(fs_storage);
+
+    uint64_t count = 0;
+    auto uris = legacy.map.keys();
+
+    //  every file is written to the new layout before it is
+    //  erased from the old one, so an interrupted run can continue
+    for (auto const& uri : uris)
+    {
+        {
+            BlockchainMessage::StorageFile file = legacy.map.as_const().at(uri);
+            file.data = meshpp::from_base64(file.data);
+
+            current.write_blob(uri, file.data);
+
+            StorageTypes::StorageFileInfo info;
+            info.mime_type = file.mime_type;
+            info.size = file.data.size();
+            info.stored_at.tm = system_clock::to_time_t(system_clock::now());
+
+            beltpp::on_failure guard([&current]
+            {
+                current.map.discard();
+            });
+
+            if (current.map.contains(uri))
+                current.map.erase(uri);
+            current.map.insert(uri, info);
+            current.map.save();
+
+            guard.dismiss();
+            current.map.commit();
+        }
+
+        beltpp::on_failure guard([&legacy]
+        {
+            legacy.map.discard();
+        });
+
+        legacy.map.erase(uri);
+        legacy.map.save();
+
+        guard.dismiss();
+        legacy.map.commit();
+
+        ++count;
+    }
+
+    return count;
+}
+
 namespace detail
 {
 
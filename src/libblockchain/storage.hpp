@@ -3,6 +3,7 @@
 #include "global.hpp"
 
 #include "message.hpp"
+#include "types.hpp"
 
 #include <boost/filesystem/path.hpp>
 
@@ -20,7 +21,7 @@ class storage_internals;
 class storage_controller_internals;
 }
 
-class storage
+class BLOCKCHAINSHARED_EXPORT storage
 {
 public:
     storage(boost::filesystem::path const& fs_storage);
@@ -28,8 +29,17 @@ public:
 
     bool put(BlockchainMessage::StorageFile&& file, std::string& uri);
     bool get(std::string const& uri, BlockchainMessage::StorageFile& file);
+    //  answered from the file info records only, without reading file data
+    bool contains(std::string const& uri) const;
+    bool get_info(std::string const& uri, StorageTypes::StorageFileInfo& info) const;
+    bool get_part(std::string const& uri,
+                  uint64_t offset,
+                  uint64_t length,
+                  BlockchainMessage::StorageFile& file);
     bool remove(std::string const& uri);
     std::unordered_set<std::string> get_file_uris() const;
+
+    static uint64_t migrate(boost::filesystem::path const& fs_storage);
 private:
     std::unique_ptr<detail::storage_internals> m_pimpl;
 };
@@ -17,6 +17,7 @@
 #include <exception>
 #include <stdexcept>
 #include <thread>
+#include <algorithm>
 
 using namespace BlockchainMessage;
 
@@ -36,6 +37,72 @@ using std::unordered_set;
 namespace publiqpp
 {
 
+//  sends the next part of each answer body being streamed, so that a body
+//  is never read whole and a large one does not hold the loop from the rest
+//  a file gone meanwhile leaves the answer cut, so the connection is dropped
+void send_file_parts(detail::storage_node_internals& impl)
+{
+    for (auto it = impl.m_file_streams.begin(); it != impl.m_file_streams.end();)
+    {
+        auto const& peerid = it->first;
+        auto& stream = it->second;
+
+        uint64_t length = std::min<uint64_t>(STORAGE_HTTP_PART_LENGTH, stream.end - stream.offset);
+
+        bool sent = false;
+        try
+        {
+            StorageFile file;
+            if (impl.m_storage.get_part(stream.uri, stream.offset, length, file) &&
+                file.data.length() == length)
+            {
+                StorageFileChunk chunk;
+                chunk.data = std::move(file.data);
+                impl.m_ptr_rpc_socket->send(peerid, beltpp::packet(std::move(chunk)));
+
+                stream.offset += length;
+                sent = true;
+            }
+            else
+                impl.m_ptr_rpc_socket->send(peerid, beltpp::packet(beltpp::stream_drop()));
+        }
+        catch (std::exception const&)
+        {
+            //  the peer is gone
+        }
+
+        if (sent && stream.offset < stream.end)
+            ++it;
+        else
+        {
+            impl.m_event_queue.release(peerid);
+            it = impl.m_file_streams.erase(it);
+        }
+    }
+
+    //  the loop comes back for the next parts without waiting for events
+    if (false == impl.m_file_streams.empty())
+        impl.m_ptr_eh->wake();
+}
+
+void stream_file(detail::storage_node_internals& impl,
+                 peer_id const& peerid,
+                 string const& uri,
+                 uint64_t offset,
+                 uint64_t end)
+{
+    if (offset >= end)
+        return;
+
+    detail::file_stream stream;
+    stream.uri = uri;
+    stream.offset = offset;
+    stream.end = end;
+
+    impl.m_file_streams[peerid] = std::move(stream);
+    impl.m_event_queue.hold(peerid);
+}
+
 /*
  * storage_node
  */
@@ -152,9 +219,97 @@ void storage_node::run(bool& stop)
                     file_uri = file_info.uri;
                 }
 
+                StorageTypes::StorageFileInfo info;
+                bool found = (false == file_uri.empty() &&
+                              m_pimpl->m_storage.get_info(file_uri, info));
+
+                //  the http clients get the validators, and when the copy
+                //  they have is valid the index alone answers them
+                //  their answers have own types, so they are framed as http
+                //  whatever else is pipelined on the connection
+                bool from_http = file_info.from_http && *file_info.from_http;
+
+                uint64_t range_begin = 0, range_end = 0;
+                auto range_status = found && from_http && file_info.range ?
+                                        http::parse_range(*file_info.range, info.size, range_begin, range_end) :
+                                        http::range_parse::none;
+
                 StorageFile file;
-                if (false == file_uri.empty() &&
-                    m_pimpl->m_storage.get(file_uri, file))
+                if (found && from_http && file_info.if_none_match &&
+                    http::entity_tag_match(*file_info.if_none_match, file_uri))
+                {
+                    StorageFileNotModified not_modified;
+                    not_modified.uri = file_uri;
+                    not_modified.stored_at = info.stored_at;
+
+                    psk->send(peerid, beltpp::packet(std::move(not_modified)));
+                }
+                else if (found && range_status == http::range_parse::unsatisfiable)
+                {
+                    StorageFileError error;
+                    error.uri = file_uri;
+                    error.uri_problem_type = UriProblemType::invalid;
+                    error.total_size = info.size;
+                    psk->send(peerid, beltpp::packet(std::move(error)));
+                }
+                else if (found && range_status == http::range_parse::range &&
+                         m_pimpl->m_storage.get_part(file_uri,
+                                                     range_begin,
+                                                     std::min<uint64_t>(STORAGE_HTTP_PART_LENGTH,
+                                                                        range_end - range_begin),
+                                                     file))
+                {
+                    StorageFileRange file_range;
+                    file_range.mime_type = std::move(file.mime_type);
+                    file_range.range_begin = range_begin;
+                    file_range.range_length = range_end - range_begin;
+                    file_range.total_size = info.size;
+                    file_range.uri = file_uri;
+                    file_range.stored_at = info.stored_at;
+                    uint64_t sent_end = range_begin + file.data.length();
+                    file_range.data = std::move(file.data);
+
+                    psk->send(peerid, beltpp::packet(std::move(file_range)));
+                    stream_file(*m_pimpl, peerid, file_uri, sent_end, range_end);
+
+                    //  count a view once, for the part that starts the file
+                    if (0 == range_begin &&
+                        m_pimpl->pconfig->get_node_type() == NodeType::storage)
+                    {
+                        Served msg;
+                        msg.storage_order_token = file_info.storage_order_token;
+
+                        StorageTypes::ContainerMessage msg_response;
+                        msg_response.package.set(msg);
+                        m_pimpl->m_ptr_direct_stream->send(node_peerid, packet(std::move(msg_response)));
+                    }
+                }
+                else if (found && from_http &&
+                         m_pimpl->m_storage.get_part(file_uri, 0, STORAGE_HTTP_PART_LENGTH, file))
+                {
+                    StorageFileContent content;
+                    content.uri = file_uri;
+                    content.mime_type = std::move(file.mime_type);
+                    content.stored_at = info.stored_at;
+                    content.size = info.size;
+                    uint64_t sent_end = file.data.length();
+                    content.data = std::move(file.data);
+
+                    psk->send(peerid, beltpp::packet(std::move(content)));
+                    stream_file(*m_pimpl, peerid, file_uri, sent_end, info.size);
+
+                    if (m_pimpl->pconfig->get_node_type() == NodeType::storage)
+                    {
+                        Served msg;
+                        msg.storage_order_token = file_info.storage_order_token;
+
+                        StorageTypes::ContainerMessage msg_response;
+                        msg_response.package.set(msg);
+                        m_pimpl->m_ptr_direct_stream->send(node_peerid, packet(std::move(msg_response)));
+                    }
+                }
+                else if (found && false == from_http &&
+                         m_pimpl->m_storage.get(file_uri, file))
                 {
                     psk->send(peerid, beltpp::packet(std::move(file)));
 
@@ -168,6 +323,13 @@ void storage_node::run(bool& stop)
                         m_pimpl->m_ptr_direct_stream->send(node_peerid, packet(std::move(msg_response)));
                     }
                 }
+                else if (from_http)
+                {
+                    StorageFileError error;
+                    error.uri = file_uri;
+                    error.uri_problem_type = UriProblemType::missing;
+                    psk->send(peerid, beltpp::packet(std::move(error)));
+                }
                 else
                 {
                     UriError error;
@@ -183,13 +345,13 @@ void storage_node::run(bool& stop)
                 StorageFileDetails details_request;
                 std::move(ref_packet).get(details_request);
 
-                StorageFile file;
-                if (m_pimpl->m_storage.get(details_request.uri, file))
+                StorageTypes::StorageFileInfo info;
+                if (m_pimpl->m_storage.get_info(details_request.uri, info))
                 {
                     StorageFileDetailsResponse details_response;
                     details_response.uri = details_request.uri;
-                    details_response.size = file.data.length();
-                    details_response.mime_type = file.mime_type;
+                    details_response.size = info.size;
+                    details_response.mime_type = info.mime_type;
 
                     psk->send(peerid, beltpp::packet(std::move(details_response)));
                 }
@@ -448,6 +610,8 @@ void storage_node::run(bool& stop)
             throw;
         }
     }
+
+    send_file_parts(*m_pimpl);
 }
 
 }
@@ -59,6 +59,15 @@ namespace publiqpp
 namespace detail
 {
 
+//  the rest of an http answer body, sent a part at a time
+class file_stream
+{
+public:
+    string uri;
+    uint64_t offset = 0;
+    uint64_t end = 0;
+};
+
 class storage_node_internals
 {
 public:
@@ -115,6 +124,8 @@ public:
     unordered_set<string> m_verified_channels;
     unique_ptr<SyncResponse> m_sync_response;
     event_queue_manager m_event_queue;
+    //  the connections wait for the body before the next request is read
+    unordered_map<peer_id, file_stream> m_file_streams;
 };
 
 }
@@ -26,7 +26,8 @@ namespace publiqpp
 void signed_transaction_validate(SignedTransaction const& signed_transaction,
                                  std::chrono::system_clock::time_point const& now,
                                  std::chrono::seconds const& time_shift,
-                                 publiqpp::detail::node_internals& /*impl*/)
+                                 publiqpp::detail::node_internals& impl,
+                                 vector<signature_verifier::item>* pdeferred_signatures)
 {
     if (signed_transaction.authorizations.empty())
         throw wrong_data_exception("transaction with no authorizations");
@@ -40,15 +41,30 @@ void signed_transaction_validate(SignedTransaction const& signed_transaction,
         if (false == insert_res.second)
             throw wrong_data_exception("duplicate signature");
 
-        meshpp::public_key pb_key(authority.address);
-        meshpp::signature signature_check(pb_key, signed_message, authority.signature);
+        if (pdeferred_signatures)
+        {
+            signature_verifier::item item;
+            item.public_key = authority.address;
+            item.message = signed_message;
+            item.signature = authority.signature;
+            pdeferred_signatures->push_back(std::move(item));
+        }
+        else
+            impl.m_signature_verifier.check(authority.address, signed_message, authority.signature);
     }
 
+    transaction_time_validate(signed_transaction.transaction_details, now, time_shift);
+}
+
+void transaction_time_validate(Transaction const& transaction_details,
+                               std::chrono::system_clock::time_point const& now,
+                               std::chrono::seconds const& time_shift)
+{
     namespace chrono = std::chrono;
     using chrono::system_clock;
     using time_point = system_clock::time_point;
-    time_point creation = system_clock::from_time_t(signed_transaction.transaction_details.creation.tm);
-    time_point expiry = system_clock::from_time_t(signed_transaction.transaction_details.expiry.tm);
+    time_point creation = system_clock::from_time_t(transaction_details.creation.tm);
+    time_point expiry = system_clock::from_time_t(transaction_details.expiry.tm);
 
     if (now + time_shift < creation)
         throw wrong_data_exception("Transaction from the future!");
@@ -60,6 +76,23 @@ void signed_transaction_validate(SignedTransaction const& signed_transaction,
         throw wrong_data_exception("Too long lifetime for transaction");
 }
 
+void signed_transaction_validate(SignedTransaction const& signed_transaction,
+                                 std::chrono::system_clock::time_point const& now,
+                                 std::chrono::seconds const& time_shift,
+                                 publiqpp::detail::node_internals& impl)
+{
+    signed_transaction_validate(signed_transaction, now, time_shift, impl, nullptr);
+}
+
+void signed_transaction_validate(SignedTransaction const& signed_transaction,
+                                 std::chrono::system_clock::time_point const& now,
+                                 std::chrono::seconds const& time_shift,
+                                 publiqpp::detail::node_internals& impl,
+                                 vector<signature_verifier::item>& signatures)
+{
+    signed_transaction_validate(signed_transaction, now, time_shift, impl, &signatures);
+}
+
 template <typename T_action>
 bool action_process_on_chain_t(SignedTransaction const& signed_transaction,
                                T_action const& action,
@@ -845,8 +878,15 @@ bool action_process_on_chain_t(BlockchainMessage::SignedTransaction const& signe
         system_clock::now() - chrono::seconds((BLOCK_TR_LENGTH + 1) * BLOCK_MINE_DELAY))
         return true;
 
+    //  serialized and hashed once for the cache, the pool and the action log
+    memoized_transaction transaction_memo(signed_transaction);
+
     // Check pool
-    if (impl.m_transaction_cache.contains(signed_transaction))
+    if (impl.m_transaction_cache.contains(transaction_memo))
+        return false;
+
+    // Check pool capacity
+    if (false == impl.m_transaction_pool.admits(signed_transaction))
         return false;
 
     impl.m_transaction_cache.backup();
@@ -866,12 +906,12 @@ bool action_process_on_chain_t(BlockchainMessage::SignedTransaction const& signe
         fee_validate(impl, signed_transaction);
 
         // Add to action log
-        impl.m_action_log.log_transaction(signed_transaction);
+        impl.m_action_log.log_transaction(transaction_memo);
     }
 
     // Add to the pool
-    impl.m_transaction_pool.push_back(signed_transaction);
-    impl.m_transaction_cache.add_pool(signed_transaction, complete);
+    impl.m_transaction_pool.push_back(transaction_memo);
+    impl.m_transaction_cache.add_pool(transaction_memo, complete);
 
     impl.save(guard);
 
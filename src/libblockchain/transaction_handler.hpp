@@ -4,6 +4,7 @@
 #include "node_internals.hpp"
 
 #include "exception.hpp"
+#include "signature_verifier.hpp"
 
 #include <belt.pp/packet.hpp>
 
@@ -17,6 +18,16 @@ void signed_transaction_validate(BlockchainMessage::SignedTransaction const& sig
                                  std::chrono::system_clock::time_point const& now,
                                  std::chrono::seconds const& time_shift,
                                  publiqpp::detail::node_internals& impl);
+//  same checks, but the signatures are added to be verified later in a batch
+void signed_transaction_validate(BlockchainMessage::SignedTransaction const& signed_transaction,
+                                 std::chrono::system_clock::time_point const& now,
+                                 std::chrono::seconds const& time_shift,
+                                 publiqpp::detail::node_internals& impl,
+                                 std::vector<signature_verifier::item>& signatures);
+//  only the creation and expiry times, no signatures
+void transaction_time_validate(BlockchainMessage::Transaction const& transaction_details,
+                               std::chrono::system_clock::time_point const& now,
+                               std::chrono::seconds const& time_shift);
 
 bool action_process_on_chain(BlockchainMessage::SignedTransaction const& signed_transaction,
                              publiqpp::detail::node_internals& impl);
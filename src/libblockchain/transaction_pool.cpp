@@ -1,12 +1,19 @@
 #include "transaction_pool.hpp"
 #include "node_internals.hpp"
 #include "transaction_handler.hpp"
+#include "segment_store.hpp"
 #include "message.tmpl.hpp"
 
 #include <mesh.pp/fileutility.hpp>
 #include <mesh.pp/cryptoutility.hpp>
 
+#include <map>
+#include <set>
 #include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 
 using namespace BlockchainMessage;
 namespace filesystem = boost::filesystem;
@@ -14,74 +21,528 @@ namespace filesystem = boost::filesystem;
 using std::string;
 using std::vector;
 using std::unordered_map;
+using std::map;
+using std::set;
+using std::pair;
+using std::chrono::system_clock;
 
 namespace publiqpp
 {
 
 namespace detail
 {
+uint64_t const not_journaled = uint64_t(-1);
+
+class transaction_pool_entry
+{
+public:
+    SignedTransaction signed_transaction;
+    string hash;
+    string sender;
+    uint64_t size;
+    coin fee_rate;
+    bool evicted;
+    //  the number of its record in the journal
+    uint64_t journaled;
+};
+
+//  what changed since commit, discard undoes it backwards
+class transaction_pool_change
+{
+public:
+    enum class type {added, removed, evicted, journaled};
+
+    type what;
+    uint64_t number;
+    //  removed: the entry itself
+    transaction_pool_entry entry;
+    //  journaled: the previous record number
+    uint64_t journaled;
+};
+
+//  highest fee rate first, earlier arrived first among equal ones
+class transaction_pool_fee_order
+{
+public:
+    bool operator()(pair<coin, uint64_t> const& lhs, pair<coin, uint64_t> const& rhs) const
+    {
+        if (lhs.first != rhs.first)
+            return lhs.first > rhs.first;
+        return lhs.second < rhs.second;
+    }
+};
+
 class transaction_pool_internals
 {
 public:
     transaction_pool_internals(filesystem::path const& path)
-        : m_transactions("transactions", path, 100, 10, detail::get_putl())
+        : m_journal("pool", path, 4 * 1024 * 1024)
+        , m_next(0)
+        , m_committed_next(0)
+        , m_bytes(0)
+        , m_reload(false)
+    {
+        load();
+    }
+
+    //  fee per 1000 bytes of stored transaction
+    static coin fee_rate(SignedTransaction const& signed_transaction, uint64_t size)
+    {
+        return coin(signed_transaction.transaction_details.fee) * 1000 / std::max(size, uint64_t(1));
+    }
+
+    uint64_t add(SignedTransaction const& signed_transaction,
+                 uint64_t size,
+                 string const& hash,
+                 uint64_t journaled)
+    {
+        if (m_by_hash.count(hash))
+            throw std::logic_error("transaction_pool: duplicate transaction " + hash);
+
+        transaction_pool_entry entry;
+        entry.signed_transaction = signed_transaction;
+        entry.hash = hash;
+        entry.sender = action_owners(signed_transaction).front();
+        entry.size = size;
+        entry.fee_rate = fee_rate(signed_transaction, size);
+        entry.evicted = false;
+        entry.journaled = journaled;
+
+        uint64_t number = m_next;
+        ++m_next;
+        insert(number, std::move(entry));
+
+        return number;
+    }
+
+    void insert(uint64_t number, transaction_pool_entry&& entry)
+    {
+        m_by_hash.insert(std::make_pair(entry.hash, number));
+        m_by_sender[entry.sender].insert(number);
+        if (false == entry.evicted)
+            index(number, entry);
+
+        m_entries.insert(std::make_pair(number, std::move(entry)));
+    }
+
+    transaction_pool_entry remove(map<uint64_t, transaction_pool_entry>::iterator it)
+    {
+        uint64_t number = it->first;
+        transaction_pool_entry entry = std::move(it->second);
+        m_entries.erase(it);
+
+        if (false == entry.evicted)
+            unindex(number, entry);
+
+        m_by_hash.erase(entry.hash);
+
+        auto it_sender = m_by_sender.find(entry.sender);
+        it_sender->second.erase(number);
+        if (it_sender->second.empty())
+            m_by_sender.erase(it_sender);
+
+        return entry;
+    }
+
+    //  evicted ones keep only the hash and sender indices until removed
+    void index(uint64_t number, transaction_pool_entry const& entry)
+    {
+        m_by_expiry.insert(std::make_pair(entry.signed_transaction.transaction_details.expiry.tm, number));
+        m_by_fee.insert(std::make_pair(entry.fee_rate, number));
+        m_bytes += entry.size;
+    }
+    void unindex(uint64_t number, transaction_pool_entry const& entry)
+    {
+        m_by_expiry.erase(std::make_pair(entry.signed_transaction.transaction_details.expiry.tm, number));
+        m_by_fee.erase(std::make_pair(entry.fee_rate, number));
+        m_bytes -= entry.size;
+    }
+
+    void evict(uint64_t number)
+    {
+        auto& entry = m_entries.at(number);
+        unindex(number, entry);
+        entry.evicted = true;
+
+        log(transaction_pool_change::type::evicted, number);
+    }
+
+    //  expired ones go first, then the lowest fee rate ones, but never keep_number
+    void evict_above_limit(uint64_t keep_number)
+    {
+        time_t now = system_clock::to_time_t(system_clock::now());
+
+        while (m_bytes > TRANSACTION_POOL_MAX_BYTES &&
+               false == m_by_expiry.empty() &&
+               m_by_expiry.begin()->first < now &&
+               m_by_expiry.begin()->second != keep_number)
+            evict(m_by_expiry.begin()->second);
+
+        while (m_bytes > TRANSACTION_POOL_MAX_BYTES &&
+               false == m_by_fee.empty() &&
+               m_by_fee.rbegin()->second != keep_number)
+            evict(m_by_fee.rbegin()->second);
+    }
+
+    void log(transaction_pool_change::type what, uint64_t number)
+    {
+        transaction_pool_change change;
+        change.what = what;
+        change.number = number;
+        change.journaled = not_journaled;
+        change.entry.size = 0;
+        change.entry.evicted = false;
+        change.entry.journaled = not_journaled;
+        m_changes.push_back(std::move(change));
+    }
+
+    void reset()
+    {
+        m_entries.clear();
+        m_by_hash.clear();
+        m_by_sender.clear();
+        m_by_expiry.clear();
+        m_by_fee.clear();
+        m_popped.clear();
+        m_changes.clear();
+        m_next = 0;
+        m_committed_next = 0;
+        m_bytes = 0;
+        m_reload = false;
+    }
+
+    //  replays the journal
+    void load()
+    {
+        reset();
+
+        auto putl = detail::get_putl();
+        for (uint64_t number = 0; number != m_journal.size(); ++number)
+        {
+            string record = m_journal.at(number);
+
+            if (false == record.empty() && 'a' == record.front())
+            {
+                SignedTransaction signed_transaction;
+                from_binary(record.data() + 1, record.data() + record.size(), signed_transaction, putl.get());
+                add(signed_transaction, record.size() - 1, meshpp::hash(signed_transaction.to_string()), number);
+            }
+            else if (false == record.empty() && 'r' == record.front())
+            {
+                auto it_hash = m_by_hash.find(record.substr(1));
+                if (it_hash == m_by_hash.end())
+                    throw std::runtime_error("transaction_pool: unknown transaction in journal record " + std::to_string(number));
+
+                remove(m_entries.find(it_hash->second));
+            }
+            else
+                throw std::runtime_error("transaction_pool: corrupted journal record " + std::to_string(number));
+        }
+
+        m_committed_next = m_next;
+    }
+
+    //  back to what was committed, without reading the journal
+    void undo()
+    {
+        for (auto it = m_changes.rbegin(); it != m_changes.rend(); ++it)
+        {
+            auto& change = *it;
+            switch (change.what)
+            {
+            case transaction_pool_change::type::added:
+                remove(m_entries.find(change.number));
+                break;
+            case transaction_pool_change::type::removed:
+                insert(change.number, std::move(change.entry));
+                break;
+            case transaction_pool_change::type::evicted:
+            {
+                auto& entry = m_entries.at(change.number);
+                entry.evicted = false;
+                index(change.number, entry);
+                break;
+            }
+            case transaction_pool_change::type::journaled:
+                m_entries.at(change.number).journaled = change.journaled;
+                break;
+            }
+        }
+
+        m_changes.clear();
+        m_popped.clear();
+        m_next = m_committed_next;
+    }
+
+    void append(uint64_t number, transaction_pool_entry& entry)
+    {
+        log(transaction_pool_change::type::journaled, number);
+        m_changes.back().journaled = entry.journaled;
+
+        entry.journaled = m_journal.size();
+        m_journal.push_back("a" + to_binary(entry.signed_transaction));
+    }
+
+    //  revert_pool pops every transaction and pushes most of them back,
+    //  those keep their records, so only the real changes are written
+    void write()
+    {
+        for (auto const& item : m_popped)
+            m_journal.push_back("r" + item.first);
+        m_popped.clear();
+
+        //  the journal is replayed in the order of arrival, so a transaction
+        //  pushed back before one with an earlier record is written again
+        uint64_t next = 0;
+        for (auto& item : m_entries)
+        {
+            auto& entry = item.second;
+            if (not_journaled == entry.journaled ||
+                entry.journaled < next)
+            {
+                if (not_journaled != entry.journaled)
+                    m_journal.push_back("r" + entry.hash);
+                append(item.first, entry);
+            }
+
+            next = entry.journaled + 1;
+        }
+    }
+
+    //  rewrites the journal with the pooled transactions only
+    void compact()
     {
+        m_journal.clear();
+        m_popped.clear();
+        for (auto& item : m_entries)
+            append(item.first, item.second);
     }
 
-    meshpp::vector_loader<SignedTransaction> m_transactions;
+    segment_store m_journal;
+    //  by order of arrival
+    map<uint64_t, transaction_pool_entry> m_entries;
+    //  ordered to find a transaction by the start of its hash
+    map<string, uint64_t> m_by_hash;
+    unordered_map<string, set<uint64_t>> m_by_sender;
+    set<pair<time_t, uint64_t>> m_by_expiry;
+    set<pair<coin, uint64_t>, transaction_pool_fee_order> m_by_fee;
+    //  journaled transactions popped since save, by hash
+    unordered_map<string, uint64_t> m_popped;
+    vector<transaction_pool_change> m_changes;
+    uint64_t m_next;
+    uint64_t m_committed_next;
+    uint64_t m_bytes;
+    //  cleared since commit, discard reads the journal again
+    bool m_reload;
 };
 }
 
 transaction_pool::transaction_pool(filesystem::path const& fs_transaction_pool)
     : m_pimpl(new detail::transaction_pool_internals(fs_transaction_pool))
 {
+    //  the pool used to be a vector_loader, it is moved to the journal once
+    meshpp::vector_loader<SignedTransaction> legacy("transactions", fs_transaction_pool, 100, 10, detail::get_putl());
+    if (0 == legacy.as_const().size())
+        return;
+
+    if (false == segment_store::exists("pool", fs_transaction_pool))
+    {
+        beltpp::on_failure guard([this]{ discard(); });
 
+        for (size_t index = 0; index != legacy.as_const().size(); ++index)
+            push_back(legacy.as_const().at(index));
+
+        save();
+        guard.dismiss();
+        commit();
+    }
+
+    beltpp::on_failure guard([&legacy]{ legacy.discard(); });
+
+    legacy.clear();
+    legacy.save();
+
+    guard.dismiss();
+    legacy.commit();
 }
 
 transaction_pool::~transaction_pool() = default;
 
 void transaction_pool::save()
 {
-    m_pimpl->m_transactions.save();
+    auto& impl = *m_pimpl;
+
+    if (impl.m_journal.size() + impl.m_popped.size() > 2 * impl.m_entries.size() + BLOCK_MAX_TRANSACTIONS)
+        impl.compact();
+    else
+        impl.write();
+
+    impl.m_journal.save();
 }
 
 void transaction_pool::commit() noexcept
 {
-    m_pimpl->m_transactions.commit();
+    auto& impl = *m_pimpl;
+
+    impl.m_journal.commit();
+    impl.m_changes.clear();
+    impl.m_committed_next = impl.m_next;
+    impl.m_reload = false;
 }
 
 void transaction_pool::discard() noexcept
 {
-    m_pimpl->m_transactions.discard();
+    auto& impl = *m_pimpl;
+
+    impl.m_journal.discard();
+
+    if (impl.m_reload)
+        impl.load();
+    else
+        impl.undo();
 }
 
 void transaction_pool::clear()
 {
-    m_pimpl->m_transactions.clear();
+    m_pimpl->m_journal.clear();
+    m_pimpl->reset();
+    m_pimpl->m_reload = true;
 }
 
-void transaction_pool::push_back(SignedTransaction const& signed_transaction)
+size_t transaction_pool::length() const
 {
-    m_pimpl->m_transactions.push_back(signed_transaction);
+    return m_pimpl->m_entries.size();
 }
 
-void transaction_pool::pop_back()
+uint64_t transaction_pool::bytes() const
 {
-    m_pimpl->m_transactions.pop_back();
+    return m_pimpl->m_bytes;
 }
 
-BlockchainMessage::SignedTransaction const& transaction_pool::at(size_t index) const
+bool transaction_pool::admits(SignedTransaction const& signed_transaction) const
 {
-    return m_pimpl->m_transactions.as_const().at(index);
+    auto const& impl = *m_pimpl;
+
+    uint64_t size = to_binary(signed_transaction).size();
+    if (impl.m_bytes + size <= TRANSACTION_POOL_MAX_BYTES ||
+        impl.m_by_fee.empty())
+        return true;
+
+    return impl.m_by_fee.rbegin()->first < detail::transaction_pool_internals::fee_rate(signed_transaction, size);
 }
-BlockchainMessage::SignedTransaction& transaction_pool::ref_at(size_t index) const
+
+void transaction_pool::push_back(memoized_transaction const& signed_transaction)
 {
-    return m_pimpl->m_transactions.at(index);
+    auto& impl = *m_pimpl;
+
+    //  pushed back after pop_back, it keeps the record
+    uint64_t journaled = detail::not_journaled;
+    auto it_popped = impl.m_popped.find(signed_transaction.digest());
+    if (it_popped != impl.m_popped.end())
+    {
+        journaled = it_popped->second;
+        impl.m_popped.erase(it_popped);
+    }
+
+    uint64_t number = impl.add(signed_transaction.value(),
+                               to_binary(signed_transaction.value()).size(),
+                               signed_transaction.digest(),
+                               journaled);
+    impl.log(detail::transaction_pool_change::type::added, number);
+
+    impl.evict_above_limit(number);
 }
 
-size_t transaction_pool::length() const
+bool transaction_pool::pop_back(SignedTransaction& signed_transaction)
+{
+    auto& impl = *m_pimpl;
+
+    if (impl.m_entries.empty())
+        throw std::logic_error("transaction_pool::pop_back: 0 == length()");
+
+    auto it = std::prev(impl.m_entries.end());
+    uint64_t number = it->first;
+    auto entry = impl.remove(it);
+
+    if (detail::not_journaled != entry.journaled)
+        impl.m_popped[entry.hash] = entry.journaled;
+
+    signed_transaction = entry.signed_transaction;
+    bool evicted = entry.evicted;
+
+    impl.log(detail::transaction_pool_change::type::removed, number);
+    impl.m_changes.back().entry = std::move(entry);
+
+    return false == evicted;
+}
+
+bool transaction_pool::contains(string const& transaction_hash) const
+{
+    return m_pimpl->m_by_hash.count(transaction_hash) > 0;
+}
+
+SignedTransaction const& transaction_pool::at(string const& transaction_hash) const
+{
+    auto const& impl = *m_pimpl;
+    return impl.m_entries.at(impl.m_by_hash.at(transaction_hash)).signed_transaction;
+}
+
+SignedTransaction const* transaction_pool::find_prefix(string const& prefix) const
+{
+    auto const& impl = *m_pimpl;
+
+    auto it = impl.m_by_hash.lower_bound(prefix);
+    if (it == impl.m_by_hash.end() ||
+        0 != it->first.compare(0, prefix.size(), prefix))
+        return nullptr;
+
+    auto it_next = std::next(it);
+    if (it_next != impl.m_by_hash.end() &&
+        0 == it_next->first.compare(0, prefix.size(), prefix))
+        return nullptr;
+
+    return &impl.m_entries.at(it->second).signed_transaction;
+}
+
+vector<string> transaction_pool::hashes_from(string const& sender) const
+{
+    auto const& impl = *m_pimpl;
+    vector<string> result;
+
+    auto it = impl.m_by_sender.find(sender);
+    if (it != impl.m_by_sender.end())
+    {
+        for (auto number : it->second)
+            result.push_back(impl.m_entries.at(number).hash);
+    }
+
+    return result;
+}
+
+vector<SignedTransaction const*> transaction_pool::by_arrival() const
 {
-    return m_pimpl->m_transactions.size();
+    vector<SignedTransaction const*> result;
+    result.reserve(m_pimpl->m_entries.size());
+
+    for (auto const& item : m_pimpl->m_entries)
+    {
+        if (false == item.second.evicted)
+            result.push_back(&item.second.signed_transaction);
+    }
+
+    return result;
+}
+
+vector<SignedTransaction const*> transaction_pool::by_fee() const
+{
+    auto const& impl = *m_pimpl;
+    vector<SignedTransaction const*> result;
+    result.reserve(impl.m_by_fee.size());
+
+    for (auto const& item : impl.m_by_fee)
+        result.push_back(&impl.m_entries.at(item.second).signed_transaction);
+
+    return result;
 }
 
 void load_transaction_cache(publiqpp::detail::node_internals& impl,
@@ -95,10 +556,11 @@ void load_transaction_cache(publiqpp::detail::node_internals& impl,
 
         uint64_t block_count = impl.m_blockchain.length();
         for (uint64_t block_index = block_count - 1;
-             block_index < block_count;
+             block_index < block_count &&
+             block_index >= impl.m_blockchain.first_block();
              --block_index)
         {
-            SignedBlock const& signed_block = impl.m_blockchain.at(block_index);
+            SignedBlock signed_block = impl.m_blockchain.at(block_index);
 
             Block const& block = signed_block.block_details;
 
@@ -119,9 +581,9 @@ void load_transaction_cache(publiqpp::detail::node_internals& impl,
         }
     }
 
-    for (size_t index = 0; index != impl.m_transaction_pool.length(); ++index)
+    for (auto pitem : impl.m_transaction_pool.by_arrival())
     {
-        auto const& item = impl.m_transaction_pool.at(index);
+        auto const& item = *pitem;
         bool complete = action_is_complete(impl, item);
 
         if (false == impl.m_transaction_cache.add_pool(item, complete))
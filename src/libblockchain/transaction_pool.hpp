@@ -2,6 +2,7 @@
 
 #include "global.hpp"
 #include "common.hpp"
+#include "memoized.hpp"
 
 #include <belt.pp/packet.hpp>
 
@@ -19,7 +20,16 @@ class transaction_pool_internals;
 class node_internals;
 }
 
-class transaction_pool
+//  transactions are kept in memory, indexed by transaction hash, by sender,
+//  by expiry and by fee rate, the order of arrival is kept too because
+//  the pool is applied to the state in that order and reverted backwards
+//  changes go to the append-only journal "pool" on save, it is rewritten
+//  with only the pooled transactions when mostly made of removed ones
+//  transactions pushed back after pop_back keep their journal records
+//  and discard undoes the changes in memory, the journal is read at start
+//  above TRANSACTION_POOL_MAX_BYTES expired and then the lowest fee rate
+//  transactions are evicted, they stay until the pool is reverted next time
+class BLOCKCHAINSHARED_EXPORT transaction_pool
 {
 public:
     transaction_pool(boost::filesystem::path const& fs_transaction_pool);
@@ -31,10 +41,25 @@ public:
     void clear();
 
     size_t length() const;
-    void push_back(BlockchainMessage::SignedTransaction const& signed_transaction);
-    void pop_back();
-    BlockchainMessage::SignedTransaction const& at(size_t index) const;
-    BlockchainMessage::SignedTransaction& ref_at(size_t index) const;
+    //  stored size of the transactions that are not evicted
+    uint64_t bytes() const;
+
+    //  false when the pool is full with transactions of higher fee rate
+    bool admits(BlockchainMessage::SignedTransaction const& signed_transaction) const;
+    void push_back(memoized_transaction const& signed_transaction);
+    //  moves out the last arrived transaction,
+    //  returns false if it was evicted and must not be applied back
+    bool pop_back(BlockchainMessage::SignedTransaction& signed_transaction);
+
+    bool contains(std::string const& transaction_hash) const;
+    BlockchainMessage::SignedTransaction const& at(std::string const& transaction_hash) const;
+    //  the transaction which hash starts with the prefix, nullptr if none or several
+    BlockchainMessage::SignedTransaction const* find_prefix(std::string const& prefix) const;
+    std::vector<std::string> hashes_from(std::string const& sender) const;
+
+    //  not evicted transactions, valid until the pool changes
+    std::vector<BlockchainMessage::SignedTransaction const*> by_arrival() const;
+    std::vector<BlockchainMessage::SignedTransaction const*> by_fee() const;
 
 private:
     std::unique_ptr<detail::transaction_pool_internals> m_pimpl;
@@ -14,6 +14,7 @@
 #include <publiq.pp/node.hpp>
 #include <publiq.pp/storage_node.hpp>
 #include <publiq.pp/coin.hpp>
+#include <publiq.pp/migration.hpp>
 
 #include <boost/program_options.hpp>
 #include <boost/locale.hpp>
@@ -69,13 +70,19 @@ bool process_command_line(int argc, char** argv,
                           uint64_t& freeze_before_block,
                           uint64_t& revert_blocks_count,
                           uint64_t& revert_actions_count,
+                          uint64_t& snapshot_interval,
+                          string& load_snapshot,
+                          uint64_t& verification_threads,
+                          uint64_t& query_threads,
                           string& manager_address,
                           bool& enable_action_log,
                           bool& testnet,
                           bool& resync,
                           bool& enable_inbox,
                           bool& discovery_server,
-                          bool& light_node);
+                          bool& light_node,
+                          bool& migrate_blockchain,
+                          bool& migrate_storage);
 string genesis_signed_block(bool testnet);
 publiqpp::coin mine_amount_threshhold();
 vector<publiqpp::coin> block_reward_array();
@@ -258,6 +265,10 @@ int main(int argc, char** argv)
     uint64_t freeze_before_block;
     uint64_t revert_blocks_count;
     uint64_t revert_actions_count;
+    uint64_t snapshot_interval;
+    string load_snapshot;
+    uint64_t verification_threads;
+    uint64_t query_threads;
     string manager_address;
     bool enable_action_log;
     bool testnet;
@@ -265,6 +276,8 @@ int main(int argc, char** argv)
     bool enable_inbox;
     bool discovery_server;
     bool light_node;
+    bool migrate_blockchain;
+    bool migrate_storage;
 
     if (false == process_command_line(argc, argv,
                                       p2p_bind_to_address,
@@ -281,13 +294,19 @@ int main(int argc, char** argv)
                                       freeze_before_block,
                                       revert_blocks_count,
                                       revert_actions_count,
+                                      snapshot_interval,
+                                      load_snapshot,
+                                      verification_threads,
+                                      query_threads,
                                       manager_address,
                                       enable_action_log,
                                       testnet,
                                       resync,
                                       enable_inbox,
                                       discovery_server,
-                                      light_node))
+                                      light_node,
+                                      migrate_blockchain,
+                                      migrate_storage))
         return 1;
 
     if (false == data_directory.empty())
@@ -344,6 +363,10 @@ int main(int argc, char** argv)
     config.set_public_address(public_address);
     config.set_public_ssl_address(public_ssl_address);
     config.set_automatic_fee(fractions);
+    config.set_snapshot_interval(snapshot_interval);
+    config.set_load_snapshot(load_snapshot);
+    config.set_verification_threads(verification_threads);
+    config.set_query_threads(query_threads);
 
     config.set_manager_address(manager_address);
 
@@ -408,6 +431,20 @@ int main(int argc, char** argv)
         auto fs_storages = meshpp::data_directory_path("storages");
         auto fs_authority_store = meshpp::data_directory_path("authority_store");
 
+        if (migrate_blockchain)
+        {
+            cout << "migrating blockchain, this may take a while" << endl;
+            auto count = publiqpp::migrate_blockchain(fs_blockchain);
+            cout << "migrated " << count << " blocks" << endl;
+        }
+
+        if (migrate_storage)
+        {
+            cout << "migrating storage, this may take a while" << endl;
+            auto count = publiqpp::migrate_storage(meshpp::data_directory_path("storage"));
+            cout << "migrated " << count << " files" << endl;
+        }
+
         cout << "p2p local address: " << config.get_p2p_bind_to_address().to_string() << endl;
         for (auto const& item : config.get_p2p_connect_to_addresses())
             cout << "p2p host: " << item.to_string() << endl;
@@ -596,13 +633,19 @@ bool process_command_line(int argc, char** argv,
                           uint64_t& freeze_before_block,
                           uint64_t& revert_blocks_count,
                           uint64_t& revert_actions_count,
+                          uint64_t& snapshot_interval,
+                          string& load_snapshot,
+                          uint64_t& verification_threads,
+                          uint64_t& query_threads,
                           string& manager_address,
                           bool& enable_action_log,
                           bool& testnet,
                           bool& resync,
                           bool& enable_inbox,
                           bool& discovery_server,
-                          bool& light_node)
+                          bool& light_node,
+                          bool& migrate_blockchain,
+                          bool& migrate_storage)
 {
     string p2p_local_interface;
     string rpc_local_interface;
@@ -650,9 +693,22 @@ bool process_command_line(int argc, char** argv,
             ("revert_actions", program_options::value<uint64_t>(&revert_actions_count),
                             "revert recent recorded actions, "
                             "this means to add new actions that are marked as reverted")
+            ("snapshot_interval", program_options::value<uint64_t>(&snapshot_interval),
+                            "write a state snapshot every this many blocks")
+            ("load_snapshot", program_options::value<string>(&load_snapshot),
+                            "replace the state with the snapshot file, "
+                            "given as path:digest the snapshot must have that digest")
+            ("verification_threads", program_options::value<uint64_t>(&verification_threads),
+                            "threads that check signatures of received blocks, "
+                            "one per hardware thread by default")
+            ("query_threads", program_options::value<uint64_t>(&query_threads),
+                            "threads that answer rpc queries not touching the node state, "
+                            "one per hardware thread by default")
             ("enable_inbox", "enable inbox")
             ("discovery_server", "discovery server")
-            ("light_node", "light node");
+            ("light_node", "light node")
+            ("migrate_blockchain", "convert the stored blockchain to segment files, once")
+            ("migrate_storage", "convert the stored files to raw blob files, once");
         (void)(desc_init);
 
         program_options::variables_map options;
@@ -674,6 +730,8 @@ bool process_command_line(int argc, char** argv,
         enable_inbox = options.count("enable_inbox");
         discovery_server = options.count("discovery_server");
         light_node = options.count("light_node");
+        migrate_blockchain = options.count("migrate_blockchain");
+        migrate_storage = options.count("migrate_storage");
 
         if (false == p2p_local_interface.empty())
         p2p_bind_to_address.from_string(p2p_local_interface);
@@ -705,6 +763,12 @@ bool process_command_line(int argc, char** argv,
             revert_blocks_count = 0;
         if (0 == options.count("revert_actions"))
             revert_actions_count = 0;
+        if (0 == options.count("snapshot_interval"))
+            snapshot_interval = 0;
+        if (0 == options.count("verification_threads"))
+            verification_threads = 0;
+        if (0 == options.count("query_threads"))
+            query_threads = 0;
     }
     catch (std::exception const& ex)
     {
@@ -0,0 +1,247 @@
+#include "../libblockchain/binary.hpp"
+#include "../libblockchain/segment_store.hpp"
+
+#include <publiq.pp/message.hpp>
+#include <publiq.pp/message.tmpl.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+using namespace BlockchainMessage;
+
+using std::cout;
+using std::endl;
+using std::string;
+namespace filesystem = boost::filesystem;
+
+inline
+beltpp::void_unique_ptr get_putl()
+{
+    beltpp::message_loader_utility utl;
+    BlockchainMessage::detail::extension_helper(utl);
+
+    auto ptr_utl =
+        beltpp::new_void_unique_ptr<beltpp::message_loader_utility>(std::move(utl));
+
+    return ptr_utl;
+}
+
+void check(bool condition, string const& what)
+{
+    if (false == condition)
+        throw std::runtime_error("failed: " + what);
+}
+
+SignedTransaction make_transaction(uint64_t index)
+{
+    Transaction transaction;
+    transaction.creation.tm = 1546300800 + index;
+    transaction.expiry.tm = 1546300800 + index + 3600;
+    transaction.fee.whole = 0;
+    transaction.fee.fraction = 10000 * index;
+
+    if (index % 2)
+    {
+        Transfer transfer;
+        transfer.from = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+        transfer.to = "PBQ76Zv5QceNSLibecnMGEKbKo3dVFV6HRuDSuX59mJewJxHPhLwu";
+        transfer.amount.whole = index;
+        transfer.amount.fraction = uint64_t(-1) - index;
+        transfer.message = "transfer " + std::to_string(index);
+        transaction.action = std::move(transfer);
+    }
+    else
+    {
+        AuthorizationUpdate update;
+        update.update_type = UpdateType::remove;
+        update.owner = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+        update.actor = "PBQ76Zv5QceNSLibecnMGEKbKo3dVFV6HRuDSuX59mJewJxHPhLwu";
+        update.action_ids = {0, 1, 127, 128, uint64_t(-1)};
+        transaction.action = std::move(update);
+    }
+
+    Authority authority;
+    authority.address = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+    authority.signature = "AN1rKvtGGbfRnyRimyr6PFqaHvAX1XEBHW8JjGFgtmP3Cu4nuo";
+
+    SignedTransaction signed_transaction;
+    signed_transaction.transaction_details = std::move(transaction);
+    signed_transaction.authorizations.push_back(authority);
+
+    return signed_transaction;
+}
+
+SignedBlock make_block(uint64_t block_number)
+{
+    Block block;
+    block.header.block_number = block_number;
+    block.header.delta = 123456789;
+    block.header.c_sum = 987654321;
+    block.header.c_const = 1;
+    block.header.prev_hash = "6GyZmFh4X93Pvq3xSwUnfJYvt4UDmaj1wQC7hnjPykb3";
+    block.header.time_signed.tm = 1546300800 + block_number;
+
+    Reward reward;
+    reward.to = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+    reward.amount.whole = 100;
+    reward.amount.fraction = 0;
+    reward.reward_type = RewardType::sponsored_return;
+    block.rewards.push_back(reward);
+
+    for (uint64_t index = 0; index != 3; ++index)
+        block.signed_transactions.push_back(make_transaction(block_number + index));
+
+    SignedBlock signed_block;
+    signed_block.block_details = std::move(block);
+    signed_block.authorization.address = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+    signed_block.authorization.signature = "AN1rKvtGGbfRnyRimyr6PFqaHvAX1XEBHW8JjGFgtmP3Cu4nuo";
+
+    return signed_block;
+}
+
+template <typename T>
+T round_trip(T const& value, void* putl)
+{
+    string encoded = to_binary(value);
+
+    T decoded;
+    from_binary(encoded.data(), encoded.data() + encoded.size(), decoded, putl);
+
+    return decoded;
+}
+
+//  decoding gives back the same canonical json, which is what gets hashed
+void test_round_trip(void* putl)
+{
+    SignedBlock signed_block = make_block(42);
+    check(round_trip(signed_block, putl).to_string() == signed_block.to_string(), "signed block");
+    check(to_binary(signed_block).size() < signed_block.to_string().size(), "binary is shorter");
+
+    Transaction empty_action;
+    check(round_trip(empty_action, putl).to_string() == empty_action.to_string(), "empty packet");
+
+    StorageFileRequest request;
+    request.uri = "uri";
+    check(false == bool(round_trip(request, putl).if_none_match), "missing optional");
+    request.if_none_match = string();
+    request.range = string("bytes=0-99");
+    StorageFileRequest decoded_request = round_trip(request, putl);
+    check(decoded_request.if_none_match && decoded_request.if_none_match->empty(), "empty optional");
+    check(decoded_request.range && *decoded_request.range == "bytes=0-99", "optional");
+
+    StorageTypes::BlockUndo undo;
+    undo.recorded = true;
+    StorageTypes::BlockUndoEntry entry;
+    entry.table = "chain_account";
+    entry.key = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+    entry.existed = true;
+    entry.value = signed_block.block_details.rewards.front().amount.to_string();
+    undo.entries.push_back(entry);
+    check(round_trip(undo, putl).to_string() == undo.to_string(), "types module");
+}
+
+//  cut or extended data is refused
+void test_corrupted(void* putl)
+{
+    string encoded = to_binary(make_block(7));
+
+    bool thrown = false;
+    try
+    {
+        SignedBlock decoded;
+        from_binary(encoded.data(), encoded.data() + encoded.size() - 1, decoded, putl);
+    }
+    catch (std::runtime_error const&)
+    {
+        thrown = true;
+    }
+    check(thrown, "truncated data");
+
+    encoded.push_back('\0');
+    thrown = false;
+    try
+    {
+        SignedBlock decoded;
+        from_binary(encoded.data(), encoded.data() + encoded.size(), decoded, putl);
+    }
+    catch (std::runtime_error const&)
+    {
+        thrown = true;
+    }
+    check(thrown, "data after the end");
+}
+
+//  a store written as json and continued in binary reads back alike
+void test_mixed_store(filesystem::path const& path)
+{
+    {
+        publiqpp::segment_loader<SignedBlock> blocks("block", path, 4096, 2,
+                                                    publiqpp::segment_encoding::json,
+                                                    get_putl());
+        for (uint64_t index = 0; index != 5; ++index)
+            blocks.push_back(make_block(index));
+        blocks.save();
+        blocks.commit();
+    }
+    {
+        publiqpp::segment_loader<SignedBlock> blocks("block", path, 4096, 2,
+                                                    publiqpp::segment_encoding::binary,
+                                                    get_putl());
+        for (uint64_t index = 5; index != 10; ++index)
+            blocks.push_back(make_block(index));
+        blocks.save();
+        blocks.commit();
+    }
+
+    publiqpp::segment_store store("block", path, 4096);
+    check(store.at(0).front() == '{', "json record");
+    check(store.at(9).front() == '\0', "binary record");
+
+    publiqpp::segment_loader<SignedBlock> blocks("block", path, 4096, 2,
+                                                publiqpp::segment_encoding::binary,
+                                                get_putl());
+    check(blocks.size() == 10, "mixed store size");
+    for (uint64_t index = 0; index != 10; ++index)
+        check(blocks.at(index)->to_string() == make_block(index).to_string(),
+              "mixed store record " + std::to_string(index));
+}
+
+int main(int argc, char** argv)
+{
+    filesystem::path path;
+    if (argc > 1)
+        path = argv[1];
+    else
+        path = filesystem::temp_directory_path() / filesystem::unique_path("test_binary_codec_%%%%%%%%");
+
+    int result = 0;
+    try
+    {
+        filesystem::create_directories(path);
+        cout << "path: " << path.string() << endl;
+
+        auto putl = get_putl();
+
+        test_round_trip(putl.get());
+        test_corrupted(putl.get());
+        test_mixed_store(path);
+
+        cout << "passed" << endl;
+    }
+    catch(std::exception const& e)
+    {
+        cout << "exception: " << e.what() << endl;
+        result = 1;
+    }
+
+    if (argc < 2)
+    {
+        boost::system::error_code ec;
+        filesystem::remove_all(path, ec);
+    }
+
+    return result;
+}
@@ -0,0 +1,197 @@
+#include "../libblockchain/block_undo.hpp"
+
+#include <publiq.pp/message.hpp>
+#include <publiq.pp/message.tmpl.hpp>
+
+#include <mesh.pp/fileutility.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <stdexcept>
+
+using namespace BlockchainMessage;
+
+using publiqpp::block_undo;
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::map;
+namespace filesystem = boost::filesystem;
+
+inline
+beltpp::void_unique_ptr get_putl()
+{
+    beltpp::message_loader_utility utl;
+    BlockchainMessage::detail::extension_helper(utl);
+
+    auto ptr_utl =
+        beltpp::new_void_unique_ptr<beltpp::message_loader_utility>(std::move(utl));
+
+    return ptr_utl;
+}
+
+void check(bool condition, string const& what)
+{
+    if (false == condition)
+        throw std::runtime_error("failed: " + what);
+}
+
+Coin make_coin(uint64_t whole)
+{
+    Coin result;
+    result.whole = whole;
+    result.fraction = 0;
+    return result;
+}
+
+using accounts_loader = meshpp::map_loader<Coin>;
+
+//  the keys of the test with their values, 0 for a missing one
+map<string, uint64_t> snapshot(accounts_loader const& accounts)
+{
+    map<string, uint64_t> result;
+    for (auto const& key : {"alice", "bob", "carol", "dave"})
+        result[key] = accounts.as_const().contains(key) ?
+                          accounts.as_const().at(key).whole : 0;
+    return result;
+}
+
+//  the way state changes an account, touched before the change
+void set_balance(block_undo& undo, accounts_loader& accounts, string const& key, uint64_t whole)
+{
+    undo.touch("chain_account", accounts, key);
+
+    if (0 == whole)
+        accounts.erase(key);
+    else if (accounts.as_const().contains(key))
+        accounts.at(key) = make_coin(whole);
+    else
+        accounts.insert(key, make_coin(whole));
+}
+
+//  the way a block is reverted, newest entry first
+void revert(StorageTypes::BlockUndo const& record, accounts_loader& accounts, void* putl)
+{
+    check(record.recorded, "reverted block has a record");
+    for (auto it = record.entries.crbegin(); it != record.entries.crend(); ++it)
+    {
+        check(it->table == "chain_account", "table");
+        block_undo::restore<Coin>(accounts, *it, putl);
+    }
+}
+
+//  the record is stored next to the block and read back when reverting
+StorageTypes::BlockUndo stored(StorageTypes::BlockUndo const& record, void* putl)
+{
+    StorageTypes::BlockUndo result;
+    result.from_string(record.to_string(), putl);
+    return result;
+}
+
+void test_not_recording(accounts_loader& accounts)
+{
+    block_undo undo;
+    set_balance(undo, accounts, "alice", 10);
+
+    StorageTypes::BlockUndo record = undo.end();
+    check(false == record.recorded, "nothing recorded outside a block");
+    check(record.entries.empty(), "no entries outside a block");
+
+    undo.begin();
+    set_balance(undo, accounts, "alice", 11);
+    undo.discard();
+    record = undo.end();
+    check(record.entries.empty(), "discarded block");
+}
+
+void test_revert(accounts_loader& accounts, void* putl)
+{
+    accounts.insert("alice", make_coin(100));
+    accounts.insert("bob", make_coin(50));
+    accounts.save();
+    accounts.commit();
+
+    auto before_first = snapshot(accounts);
+
+    block_undo undo;
+    undo.begin();
+    set_balance(undo, accounts, "alice", 70);
+    set_balance(undo, accounts, "carol", 30);
+    set_balance(undo, accounts, "alice", 60);
+    set_balance(undo, accounts, "bob", 0);
+    StorageTypes::BlockUndo first = stored(undo.end(), putl);
+
+    check(first.entries.size() == 3, "only the first touch of a key is recorded");
+    accounts.save();
+    accounts.commit();
+
+    auto before_second = snapshot(accounts);
+
+    undo.begin();
+    set_balance(undo, accounts, "carol", 0);
+    set_balance(undo, accounts, "dave", 5);
+    set_balance(undo, accounts, "alice", 1);
+    StorageTypes::BlockUndo second = stored(undo.end(), putl);
+
+    check(second.entries.size() == 3, "second block entries");
+    accounts.save();
+    accounts.commit();
+
+    revert(second, accounts, putl);
+    check(snapshot(accounts) == before_second, "second block reverted");
+
+    revert(first, accounts, putl);
+    check(snapshot(accounts) == before_first, "first block reverted");
+
+    accounts.save();
+    accounts.commit();
+}
+
+int main(int argc, char** argv)
+{
+    filesystem::path path;
+    if (argc > 1)
+        path = argv[1];
+    else
+        path = filesystem::temp_directory_path() / filesystem::unique_path("test_block_undo_%%%%%%%%");
+
+    int result = 0;
+    try
+    {
+        filesystem::create_directories(path);
+        cout << "path: " << path.string() << endl;
+
+        auto putl = get_putl();
+
+        {
+            accounts_loader accounts("chain_account", path, 10000, get_putl());
+            test_not_recording(accounts);
+            accounts.discard();
+
+            test_revert(accounts, putl.get());
+        }
+
+        accounts_loader accounts("chain_account", path, 10000, get_putl());
+        check(snapshot(accounts) == (map<string, uint64_t>{{"alice", 100}, {"bob", 50}, {"carol", 0}, {"dave", 0}}),
+              "reverted state after reopen");
+
+        cout << "passed" << endl;
+    }
+    catch(std::exception const& e)
+    {
+        cout << "exception: " << e.what() << endl;
+        result = 1;
+    }
+
+    if (argc < 2)
+    {
+        boost::system::error_code ec;
+        filesystem::remove_all(path, ec);
+    }
+
+    return result;
+}
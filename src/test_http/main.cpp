@@ -0,0 +1,293 @@
+#include "../libblockchain/http.hpp"
+
+#include <publiq.pp/message.hpp>
+#include <publiq.pp/message.tmpl.hpp>
+
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+using namespace BlockchainMessage;
+namespace http = publiqpp::http;
+
+using std::cout;
+using std::endl;
+using std::string;
+
+inline
+beltpp::void_unique_ptr get_putl()
+{
+    beltpp::message_loader_utility utl;
+    BlockchainMessage::detail::extension_helper(utl);
+
+    auto ptr_utl =
+        beltpp::new_void_unique_ptr<beltpp::message_loader_utility>(std::move(utl));
+
+    return ptr_utl;
+}
+
+void check(bool condition, string const& what)
+{
+    if (false == condition)
+        throw std::runtime_error("failed: " + what);
+}
+
+string status_line(string const& answer)
+{
+    return answer.substr(0, answer.find("\r\n"));
+}
+
+string header(string const& answer, string const& name)
+{
+    auto headers_end = answer.find("\r\n\r\n");
+    auto begin = answer.find("\r\n" + name + ": ");
+    if (begin == string::npos || begin >= headers_end)
+        return string();
+
+    begin += name.length() + 4;
+    return answer.substr(begin, answer.find("\r\n", begin) - begin);
+}
+
+string body(string const& answer)
+{
+    return answer.substr(answer.find("\r\n\r\n") + 4);
+}
+
+void check_range(string const& value,
+                 uint64_t total_size,
+                 http::range_parse expected,
+                 uint64_t expected_begin = 0,
+                 uint64_t expected_end = 0)
+{
+    uint64_t range_begin = 0, range_end = 0;
+    auto result = http::parse_range(value, total_size, range_begin, range_end);
+
+    check(result == expected, "range \"" + value + "\"");
+    if (expected == http::range_parse::range)
+        check(range_begin == expected_begin && range_end == expected_end,
+              "range \"" + value + "\" is [" + std::to_string(range_begin) +
+              ", " + std::to_string(range_end) + ")");
+}
+
+void test_parse_range()
+{
+    check_range("bytes=0-99", 1000, http::range_parse::range, 0, 100);
+    check_range("bytes=990-2000", 1000, http::range_parse::range, 990, 1000);
+    check_range("bytes=900-", 1000, http::range_parse::range, 900, 1000);
+    check_range("bytes=-100", 1000, http::range_parse::range, 900, 1000);
+    check_range("bytes=-2000", 1000, http::range_parse::range, 0, 1000);
+    check_range("bytes=0-", 2 * STORAGE_MAX_RANGE_LENGTH,
+                http::range_parse::range, 0, STORAGE_MAX_RANGE_LENGTH);
+
+    check_range("bytes=1000-", 1000, http::range_parse::unsatisfiable);
+    check_range("bytes=-0", 1000, http::range_parse::unsatisfiable);
+    check_range("bytes=-10", 0, http::range_parse::unsatisfiable);
+
+    check_range("bytes=5-4", 1000, http::range_parse::none);
+    check_range("bytes=0-1,5-6", 1000, http::range_parse::none);
+    check_range("bytes=-", 1000, http::range_parse::none);
+    check_range("bytes=a-b", 1000, http::range_parse::none);
+    check_range("items=0-1", 1000, http::range_parse::none);
+    check_range("bytes=0-99999999999999999999", 1000, http::range_parse::none);
+}
+
+//  the first part comes with the headers of the whole range, the rest as chunks
+void test_range_response()
+{
+    StorageFileRange file_range;
+    file_range.mime_type = "text/plain";
+    file_range.range_begin = 10;
+    file_range.range_length = 10;
+    file_range.total_size = 100;
+    file_range.uri = "6GyZmFh4X93Pvq3xSwUnfJYvt4UDmaj1wQC7hnjPykb3";
+    file_range.stored_at.tm = 1546300800;
+    file_range.data = "0123";
+
+    string answer = http::file_response(beltpp::packet(std::move(file_range)));
+    check(status_line(answer) == "HTTP/1.1 206 Partial Content", "206 status");
+    check(header(answer, "Content-Range") == "bytes 10-19/100", "Content-Range");
+    check(header(answer, "Content-Length") == "10", "Content-Length of the range");
+    check(header(answer, "Accept-Ranges") == "bytes", "Accept-Ranges");
+    check(header(answer, "Content-Type") == "text/plain", "Content-Type");
+    check(body(answer) == "0123", "first part");
+
+    StorageFileChunk chunk;
+    chunk.data = "456789";
+    check(http::file_response(beltpp::packet(std::move(chunk))) == "456789", "next part as is");
+
+    StorageFileError error;
+    error.uri = "6GyZmFh4X93Pvq3xSwUnfJYvt4UDmaj1wQC7hnjPykb3";
+    error.uri_problem_type = UriProblemType::invalid;
+    error.total_size = 100;
+
+    answer = http::file_response(beltpp::packet(std::move(error)));
+    check(status_line(answer) == "HTTP/1.1 416 Range Not Satisfiable", "416 status");
+    check(header(answer, "Content-Range") == "bytes */100", "Content-Range of 416");
+    check(header(answer, "Content-Length") == std::to_string(body(answer).length()), "Content-Length of 416");
+}
+
+void test_entity_tag()
+{
+    string const uri = "6GyZmFh4X93Pvq3xSwUnfJYvt4UDmaj1wQC7hnjPykb3";
+
+    check(http::entity_tag_match("\"" + uri + "\"", uri), "entity tag");
+    check(http::entity_tag_match("W/\"" + uri + "\"", uri), "weak entity tag");
+    check(http::entity_tag_match("\"other\", \t\"" + uri + "\" ", uri), "entity tag in a list");
+    check(http::entity_tag_match("*", uri), "any entity tag");
+
+    check(false == http::entity_tag_match("", uri), "empty value");
+    check(false == http::entity_tag_match(uri, uri), "entity tag without quotes");
+    check(false == http::entity_tag_match("\"other\", W/\"more\"", uri), "other entity tags");
+}
+
+//  the file and the 304 answer carry the same validators
+void test_not_modified_response()
+{
+    string const uri = "6GyZmFh4X93Pvq3xSwUnfJYvt4UDmaj1wQC7hnjPykb3";
+
+    StorageFileContent content;
+    content.uri = uri;
+    content.mime_type = "image/png";
+    content.stored_at.tm = 1546300800;
+    content.size = 10;
+    content.data = "01234";
+
+    string answer = http::file_response(beltpp::packet(std::move(content)));
+    check(status_line(answer) == "HTTP/1.1 200 OK", "200 status");
+    check(header(answer, "ETag") == "\"" + uri + "\"", "ETag");
+    check(header(answer, "Last-Modified") == "Tue, 01 Jan 2019 00:00:00 GMT", "Last-Modified");
+    check(header(answer, "Cache-Control") == "public, max-age=31536000, immutable", "Cache-Control");
+    check(header(answer, "Content-Length") == "10", "Content-Length of the file");
+    check(body(answer) == "01234", "first part of the file");
+
+    StorageFileNotModified not_modified;
+    not_modified.uri = uri;
+    not_modified.stored_at.tm = 1546300800;
+
+    answer = http::file_response(beltpp::packet(std::move(not_modified)));
+    check(status_line(answer) == "HTTP/1.1 304 Not Modified", "304 status");
+    check(header(answer, "ETag") == "\"" + uri + "\"", "ETag of 304");
+    check(header(answer, "Last-Modified") == "Tue, 01 Jan 2019 00:00:00 GMT", "Last-Modified of 304");
+    check(header(answer, "Content-Length").empty(), "no Content-Length in 304");
+    check(body(answer).empty(), "no body in 304");
+}
+
+beltpp::detail::pmsg_all load(string::const_iterator& it,
+                             string const& buffer,
+                             beltpp::detail::session_special_data& ssd,
+                             void* putl)
+{
+    return http::message_list_load<&BlockchainMessage::message_list_load>(it, buffer.cend(), ssd, putl);
+}
+
+//  requests of any kind follow each other on one connection, each is read
+//  where the one before ended, and the answers keep the connection for the next
+void test_pipelining()
+{
+    string const uri = "6GyZmFh4X93Pvq3xSwUnfJYvt4UDmaj1wQC7hnjPykb3";
+    auto putl = get_putl();
+
+    PublicAddressesRequest addresses_request;
+    addresses_request.address_type = PublicAddressType::rpc;
+    string batch = "[" + MasterKeyRequest().to_string() + "," + addresses_request.to_string() + "]";
+
+    string storage_request = "GET /storage?file=" + uri + " HTTP/1.1\r\n"
+                             "Host: localhost\r\n"
+                             "Range: bytes=0-9\r\n"
+                             "If-None-Match: \"" + uri + "\"\r\n\r\n";
+    string batch_request = "POST /api HTTP/1.1\r\n"
+                           "Host: localhost\r\n"
+                           "Content-Length: " + std::to_string(batch.length()) + "\r\n\r\n" +
+                           batch;
+    string seed_request = "GET /seed HTTP/1.1\r\n"
+                          "Host: localhost\r\n\r\n";
+
+    //  a request that has not fully arrived is left for later
+    {
+        beltpp::detail::session_special_data ssd;
+        string partial = storage_request.substr(0, storage_request.length() - 3);
+        auto it = partial.cbegin();
+        auto pmsgall = load(it, partial, ssd, putl.get());
+        check(pmsgall.rtt == size_t(-1) && it == partial.cbegin(), "partial request waits");
+    }
+
+    //  the validators are not needed to be answered as http
+    {
+        beltpp::detail::session_special_data ssd;
+        string plain = "GET /storage?file=" + uri + " HTTP/1.1\r\n"
+                       "Host: localhost\r\n\r\n";
+        auto it = plain.cbegin();
+        auto pmsgall = load(it, plain, ssd, putl.get());
+        check(pmsgall.rtt == StorageFileRequest::rtt, "plain storage request");
+        auto const& plain_request = *static_cast<StorageFileRequest const*>(pmsgall.pmsg.get());
+        check(false == bool(plain_request.if_none_match), "no entity tag");
+        check(plain_request.from_http && *plain_request.from_http, "plain storage request is marked as http");
+    }
+
+    string buffer = storage_request + batch_request + seed_request;
+    beltpp::detail::session_special_data ssd;
+
+    auto it = buffer.cbegin();
+    auto pmsgall = load(it, buffer, ssd, putl.get());
+    check(pmsgall.rtt == StorageFileRequest::rtt, "storage request");
+    check(it == buffer.cbegin() + storage_request.length(), "storage request is read to its end");
+    auto const& file_request = *static_cast<StorageFileRequest const*>(pmsgall.pmsg.get());
+    check(file_request.uri == uri, "storage request uri");
+    check(file_request.range && *file_request.range == "bytes=0-9", "storage request range");
+    check(file_request.if_none_match && *file_request.if_none_match == "\"" + uri + "\"",
+          "storage request entity tag");
+    check(file_request.from_http && *file_request.from_http, "storage request is marked as http");
+    check(ssd.session_specal_handler == &http::response, "storage request is answered as http");
+
+    auto pmsgall_batch = load(it, buffer, ssd, putl.get());
+    check(pmsgall_batch.rtt == BatchRequest::rtt, "batch request");
+    check(it == buffer.cbegin() + storage_request.length() + batch_request.length(),
+          "batch request is read to its end");
+    auto const& batch_message = *static_cast<BatchRequest const*>(pmsgall_batch.pmsg.get());
+    check(batch_message.requests.size() == 2 &&
+          batch_message.requests[0].type() == MasterKeyRequest::rtt &&
+          batch_message.requests[1].type() == PublicAddressesRequest::rtt, "batch requests in order");
+
+    auto pmsgall_seed = load(it, buffer, ssd, putl.get());
+    check(pmsgall_seed.rtt == MasterKeyRequest::rtt, "seed request");
+    check(it == buffer.cend(), "whole pipeline is read");
+
+    //  the file answers are framed by their own type, the rest as json
+    //  and each answer leaves the connection ready for the next one
+    StorageFileNotModified not_modified;
+    not_modified.uri = uri;
+    not_modified.stored_at.tm = 1546300800;
+    string answer = http::response(ssd, beltpp::packet(std::move(not_modified)));
+    check(status_line(answer) == "HTTP/1.1 304 Not Modified", "pipelined 304");
+
+    MasterKey master_key;
+    master_key.master_key = "key";
+    BatchResponse batch_response;
+    batch_response.responses.push_back(beltpp::packet(MasterKey(master_key)));
+    batch_response.responses.push_back(beltpp::packet(PublicAddressesInfo()));
+    answer = http::response(ssd, beltpp::packet(std::move(batch_response)));
+    check(body(answer) == "[" + master_key.to_string() + "," + PublicAddressesInfo().to_string() + "]",
+          "batch answers in order");
+    check(ssd.session_specal_handler == &http::response, "connection is kept after the batch");
+}
+
+int main()
+{
+    try
+    {
+        test_parse_range();
+        test_range_response();
+        test_entity_tag();
+        test_not_modified_response();
+        test_pipelining();
+
+        cout << "passed" << endl;
+    }
+    catch(std::exception const& e)
+    {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "../libblockchain/segment_store.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+using publiqpp::segment_store;
+
+using std::cout;
+using std::endl;
+using std::string;
+namespace filesystem = boost::filesystem;
+
+void check(bool condition, string const& what)
+{
+    if (false == condition)
+        throw std::runtime_error("failed: " + what);
+}
+
+string record(size_t index)
+{
+    return "record " + std::to_string(index) + string(index % 7, '.');
+}
+
+void check_records(segment_store const& store, size_t count, string const& what)
+{
+    check(store.size() == count, what + ", size " + std::to_string(store.size()));
+    for (size_t index = 0; index != count; ++index)
+        check(store.at(index) == record(index), what + ", record " + std::to_string(index));
+}
+
+size_t segment_count(filesystem::path const& path, string const& name)
+{
+    size_t count = 0;
+    for (filesystem::directory_iterator it(path); it != filesystem::directory_iterator(); ++it)
+    {
+        string file_name = it->path().filename().string();
+        if (0 == file_name.compare(0, name.length() + 1, name + ".") &&
+            it->path().extension() == ".seg")
+            ++count;
+    }
+    return count;
+}
+
+//  committed records are read back after reopen, across several segments
+void test_commit(filesystem::path const& path)
+{
+    {
+        segment_store store("commit", path, 64);
+        for (size_t index = 0; index != 20; ++index)
+            store.push_back(record(index));
+        check_records(store, 20, "pending records");
+
+        store.save();
+        store.commit();
+        check(store.stable_size() == 20, "stable size after commit");
+    }
+
+    check(segment_store::exists("commit", path), "state after commit");
+    check(segment_count(path, "commit") > 1, "records over several segments");
+
+    segment_store store("commit", path, 64);
+    check_records(store, 20, "reopened");
+}
+
+//  saved and not committed records are gone after reopen, as after a crash
+void test_interrupted_save(filesystem::path const& path)
+{
+    {
+        segment_store store("interrupted", path, 64);
+        for (size_t index = 0; index != 5; ++index)
+            store.push_back(record(index));
+        store.save();
+        store.commit();
+
+        for (size_t index = 5; index != 10; ++index)
+            store.push_back(record(index));
+        store.save();
+    }
+
+    check(filesystem::exists(path / "interrupted.state.tmp"), "journal after save");
+
+    segment_store store("interrupted", path, 64);
+    check(false == filesystem::exists(path / "interrupted.state.tmp"), "journal dropped on load");
+    check_records(store, 5, "reopened after interrupted save");
+
+    for (size_t index = 5; index != 8; ++index)
+        store.push_back(record(index));
+    store.save();
+    store.commit();
+    check_records(store, 8, "appended after interrupted save");
+}
+
+//  discard drops what was saved after the last commit
+void test_discard(filesystem::path const& path)
+{
+    segment_store store("discard", path, 64);
+    for (size_t index = 0; index != 4; ++index)
+        store.push_back(record(index));
+    store.save();
+    store.commit();
+
+    store.pop_back();
+    store.push_back("replaced");
+    store.push_back("appended");
+    check(store.stable_size() == 3, "stable size after pop_back");
+    store.save();
+    store.discard();
+    check_records(store, 4, "discarded");
+
+    store.pop_back();
+    store.push_back(record(3));
+    store.push_back(record(4));
+    store.save();
+    store.commit();
+
+    segment_store reopened("discard", path, 64);
+    check_records(reopened, 5, "reopened after discard");
+}
+
+//  a commit that did not reach the index file is replayed from the state on load
+void test_index_replay(filesystem::path const& path)
+{
+    {
+        segment_store store("replay", path, 64);
+        for (size_t index = 0; index != 12; ++index)
+            store.push_back(record(index));
+        store.save();
+        store.commit();
+    }
+
+    filesystem::resize_file(path / "replay.idx", 0);
+
+    {
+        segment_store store("replay", path, 64);
+        check_records(store, 12, "replayed index");
+    }
+
+    check(filesystem::file_size(path / "replay.idx") == 12 * 16, "index file restored");
+}
+
+//  clear keeps the records until commit, then only the new ones remain
+void test_clear(filesystem::path const& path)
+{
+    segment_store store("clear", path, 64);
+    for (size_t index = 0; index != 20; ++index)
+        store.push_back("old " + std::to_string(index));
+    store.save();
+    store.commit();
+
+    store.clear();
+    check(store.size() == 0, "size after clear");
+    for (size_t index = 0; index != 3; ++index)
+        store.push_back(record(index));
+    store.save();
+    store.discard();
+    check(store.size() == 20 && store.at(19) == "old 19", "discarded clear");
+
+    store.clear();
+    for (size_t index = 0; index != 3; ++index)
+        store.push_back(record(index));
+    store.save();
+    store.commit();
+
+    segment_store reopened("clear", path, 64);
+    check_records(reopened, 3, "reopened after clear");
+    check(false == filesystem::exists(path / "clear.0.seg"), "cleared segments removed");
+}
+
+int main(int argc, char** argv)
+{
+    filesystem::path path;
+    if (argc > 1)
+        path = argv[1];
+    else
+        path = filesystem::temp_directory_path() / filesystem::unique_path("test_segment_store_%%%%%%%%");
+
+    int result = 0;
+    try
+    {
+        filesystem::create_directories(path);
+        cout << "path: " << path.string() << endl;
+
+        test_commit(path);
+        test_interrupted_save(path);
+        test_discard(path);
+        test_index_replay(path);
+        test_clear(path);
+
+        cout << "passed" << endl;
+    }
+    catch(std::exception const& e)
+    {
+        cout << "exception: " << e.what() << endl;
+        result = 1;
+    }
+
+    if (argc < 2)
+    {
+        boost::system::error_code ec;
+        filesystem::remove_all(path, ec);
+    }
+
+    return result;
+}
@@ -0,0 +1,121 @@
+#include "../libblockchain/storage.hpp"
+
+#include <publiq.pp/message.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace BlockchainMessage;
+
+using publiqpp::storage;
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+namespace filesystem = boost::filesystem;
+
+void check(bool condition, string const& what)
+{
+    if (false == condition)
+        throw std::runtime_error("failed: " + what);
+}
+
+//  the fastest of the rounds, in nanoseconds per call
+template <typename T_call>
+uint64_t measure(size_t count, T_call const& call)
+{
+    uint64_t result = uint64_t(-1);
+    for (size_t round = 0; round != 5; ++round)
+    {
+        steady_clock::time_point start = steady_clock::now();
+        for (size_t index = 0; index != count; ++index)
+            call();
+
+        auto duration = chrono::duration_cast<chrono::nanoseconds>(steady_clock::now() - start);
+        result = std::min(result, uint64_t(duration.count()) / count);
+    }
+
+    return result;
+}
+
+//  details are answered from the file info index, so their cost does not
+//  follow the file size the way reading the file does
+int main(int argc, char** argv)
+{
+    filesystem::path path;
+    if (argc > 1)
+        path = argv[1];
+    else
+        path = filesystem::temp_directory_path() / filesystem::unique_path("test_storage_performance_%%%%%%%%");
+
+    int result = 0;
+    try
+    {
+        filesystem::create_directories(path);
+        cout << "path: " << path.string() << endl;
+
+        storage store(path);
+
+        vector<uint64_t> sizes = {1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024};
+        vector<uint64_t> details_times;
+
+        for (auto size : sizes)
+        {
+            StorageFile file;
+            file.mime_type = "application/octet-stream";
+            file.data.resize(size);
+            for (size_t index = 0; index != file.data.size(); ++index)
+                file.data[index] = char(index * 31 + size);
+
+            string uri;
+            check(store.put(std::move(file), uri), "put " + std::to_string(size));
+
+            uint64_t details_time = measure(10000, [&store, &uri, size]
+            {
+                StorageTypes::StorageFileInfo info;
+                if (false == store.get_info(uri, info) || info.size != size)
+                    throw std::runtime_error("get_info " + uri);
+            });
+
+            uint64_t get_time = measure(3, [&store, &uri, size]
+            {
+                StorageFile stored;
+                if (false == store.get(uri, stored) || stored.data.size() != size)
+                    throw std::runtime_error("get " + uri);
+            });
+
+            details_times.push_back(details_time);
+
+            cout << size << " bytes: details " << details_time << " ns, "
+                 << "whole file " << get_time << " ns" << endl;
+        }
+
+        //  generous, to fail only when the file is read again
+        check(details_times.back() < 10 * std::max<uint64_t>(details_times.front(), 1000),
+              "details latency grows with the file size");
+
+        cout << "passed" << endl;
+    }
+    catch(std::exception const& e)
+    {
+        cout << "exception: " << e.what() << endl;
+        result = 1;
+    }
+
+    if (argc < 2)
+    {
+        boost::system::error_code ec;
+        filesystem::remove_all(path, ec);
+    }
+
+    return result;
+}
@@ -0,0 +1,284 @@
+#include "../libblockchain/transaction_pool.hpp"
+#include "../libblockchain/segment_store.hpp"
+
+#include <publiq.pp/message.hpp>
+#include <publiq.pp/message.tmpl.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+using namespace BlockchainMessage;
+
+using publiqpp::transaction_pool;
+using publiqpp::memoized_transaction;
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+namespace chrono = std::chrono;
+using chrono::system_clock;
+namespace filesystem = boost::filesystem;
+
+string const alice = "PBQ7Ta31VaxCB9VfDRvYYosKYpzxXNgVH46UkM9i4FhzNg4JEU3YJ";
+string const bob = "PBQ76Zv5QceNSLibecnMGEKbKo3dVFV6HRuDSuX59mJewJxHPhLwu";
+
+void check(bool condition, string const& what)
+{
+    if (false == condition)
+        throw std::runtime_error("failed: " + what);
+}
+
+SignedTransaction make_transaction(string const& from, uint64_t index, uint64_t fee_fraction)
+{
+    Transfer transfer;
+    transfer.from = from;
+    transfer.to = (from == alice) ? bob : alice;
+    transfer.amount.whole = 1;
+    transfer.amount.fraction = 0;
+    transfer.message = "transfer " + std::to_string(index);
+
+    auto now = system_clock::now();
+
+    Transaction transaction;
+    transaction.creation.tm = system_clock::to_time_t(now);
+    transaction.expiry.tm = system_clock::to_time_t(now + chrono::hours(1));
+    transaction.fee.whole = 0;
+    transaction.fee.fraction = fee_fraction;
+    transaction.action = std::move(transfer);
+
+    Authority authority;
+    authority.address = from;
+    authority.signature = "AN1rKvtGGbfRnyRimyr6PFqaHvAX1XEBHW8JjGFgtmP3Cu4nuo";
+
+    SignedTransaction signed_transaction;
+    signed_transaction.transaction_details = std::move(transaction);
+    signed_transaction.authorizations.push_back(authority);
+
+    return signed_transaction;
+}
+
+string hash(SignedTransaction const& signed_transaction)
+{
+    return memoized_transaction(signed_transaction).digest();
+}
+
+void push_back(transaction_pool& pool, SignedTransaction const& signed_transaction)
+{
+    pool.push_back(memoized_transaction(signed_transaction));
+}
+
+void check_pool(transaction_pool const& pool,
+                vector<SignedTransaction> const& expected,
+                string const& what)
+{
+    check(pool.length() == expected.size(), what + ", length " + std::to_string(pool.length()));
+
+    auto arrived = pool.by_arrival();
+    check(arrived.size() == expected.size(), what + ", arrived");
+    for (size_t index = 0; index != expected.size(); ++index)
+    {
+        string expected_hash = hash(expected[index]);
+        check(arrived[index]->to_string() == expected[index].to_string(),
+              what + ", arrival order " + std::to_string(index));
+        check(pool.contains(expected_hash), what + ", contains " + std::to_string(index));
+        check(pool.at(expected_hash).to_string() == expected[index].to_string(),
+              what + ", at " + std::to_string(index));
+    }
+}
+
+uint64_t journal_size(filesystem::path const& path)
+{
+    publiqpp::segment_store journal("pool", path, 4 * 1024 * 1024);
+    return journal.size();
+}
+
+//  the way revert_pool empties the pool before the transactions are pushed back
+void revert(transaction_pool& pool, vector<SignedTransaction> const& pushed_back)
+{
+    SignedTransaction popped;
+    while (pool.length())
+        pool.pop_back(popped);
+
+    for (auto const& item : pushed_back)
+        push_back(pool, item);
+}
+
+//  committed transactions are replayed from the journal with their indices
+void test_journal(filesystem::path const& path, vector<SignedTransaction> const& pooled)
+{
+    {
+        transaction_pool pool(path);
+        check(pool.length() == 0, "empty pool");
+
+        for (auto const& item : pooled)
+            push_back(pool, item);
+        pool.save();
+        pool.commit();
+    }
+
+    transaction_pool pool(path);
+    check_pool(pool, pooled, "reopened");
+
+    check(pool.hashes_from(alice).size() == 2, "transactions from alice");
+    check(pool.hashes_from(bob).size() == 1, "transactions from bob");
+
+    string prefix = hash(pooled[1]).substr(0, 12);
+    check(pool.find_prefix(prefix) &&
+          pool.find_prefix(prefix)->to_string() == pooled[1].to_string(), "find by prefix");
+    check(nullptr == pool.find_prefix(""), "ambiguous prefix");
+
+    auto by_fee = pool.by_fee();
+    check(by_fee.size() == 3 &&
+          by_fee[0]->to_string() == pooled[2].to_string() &&
+          by_fee[1]->to_string() == pooled[0].to_string() &&
+          by_fee[2]->to_string() == pooled[1].to_string(), "fee order");
+}
+
+//  transactions pushed back after a revert keep their journal records,
+//  unless pushed back before one that arrived earlier
+void test_revert(filesystem::path const& path, vector<SignedTransaction> const& pooled)
+{
+    {
+        transaction_pool pool(path);
+        revert(pool, pooled);
+        pool.save();
+        pool.commit();
+        check_pool(pool, pooled, "pushed back");
+    }
+    check(journal_size(path) == pooled.size(), "journal size after revert " + std::to_string(journal_size(path)));
+
+    vector<SignedTransaction> reversed(pooled.rbegin(), pooled.rend());
+    {
+        transaction_pool pool(path);
+        revert(pool, reversed);
+        pool.save();
+        pool.commit();
+        check_pool(pool, reversed, "pushed back reversed");
+    }
+
+    {
+        transaction_pool pool(path);
+        check_pool(pool, reversed, "reopened reversed");
+
+        revert(pool, pooled);
+        pool.save();
+        pool.discard();
+        check_pool(pool, reversed, "discarded revert");
+
+        revert(pool, pooled);
+        pool.save();
+        pool.commit();
+    }
+
+    transaction_pool pool(path);
+    check_pool(pool, pooled, "reopened after revert");
+}
+
+//  what was not committed is dropped by discard and after an interrupted save
+void test_discard(filesystem::path const& path, vector<SignedTransaction> const& pooled)
+{
+    {
+        transaction_pool pool(path);
+
+        SignedTransaction popped;
+        check(pool.pop_back(popped), "popped is not evicted");
+        check(popped.to_string() == pooled.back().to_string(), "popped the last arrived");
+        push_back(pool, make_transaction(bob, 100, 1000));
+        pool.save();
+        pool.discard();
+        check_pool(pool, pooled, "discarded after save");
+
+        push_back(pool, make_transaction(bob, 101, 1000));
+        pool.discard();
+        check_pool(pool, pooled, "discarded without save");
+
+        push_back(pool, make_transaction(bob, 102, 1000));
+        pool.save();
+    }
+
+    transaction_pool pool(path);
+    check_pool(pool, pooled, "reopened after interrupted save");
+}
+
+//  the journal is rewritten once it is mostly made of removed transactions
+void test_compact(filesystem::path const& path, vector<SignedTransaction> pooled)
+{
+    {
+        transaction_pool pool(path);
+
+        SignedTransaction popped;
+        pool.pop_back(popped);
+        pooled.pop_back();
+
+        for (uint64_t index = 0; index != 600; ++index)
+        {
+            push_back(pool, make_transaction(bob, 1000 + index, 1000));
+            pool.save();
+            pool.commit();
+            pool.pop_back(popped);
+        }
+
+        pool.save();
+        pool.commit();
+        check_pool(pool, pooled, "after compaction");
+    }
+
+    check(journal_size(path) < 600, "compacted journal size " + std::to_string(journal_size(path)));
+
+    transaction_pool pool(path);
+    check_pool(pool, pooled, "reopened after compaction");
+
+    pool.clear();
+    pool.save();
+    pool.commit();
+}
+
+int main(int argc, char** argv)
+{
+    filesystem::path path;
+    if (argc > 1)
+        path = argv[1];
+    else
+        path = filesystem::temp_directory_path() / filesystem::unique_path("test_transaction_pool_%%%%%%%%");
+
+    int result = 0;
+    try
+    {
+        filesystem::create_directories(path);
+        cout << "path: " << path.string() << endl;
+
+        vector<SignedTransaction> pooled;
+        pooled.push_back(make_transaction(alice, 0, 2000));
+        pooled.push_back(make_transaction(bob, 1, 1000));
+        pooled.push_back(make_transaction(alice, 2, 3000));
+
+        test_journal(path, pooled);
+        test_revert(path, pooled);
+        test_discard(path, pooled);
+        test_compact(path, pooled);
+
+        transaction_pool pool(path);
+        check(pool.length() == 0, "cleared pool");
+
+        cout << "passed" << endl;
+    }
+    catch(std::exception const& e)
+    {
+        cout << "exception: " << e.what() << endl;
+        result = 1;
+    }
+
+    if (argc < 2)
+    {
+        boost::system::error_code ec;
+        filesystem::remove_all(path, ec);
+    }
+
+    return result;
+}